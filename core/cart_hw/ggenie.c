@@ -41,7 +41,7 @@
 
 #include "shared.h"
 
-static struct
+static MACHINE_LOCAL struct
 {
   uint8 enabled;
   uint8 *rom;
@@ -154,6 +154,9 @@ void ggenie_switch(int enable)
       }
     }
   }
+
+  /* patched code may be cached */
+  m68k_block_flush();
 }
 
 static unsigned int ggenie_read_byte(unsigned int address)
@@ -1624,6 +1624,9 @@ static void mapper_seganet_w(uint32 address, uint32 data)
         m68k.memory_map[i].write16  = NULL;
         zbank_memory_map[i].write   = NULL;
       }
+
+      /* ROM is not cached while writable */
+      m68k_block_flush();
     }
   }
 }
@@ -369,11 +369,11 @@ static const rominfo_t game_list[] =
 };
 
 /* Cartridge & BIOS ROM hardware */
-static romhw_t cart_rom;
-static romhw_t bios_rom;
+static MACHINE_LOCAL romhw_t cart_rom;
+static MACHINE_LOCAL romhw_t bios_rom;
 
 /* Current slot */
-static struct
+static MACHINE_LOCAL struct
 {
   uint8 *rom;
   uint8 *fcr;
@@ -1298,6 +1298,7 @@ static void mapper_32k_w(unsigned char data)
 static void write_mapper_none(unsigned int address, unsigned char data)
 {
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_sega(unsigned int address, unsigned char data)
@@ -1308,6 +1309,7 @@ static void write_mapper_sega(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_codies(unsigned int address, unsigned char data)
@@ -1331,6 +1333,7 @@ static void write_mapper_codies(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_multi_16k(unsigned int address, unsigned char data)
@@ -1354,6 +1357,7 @@ static void write_mapper_multi_16k(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_multi_32k(unsigned int address, unsigned char data)
@@ -1364,6 +1368,7 @@ static void write_mapper_multi_32k(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_korea(unsigned int address, unsigned char data)
@@ -1375,6 +1380,7 @@ static void write_mapper_korea(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_msx(unsigned int address, unsigned char data)
@@ -1386,6 +1392,7 @@ static void write_mapper_msx(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_korea_8k(unsigned int address, unsigned char data)
@@ -1426,6 +1433,7 @@ static void write_mapper_korea_8k(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_korea_16k(unsigned int address, unsigned char data)
@@ -1449,6 +1457,7 @@ static void write_mapper_korea_16k(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_93c46(unsigned int address, unsigned char data)
@@ -1480,6 +1489,7 @@ static void write_mapper_93c46(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static void write_mapper_terebi(unsigned int address, unsigned char data)
@@ -1491,6 +1501,7 @@ static void write_mapper_terebi(unsigned int address, unsigned char data)
   }
 
   z80_writemap[address >> 10][address & 0x03FF] = data;
+  MARK_RAM_DIRTY(&z80_writemap[address >> 10][address & 0x03FF]);
 }
 
 static unsigned char read_mapper_93c46(unsigned int address)
@@ -62,7 +62,7 @@ extern void sram_write_byte(unsigned int address, unsigned int data);
 extern void sram_write_word(unsigned int address, unsigned int data);
 
 /* global variables */
-extern T_SRAM sram;
+extern MACHINE_LOCAL T_SRAM sram;
 
 #ifdef __cplusplus
 }
@@ -339,9 +339,9 @@
 }
 
 
-static ssp1601_t *ssp = NULL;
-static unsigned short *PC;
-static int g_cycles;
+static MACHINE_LOCAL ssp1601_t *ssp = NULL;
+static MACHINE_LOCAL unsigned short *PC;
+static MACHINE_LOCAL int g_cycles;
 
 #ifdef USE_DEBUGGER
 static int running = 0;
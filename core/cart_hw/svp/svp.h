@@ -26,7 +26,7 @@ typedef struct {
   ssp1601_t ssp1601;
 } svp_t;
 
-extern svp_t *svp;
+extern MACHINE_LOCAL svp_t *svp;
 
 extern void svp_init(void);
 extern void svp_reset(void);
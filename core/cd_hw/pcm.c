@@ -86,7 +86,7 @@ int pcm_context_save(uint8 *state)
   save_param(&pcm.enabled, sizeof(pcm.enabled));
   save_param(&pcm.status, sizeof(pcm.status));
   save_param(&pcm.index, sizeof(pcm.index));
-  save_param(pcm.ram, sizeof(pcm.ram));
+  save_pages(pcm.ram, sizeof(pcm.ram), NULL);
 
   return bufferptr;
 }
@@ -1793,18 +1793,18 @@ int scd_context_save(uint8 *state)
   bufferptr += pcm_context_save(&state[bufferptr]);
 
   /* PRG-RAM */
-  save_param(scd.prg_ram, sizeof(scd.prg_ram));
+  save_pages(scd.prg_ram, sizeof(scd.prg_ram), NULL);
 
   /* Word-RAM */
   if (scd.regs[0x03>>1].byte.l & 0x04)
   {
     /* 1M mode */
-    save_param(scd.word_ram, sizeof(scd.word_ram));
+    save_pages(scd.word_ram[0], sizeof(scd.word_ram), NULL);
   }
   else
   {
     /* 2M mode */
-    save_param(scd.word_ram_2M, sizeof(scd.word_ram_2M));
+    save_pages(scd.word_ram_2M, sizeof(scd.word_ram_2M), NULL);
   }
 
   /* MAIN-CPU & SUB-CPU polling */
@@ -0,0 +1,301 @@
+/***************************************************************************************
+ *  Genesis Plus
+ *  Incremental savestates (checkpoints)
+ *
+ ****************************************************************************************/
+
+#include "shared.h"
+
+/* A checkpoint holds a savestate (see state_save) with its memories split   */
+/* in pages: a full checkpoint holds every page, the following ones only     */
+/* pages modified since the previous checkpoint. Work RAM, Z80 RAM and VRAM  */
+/* pages are marked by their write handlers; PRG-RAM, Word-RAM and PCM RAM,  */
+/* which are also written by DMA and the graphics processor, are compared    */
+/* with the previous checkpoint instead.                                     */
+/*                                                                           */
+/* Layout: "GXCP", sequence number, parent sequence number (0 for a full     */
+/* checkpoint), state size, span count, spans (offset and size of each paged */
+/* memory in the state), page count, pages (span index, page index, data),   */
+/* then the remaining state bytes.                                           */
+
+#define MAX_SPANS 8
+#define HEADER_SIZE 20
+
+typedef struct
+{
+  uint32 offset;      /* in state */
+  uint32 size;
+  const uint8 *data;  /* emulated memory */
+  uint8 *dirty;       /* modified pages */
+} span_t;
+
+MACHINE_LOCAL uint8 work_ram_dirty[0x10000 >> CHECKPOINT_PAGE_SHIFT];
+MACHINE_LOCAL uint8 zram_dirty[0x2000 >> CHECKPOINT_PAGE_SHIFT];
+MACHINE_LOCAL uint8 vram_dirty[0x10000 >> CHECKPOINT_PAGE_SHIFT];
+
+static MACHINE_LOCAL uint8 *scratch;  /* state of the previous checkpoint */
+static MACHINE_LOCAL span_t spans[MAX_SPANS];
+static MACHINE_LOCAL uint32 last_offsets[MAX_SPANS];
+static MACHINE_LOCAL int span_count, last_span_count, last_size;
+static MACHINE_LOCAL uint32 seq;
+static MACHINE_LOCAL int saving;
+
+/* pages of compared memories */
+static MACHINE_LOCAL uint8 compared[(STATE_SIZE >> CHECKPOINT_PAGE_SHIFT) + MAX_SPANS];
+static MACHINE_LOCAL int compared_count;
+
+static uint32 page_length(uint32 size, uint32 page)
+{
+  uint32 length = size - (page << CHECKPOINT_PAGE_SHIFT);
+  return (length < CHECKPOINT_PAGE_SIZE) ? length : CHECKPOINT_PAGE_SIZE;
+}
+
+int state_save_pages(uint8 *state, const uint8 *param, int size, uint8 *dirty)
+{
+  span_t *span;
+  int i, pages;
+
+  if (!saving || (span_count == MAX_SPANS))
+  {
+    memcpy(state, param, size);
+    return size;
+  }
+
+  span = &spans[span_count++];
+  span->offset = state - scratch;
+  span->size = size;
+  span->data = param;
+  span->dirty = dirty;
+
+  /* tracked pages are copied from emulated memory by checkpoint_save */
+  if (!dirty)
+  {
+    pages = (size + CHECKPOINT_PAGE_SIZE - 1) >> CHECKPOINT_PAGE_SHIFT;
+    span->dirty = &compared[compared_count];
+    compared_count += pages;
+
+    for (i = 0; i < pages; i++)
+    {
+      uint32 offset = i << CHECKPOINT_PAGE_SHIFT;
+      span->dirty[i] = memcmp(state + offset, param + offset, page_length(size, i)) != 0;
+    }
+
+    memcpy(state, param, size);
+  }
+
+  return size;
+}
+
+/* Saves a checkpoint of the current state, holding only pages modified since */
+/* the previous one unless full is set. Returns its size, 0 on error.         */
+int checkpoint_save(uint8 *data, int full)
+{
+  uint8 *ptr = data;
+  uint32 header[5], pages = 0, pos = 0;
+  int i, j, size;
+
+  if (!scratch)
+  {
+    scratch = malloc(STATE_SIZE);
+    if (!scratch)
+    {
+      return 0;
+    }
+  }
+
+  span_count = compared_count = 0;
+  saving = 1;
+  size = state_save(scratch);
+  saving = 0;
+
+  /* checkpoints only apply on top of a state with the same layout */
+  if (!seq || (size != last_size) || (span_count != last_span_count))
+  {
+    full = 1;
+  }
+  for (i = 0; i < span_count; i++)
+  {
+    if (spans[i].offset != last_offsets[i])
+    {
+      full = 1;
+    }
+    last_offsets[i] = spans[i].offset;
+  }
+  last_span_count = span_count;
+  last_size = size;
+
+  seq++;
+  header[0] = 0x50435847; /* "GXCP" */
+  header[1] = seq;
+  header[2] = full ? 0 : (seq - 1);
+  header[3] = size;
+  header[4] = span_count;
+  memcpy(ptr, header, HEADER_SIZE);
+  ptr += HEADER_SIZE;
+
+  for (i = 0; i < span_count; i++)
+  {
+    memcpy(ptr, &spans[i].offset, 4);
+    memcpy(ptr + 4, &spans[i].size, 4);
+    ptr += 8;
+  }
+
+  /* page count is written once known */
+  ptr += 4;
+
+  for (i = 0; i < span_count; i++)
+  {
+    span_t *span = &spans[i];
+    int count = (span->size + CHECKPOINT_PAGE_SIZE - 1) >> CHECKPOINT_PAGE_SHIFT;
+
+    for (j = 0; j < count; j++)
+    {
+      if (full || span->dirty[j])
+      {
+        uint16 index[2];
+        uint32 length = page_length(span->size, j);
+
+        index[0] = i;
+        index[1] = j;
+        memcpy(ptr, index, 4);
+        memcpy(ptr + 4, span->data + (j << CHECKPOINT_PAGE_SHIFT), length);
+        ptr += 4 + length;
+        pages++;
+      }
+    }
+
+    memset(span->dirty, 0, count);
+  }
+
+  memcpy(data + HEADER_SIZE + span_count * 8, &pages, 4);
+
+  /* remaining state bytes */
+  for (i = 0; i < span_count; i++)
+  {
+    memcpy(ptr, scratch + pos, spans[i].offset - pos);
+    ptr += spans[i].offset - pos;
+    pos = spans[i].offset + spans[i].size;
+  }
+  memcpy(ptr, scratch + pos, size - pos);
+  ptr += size - pos;
+
+  return ptr - data;
+}
+
+/* Applies a checkpoint to the state rebuilt from the previous ones of the   */
+/* chain (or to any buffer for a full checkpoint). Returns the checkpoint    */
+/* size, 0 on error, in which case the chain restarts from a full checkpoint. */
+int checkpoint_apply(checkpoint_chain_t *chain, uint8 *state, const uint8 *data, int size)
+{
+  const uint8 *ptr = data;
+  const uint8 *end = data + size;
+  uint32 header[5], table[MAX_SPANS][2], pages, pos = 0;
+  uint32 i;
+
+  if (size < HEADER_SIZE)
+  {
+    return 0;
+  }
+
+  memcpy(header, ptr, HEADER_SIZE);
+  ptr += HEADER_SIZE;
+
+  if ((header[0] != 0x50435847) || (header[3] > STATE_SIZE) || (header[4] > MAX_SPANS))
+  {
+    return 0;
+  }
+
+  /* following checkpoints apply on top of their parent only */
+  if (header[2] && (!chain->size || (header[2] != chain->seq) || (header[3] != (uint32)chain->size)))
+  {
+    return 0;
+  }
+
+  if ((end - ptr) < (int)(header[4] * 8 + 4))
+  {
+    return 0;
+  }
+
+  memcpy(table, ptr, header[4] * 8);
+  ptr += header[4] * 8;
+  memcpy(&pages, ptr, 4);
+  ptr += 4;
+
+  for (i = 0; i < header[4]; i++)
+  {
+    if ((table[i][0] < pos) || (table[i][1] > header[3]) || (table[i][0] > header[3] - table[i][1]))
+    {
+      return 0;
+    }
+    pos = table[i][0] + table[i][1];
+  }
+
+  chain->size = 0;
+
+  while (pages--)
+  {
+    uint16 index[2];
+    uint32 length;
+
+    if ((end - ptr) < 4)
+    {
+      return 0;
+    }
+
+    memcpy(index, ptr, 4);
+    ptr += 4;
+
+    if ((index[0] >= header[4]) || ((uint32)index[1] << CHECKPOINT_PAGE_SHIFT) >= table[index[0]][1])
+    {
+      return 0;
+    }
+
+    length = page_length(table[index[0]][1], index[1]);
+    if ((uint32)(end - ptr) < length)
+    {
+      return 0;
+    }
+
+    memcpy(state + table[index[0]][0] + (index[1] << CHECKPOINT_PAGE_SHIFT), ptr, length);
+    ptr += length;
+  }
+
+  /* remaining state bytes */
+  pos = 0;
+  for (i = 0; i <= header[4]; i++)
+  {
+    uint32 next = (i < header[4]) ? table[i][0] : header[3];
+
+    if ((uint32)(end - ptr) < (next - pos))
+    {
+      return 0;
+    }
+
+    memcpy(state + pos, ptr, next - pos);
+    ptr += next - pos;
+
+    if (i < header[4])
+    {
+      pos = next + table[i][1];
+    }
+  }
+
+  chain->seq = header[1];
+  chain->size = header[3];
+  return ptr - data;
+}
+
+/* Memories modified outside of tracked write handlers (reset, state load) */
+void checkpoint_dirty_all(void)
+{
+  memset(work_ram_dirty, 1, sizeof(work_ram_dirty));
+  memset(zram_dirty, 1, sizeof(zram_dirty));
+  memset(vram_dirty, 1, sizeof(vram_dirty));
+}
+
+void checkpoint_shutdown(void)
+{
+  free(scratch);
+  scratch = NULL;
+  seq = 0;
+}
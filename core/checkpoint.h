@@ -0,0 +1,57 @@
+/***************************************************************************************
+ *  Genesis Plus
+ *  Incremental savestates (checkpoints)
+ *
+ ****************************************************************************************/
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHECKPOINT_PAGE_SHIFT 10
+#define CHECKPOINT_PAGE_SIZE  (1 << CHECKPOINT_PAGE_SHIFT)
+
+/* full state, span table and page headers */
+#define CHECKPOINT_MAX_SIZE (STATE_SIZE + 0x2000)
+
+/* Pages modified since the last checkpoint, set by CPU and VDP write handlers */
+extern MACHINE_LOCAL uint8 work_ram_dirty[0x10000 >> CHECKPOINT_PAGE_SHIFT];
+extern MACHINE_LOCAL uint8 zram_dirty[0x2000 >> CHECKPOINT_PAGE_SHIFT];
+extern MACHINE_LOCAL uint8 vram_dirty[0x10000 >> CHECKPOINT_PAGE_SHIFT];
+
+extern MACHINE_LOCAL uint8 work_ram[0x10000];
+
+#define MARK_PAGE_DIRTY(dirty, offset) dirty[((offset) >> CHECKPOINT_PAGE_SHIFT) & (sizeof(dirty) - 1)] = 1
+
+/* Writes through memory map pointers (only work RAM pages are tracked) */
+#define MARK_RAM_DIRTY(ptr)                                 \
+{                                                           \
+  size_t ram_offset = (size_t)(ptr) - (size_t)work_ram;     \
+  if (ram_offset < sizeof(work_ram))                        \
+  {                                                         \
+    work_ram_dirty[ram_offset >> CHECKPOINT_PAGE_SHIFT] = 1; \
+  }                                                         \
+}
+
+/* Rebuilt state of a checkpoint chain */
+typedef struct
+{
+  uint32 seq;   /* last applied checkpoint */
+  int size;     /* rebuilt state size, 0 until a full checkpoint is applied */
+} checkpoint_chain_t;
+
+/* Function prototypes */
+extern int checkpoint_save(uint8 *data, int full);
+extern int checkpoint_apply(checkpoint_chain_t *chain, uint8 *state, const uint8 *data, int size);
+extern void checkpoint_dirty_all(void);
+extern void checkpoint_shutdown(void);
+extern int state_save_pages(uint8 *state, const uint8 *param, int size, uint8 *dirty);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CHECKPOINT_H_ */
@@ -0,0 +1,417 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "condition.h"
+
+enum {
+    COND_OP_END,
+    COND_OP_CONST8, // 1 byte operand
+    COND_OP_CONST32, // 4 bytes operand, little endian
+    COND_OP_REG, // 1 byte operand, COND_D0..COND_SR
+    COND_OP_PC,
+    COND_OP_VALUE,
+    COND_OP_ADDRESS,
+    COND_OP_READ8,
+    COND_OP_READ16,
+    COND_OP_READ32,
+    COND_OP_NEG,
+    COND_OP_NOT,
+    COND_OP_LNOT,
+    COND_OP_BOOL,
+    COND_OP_MUL,
+    COND_OP_DIV,
+    COND_OP_MOD,
+    COND_OP_ADD,
+    COND_OP_SUB,
+    COND_OP_SHL,
+    COND_OP_SHR,
+    COND_OP_LT,
+    COND_OP_LE,
+    COND_OP_GT,
+    COND_OP_GE,
+    COND_OP_EQ,
+    COND_OP_NE,
+    COND_OP_AND,
+    COND_OP_XOR,
+    COND_OP_OR,
+    COND_OP_LAND, // 2 bytes forward jump taken when the top is 0, else pops it
+    COND_OP_LOR, // 2 bytes forward jump taken (top set to 1) when the top is not 0, else pops it
+};
+
+typedef struct {
+    const char *text;
+    int prec;
+    unsigned char op;
+} cond_binary_t;
+
+// longest tokens first
+static const cond_binary_t cond_binary[] = {
+    { "||", 1, COND_OP_LOR },
+    { "&&", 2, COND_OP_LAND },
+    { "==", 6, COND_OP_EQ },
+    { "!=", 6, COND_OP_NE },
+    { "<=", 7, COND_OP_LE },
+    { ">=", 7, COND_OP_GE },
+    { "<<", 8, COND_OP_SHL },
+    { ">>", 8, COND_OP_SHR },
+    { "|", 3, COND_OP_OR },
+    { "^", 4, COND_OP_XOR },
+    { "&", 5, COND_OP_AND },
+    { "<", 7, COND_OP_LT },
+    { ">", 7, COND_OP_GT },
+    { "+", 9, COND_OP_ADD },
+    { "-", 9, COND_OP_SUB },
+    { "*", 10, COND_OP_MUL },
+    { "/", 10, COND_OP_DIV },
+    { "%", 10, COND_OP_MOD },
+};
+
+typedef struct {
+    const char *text, *p;
+    unsigned char *code;
+    int size, max_size;
+    int depth;
+    int error; // offset in text, -1 when none
+} cond_parser_t;
+
+static void fail(cond_parser_t *ps)
+{
+    if (ps->error < 0)
+        ps->error = (int)(ps->p - ps->text);
+}
+
+static void emit(cond_parser_t *ps, unsigned char byte)
+{
+    if (ps->size < ps->max_size)
+        ps->code[ps->size++] = byte;
+    else
+        fail(ps);
+}
+
+// stack effect of the code emitted so far
+static void adjust_depth(cond_parser_t *ps, int delta)
+{
+    ps->depth += delta;
+    if (ps->depth > COND_STACK)
+        fail(ps);
+}
+
+static void emit_const(cond_parser_t *ps, unsigned int value)
+{
+    if (value < 0x100) {
+        emit(ps, COND_OP_CONST8);
+        emit(ps, (unsigned char)value);
+    } else {
+        emit(ps, COND_OP_CONST32);
+        emit(ps, (unsigned char)value);
+        emit(ps, (unsigned char)(value >> 8));
+        emit(ps, (unsigned char)(value >> 16));
+        emit(ps, (unsigned char)(value >> 24));
+    }
+    adjust_depth(ps, 1);
+}
+
+static void skip_spaces(cond_parser_t *ps)
+{
+    while (isspace((unsigned char)*ps->p))
+        ps->p++;
+}
+
+static int is_ident(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// optional .b/.w/.l after a register or value
+static void parse_size(cond_parser_t *ps)
+{
+    char size;
+
+    if (ps->p[0] != '.' || is_ident(ps->p[2]))
+        return;
+
+    size = (char)tolower((unsigned char)ps->p[1]);
+    if (size != 'b' && size != 'w' && size != 'l')
+        return;
+
+    ps->p += 2;
+    if (size == 'l')
+        return;
+
+    emit_const(ps, (size == 'b') ? 0xFF : 0xFFFF);
+    emit(ps, COND_OP_AND);
+    adjust_depth(ps, -1);
+}
+
+static void parse_binary(cond_parser_t *ps, int min_prec);
+
+static void parse_primary(cond_parser_t *ps)
+{
+    char ident[16];
+    int len = 0;
+
+    skip_spaces(ps);
+
+    if (*ps->p == '(') {
+        ps->p++;
+        parse_binary(ps, 1);
+        skip_spaces(ps);
+        if (*ps->p != ')') {
+            fail(ps);
+            return;
+        }
+        ps->p++;
+        return;
+    }
+
+    if (isdigit((unsigned char)*ps->p) || *ps->p == '$') {
+        char *end;
+        unsigned long value = (*ps->p == '$') ? strtoul(ps->p + 1, &end, 16) : strtoul(ps->p, &end, 0);
+
+        if (end == ps->p + 1 && *ps->p == '$') {
+            fail(ps);
+            return;
+        }
+        ps->p = end;
+        emit_const(ps, (unsigned int)value);
+        return;
+    }
+
+    while (is_ident(ps->p[len]) && len < (int)sizeof(ident) - 1) {
+        ident[len] = (char)tolower((unsigned char)ps->p[len]);
+        len++;
+    }
+    ident[len] = '\0';
+
+    if (!len || is_ident(ps->p[len])) {
+        fail(ps);
+        return;
+    }
+
+    if (len == 2 && (ident[0] == 'd' || ident[0] == 'a') && ident[1] >= '0' && ident[1] <= '7') {
+        ps->p += len;
+        emit(ps, COND_OP_REG);
+        emit(ps, (unsigned char)((ident[0] == 'a' ? 8 : 0) + ident[1] - '0'));
+        adjust_depth(ps, 1);
+        parse_size(ps);
+    } else if (!strcmp(ident, "sp") || !strcmp(ident, "sr")) {
+        ps->p += len;
+        emit(ps, COND_OP_REG);
+        emit(ps, (unsigned char)(ident[1] == 'p' ? 15 : COND_SR));
+        adjust_depth(ps, 1);
+        parse_size(ps);
+    } else if (!strcmp(ident, "pc")) {
+        ps->p += len;
+        emit(ps, COND_OP_PC);
+        adjust_depth(ps, 1);
+    } else if (!strcmp(ident, "value")) {
+        ps->p += len;
+        emit(ps, COND_OP_VALUE);
+        adjust_depth(ps, 1);
+        parse_size(ps);
+    } else if (!strcmp(ident, "address") || !strcmp(ident, "addr")) {
+        ps->p += len;
+        emit(ps, COND_OP_ADDRESS);
+        adjust_depth(ps, 1);
+    } else if (!strcmp(ident, "byte") || !strcmp(ident, "word") || !strcmp(ident, "long") || !strcmp(ident, "dword")) {
+        unsigned char op = (ident[0] == 'b') ? COND_OP_READ8 : (ident[0] == 'w') ? COND_OP_READ16 : COND_OP_READ32;
+
+        ps->p += len;
+        skip_spaces(ps);
+        if (*ps->p != '(') {
+            fail(ps);
+            return;
+        }
+        parse_primary(ps);
+        emit(ps, op);
+    } else {
+        fail(ps);
+    }
+}
+
+static void parse_unary(cond_parser_t *ps)
+{
+    char c;
+
+    skip_spaces(ps);
+    c = *ps->p;
+
+    if (c == '!' || c == '~' || c == '-' || c == '+') {
+        ps->p++;
+        parse_unary(ps);
+        if (c == '!')
+            emit(ps, COND_OP_LNOT);
+        else if (c == '~')
+            emit(ps, COND_OP_NOT);
+        else if (c == '-')
+            emit(ps, COND_OP_NEG);
+        return;
+    }
+
+    parse_primary(ps);
+}
+
+static const cond_binary_t *peek_binary(cond_parser_t *ps)
+{
+    int i;
+
+    skip_spaces(ps);
+    for (i = 0; i < (int)(sizeof(cond_binary) / sizeof(cond_binary[0])); ++i) {
+        if (!strncmp(ps->p, cond_binary[i].text, strlen(cond_binary[i].text)))
+            return &cond_binary[i];
+    }
+
+    return NULL;
+}
+
+static void parse_binary(cond_parser_t *ps, int min_prec)
+{
+    const cond_binary_t *op;
+
+    parse_unary(ps);
+
+    while (ps->error < 0 && (op = peek_binary(ps)) && op->prec >= min_prec) {
+        ps->p += strlen(op->text);
+
+        if (op->op == COND_OP_LAND || op->op == COND_OP_LOR) {
+            int patch;
+
+            emit(ps, op->op);
+            patch = ps->size;
+            emit(ps, 0);
+            emit(ps, 0);
+            adjust_depth(ps, -1);
+
+            parse_binary(ps, op->prec + 1);
+            emit(ps, COND_OP_BOOL);
+
+            if (ps->error < 0) {
+                int offset = ps->size - (patch + 2);
+                ps->code[patch] = (unsigned char)offset;
+                ps->code[patch + 1] = (unsigned char)(offset >> 8);
+            }
+        } else {
+            parse_binary(ps, op->prec + 1);
+            emit(ps, op->op);
+            adjust_depth(ps, -1);
+        }
+    }
+}
+
+int cond_compile(const char *text, unsigned char *code, int max_size, int *error)
+{
+    cond_parser_t ps;
+
+    ps.text = ps.p = text;
+    ps.code = code;
+    ps.size = 0;
+    ps.max_size = max_size;
+    ps.depth = 0;
+    ps.error = -1;
+
+    parse_binary(&ps, 1);
+
+    skip_spaces(&ps);
+    if (*ps.p)
+        fail(&ps);
+    emit(&ps, COND_OP_END);
+
+    if (ps.error >= 0) {
+        *error = ps.error;
+        return 0;
+    }
+
+    return ps.size;
+}
+
+unsigned int cond_eval(const unsigned char *code, const cond_env_t *env)
+{
+    unsigned int stack[COND_STACK + 1];
+    int top = 0;
+
+    stack[0] = 0;
+
+    for (;;) {
+        unsigned int b;
+
+        switch (*code++) {
+        case COND_OP_END:
+            return stack[top];
+        case COND_OP_CONST8:
+            stack[++top] = *code++;
+            break;
+        case COND_OP_CONST32:
+            stack[++top] = code[0] | (code[1] << 8) | (code[2] << 16) | ((unsigned int)code[3] << 24);
+            code += 4;
+            break;
+        case COND_OP_REG:
+            stack[++top] = env->reg(*code++);
+            break;
+        case COND_OP_PC:
+            stack[++top] = env->pc;
+            break;
+        case COND_OP_VALUE:
+            stack[++top] = env->value;
+            break;
+        case COND_OP_ADDRESS:
+            stack[++top] = env->address;
+            break;
+        case COND_OP_READ8:
+            stack[top] = env->read(stack[top], 1);
+            break;
+        case COND_OP_READ16:
+            stack[top] = env->read(stack[top], 2);
+            break;
+        case COND_OP_READ32:
+            stack[top] = env->read(stack[top], 4);
+            break;
+        case COND_OP_NEG:
+            stack[top] = 0 - stack[top];
+            break;
+        case COND_OP_NOT:
+            stack[top] = ~stack[top];
+            break;
+        case COND_OP_LNOT:
+            stack[top] = !stack[top];
+            break;
+        case COND_OP_BOOL:
+            stack[top] = !!stack[top];
+            break;
+        case COND_OP_LAND:
+        case COND_OP_LOR:
+        {
+            int taken = (code[-1] == COND_OP_LAND) ? !stack[top] : !!stack[top];
+            if (taken) {
+                stack[top] = (code[-1] == COND_OP_LOR);
+                code += 2 + (code[0] | (code[1] << 8));
+            } else {
+                top--;
+                code += 2;
+            }
+        } break;
+        default:
+            b = stack[top--];
+            switch (code[-1]) {
+            case COND_OP_MUL: stack[top] *= b; break;
+            case COND_OP_DIV: stack[top] = b ? stack[top] / b : 0; break;
+            case COND_OP_MOD: stack[top] = b ? stack[top] % b : 0; break;
+            case COND_OP_ADD: stack[top] += b; break;
+            case COND_OP_SUB: stack[top] -= b; break;
+            case COND_OP_SHL: stack[top] = (b < 32) ? stack[top] << b : 0; break;
+            case COND_OP_SHR: stack[top] = (b < 32) ? stack[top] >> b : 0; break;
+            case COND_OP_LT: stack[top] = stack[top] < b; break;
+            case COND_OP_LE: stack[top] = stack[top] <= b; break;
+            case COND_OP_GT: stack[top] = stack[top] > b; break;
+            case COND_OP_GE: stack[top] = stack[top] >= b; break;
+            case COND_OP_EQ: stack[top] = stack[top] == b; break;
+            case COND_OP_NE: stack[top] = stack[top] != b; break;
+            case COND_OP_AND: stack[top] &= b; break;
+            case COND_OP_XOR: stack[top] ^= b; break;
+            case COND_OP_OR: stack[top] |= b; break;
+            default: return 0;
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef _CONDITION_H_
+#define _CONDITION_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Breakpoint conditions. Expressions are compiled once to a stack bytecode
+// evaluated on every breakpoint hit, a non zero result stops emulation.
+//
+// Syntax is C like, all values are unsigned 32-bit:
+//   numbers      10, 0x1F, $1F
+//   registers    d0-d7, a0-a7, sp, pc, sr, with optional .b/.w/.l size
+//   access       value (read or written), address
+//   memory       byte(x), word(x), long(x) (dword(x)), big endian reads,
+//                I/O and other handler mapped areas read as 0
+//   operators    ! ~ - (unary), * / %, + -, << >>, < <= > >=, == !=,
+//                &, ^, |, &&, ||, parentheses
+// Division by zero yields 0.
+
+#define COND_MAX_CODE 256
+#define COND_STACK 16
+
+enum {
+    COND_D0 = 0, // D0-D7, A0-A7
+    COND_SR = 16,
+    COND_REGS
+};
+
+typedef struct {
+    unsigned int (*reg)(int index); // COND_D0..COND_SR
+    unsigned int (*read)(unsigned int address, int size);
+    unsigned int pc, value, address;
+} cond_env_t;
+
+// Returns the bytecode size, 0 on error with *error set to the offset of the
+// offending character in text.
+int cond_compile(const char *text, unsigned char *code, int max_size, int *error);
+unsigned int cond_eval(const unsigned char *code, const cond_env_t *env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -41,13 +41,27 @@
 #ifdef HOOK_CPU
 
 #include <stdio.h>
+#include <string.h>
 #include "cpuhook.h"
 
 cpu_hook_t cpu_hook = NULL;
+unsigned int cpu_hook_mask = 0;
 
-void set_cpu_hook(cpu_hook_t hook)
+cpu_hook_stats_t cpu_hook_stats;
+cpu_hook_stats_t cpu_hook_frame_stats;
+
+void set_cpu_hook(cpu_hook_t hook, hook_type_t mask)
 {
+	/* mask is cleared first so that no call site sees it with a stale hook */
+	cpu_hook_mask = 0;
 	cpu_hook = hook;
+	cpu_hook_mask = hook ? mask : 0;
+}
+
+void cpu_hook_end_frame(void)
+{
+	cpu_hook_frame_stats = cpu_hook_stats;
+	memset(&cpu_hook_stats, 0, sizeof(cpu_hook_stats));
 }
 
 #endif /* HOOK_CPU */
\ No newline at end of file
@@ -79,14 +79,45 @@ typedef enum {
 
 typedef void (*cpu_hook_t)(hook_type_t type, int width, unsigned int address, unsigned int value);
 
+typedef struct {
+  unsigned int fired;     /* events passed to cpu_hook() */
+  unsigned int filtered;  /* events outside the subscription mask while a hook is set */
+} cpu_hook_stats_t;
+
 /* CPU hook is called on read, write, and execute.
  */
 extern cpu_hook_t cpu_hook;
 
+/* Event classes (hook_type_t bits) cpu_hook() is subscribed to, 0 when no
+ * hook is set.
+ */
+extern unsigned int cpu_hook_mask;
+
+/* Hook counters for the current and for the last completed frame.
+ */
+extern cpu_hook_stats_t cpu_hook_stats;
+extern cpu_hook_stats_t cpu_hook_frame_stats;
+
 /* Use set_cpu_hook() to assign a callback that can process the data provided
- * by cpu_hook().
+ * by cpu_hook(), for the event classes set in mask. While the mask holds any
+ * 68K event, m68k_run() executes the hooked 68K core instance (m68khook.c);
+ * the hook should not be changed from inside m68k_run().
+ */
+void set_cpu_hook(cpu_hook_t hook, hook_type_t mask);
+
+/* Call cpu_hook_end_frame() once per frame to latch cpu_hook_frame_stats.
+ */
+void cpu_hook_end_frame(void);
+
+/* Hook call site: only subscribed event classes reach cpu_hook(). 68K memory
+ * and execution events only reach a call site while the hooked 68K instance
+ * runs, so they are not counted as filtered when no 68K class is subscribed.
  */
-void set_cpu_hook(cpu_hook_t hook);
+#define cpu_hook_call(TYPE, WIDTH, ADDR, VAL) \
+  do { \
+    if (cpu_hook_mask & (TYPE)) { cpu_hook_stats.fired++; cpu_hook(TYPE, WIDTH, ADDR, VAL); } \
+    else if (cpu_hook) cpu_hook_stats.filtered++; \
+  } while (0)
 
 
 #endif /* _CPUHOOK_H_ */
\ No newline at end of file
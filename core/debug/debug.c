@@ -4,6 +4,7 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <stddef.h>
+#include <time.h>
 #include <unistd.h>
 #endif
 
@@ -24,6 +25,11 @@
 
 #include "vdp_ctrl.h"
 #include "z80.h"
+#include "cpuhook.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "condition.h"
+#include "rewind.h"
 
 static int dbg_first_paused, dbg_dont_check_bp, dbg_continue_after_bp;
 int dbg_trace;
@@ -31,6 +37,35 @@ int dbg_step_over;
 int dbg_in_interrupt;
 unsigned int dbg_step_over_addr;
 
+// Reverse execution: a snapshot is taken at the start of every
+// DBG_HISTORY_INTERVAL frames (and of any frame following a pause, since
+// the interrupted frame is never finished), tagged with the number of M68K
+// instructions executed so far. Going back restores the nearest snapshot
+// and replays its frames with the recorded inputs up to the target count.
+#define DBG_HISTORY_INTERVAL 1
+#define DBG_HISTORY_SIZE 1200
+#define DBG_HISTORY_KEYFRAMES 60
+#define DBG_HISTORY_MAX_BYTES (64 << 20)
+
+typedef struct {
+    uint16 pad[MAX_DEVICES];
+    int16 analog[MAX_DEVICES][2];
+} dbg_input_t;
+
+enum {
+    DBG_REPLAY_NONE,
+    DBG_REPLAY_STEP, // pause at the target instruction
+    DBG_REPLAY_SCAN, // record breakpoint hits until the target instruction
+};
+
+static snapshot_ring_t dbg_history;
+static unsigned char *dbg_state;
+static unsigned int dbg_insn_count;
+static int dbg_frame_open, dbg_history_frames;
+static int dbg_replay, dbg_replay_snapshot, dbg_replay_frame;
+static unsigned int dbg_replay_target, dbg_scan_limit, dbg_scan_hit;
+static int dbg_scan_found;
+
 dbg_request_t* dbg_req_core = NULL;
 
 #ifdef _WIN32
@@ -45,10 +80,112 @@ typedef struct breakpoint_s {
     int width;
     bpt_type_t type;
     unsigned int address;
+    unsigned char *cond; // compiled condition, NULL when unconditional
+    unsigned int hit_count, hits;
 } breakpoint_t;
 
 static breakpoint_t *first_bp = NULL;
 
+static breakpoint_t *next_breakpoint(breakpoint_t *bp) {
+    return bp->next != first_bp ? bp->next : 0;
+}
+
+// Address index of enabled breakpoints, one map per bpt_type_t bit.
+// A 64 KB page bitmap rejects most accesses with a single bit test, a second
+// bitmap with 256 byte blocks narrows down pages that do hold a breakpoint
+// (RAM watchpoints usually all live in the same page).
+#define BPT_INDEX_TYPES 11
+#define BPT_INDEX_MASK 0xFFFFFF
+#define BPT_PAGE_SHIFT 16
+#define BPT_BLOCK_SHIFT 8
+
+static unsigned int bpt_index_types;
+static unsigned int bpt_pages[BPT_INDEX_TYPES][(BPT_INDEX_MASK >> BPT_PAGE_SHIFT) / 32 + 1];
+static unsigned int bpt_blocks[BPT_INDEX_TYPES][(BPT_INDEX_MASK >> BPT_BLOCK_SHIFT) / 32 + 1];
+
+#define BPT_BIT_TEST(map, n) ((map)[(n) >> 5] & (1u << ((n) & 31)))
+#define BPT_BIT_SET(map, n) ((map)[(n) >> 5] |= (1u << ((n) & 31)))
+
+static void index_bpt(const breakpoint_t *bp)
+{
+    unsigned int start = bp->address & BPT_INDEX_MASK;
+    unsigned int end = start + (unsigned int)bp->width;
+
+    // a breakpoint covers [address, address + width], see check_breakpoint()
+    if (end > BPT_INDEX_MASK || end < start)
+        end = BPT_INDEX_MASK;
+
+    for (int t = 0; t < BPT_INDEX_TYPES; ++t) {
+        if (!(bp->type & (1 << t)))
+            continue;
+
+        for (unsigned int n = start >> BPT_PAGE_SHIFT; n <= (end >> BPT_PAGE_SHIFT); ++n)
+            BPT_BIT_SET(bpt_pages[t], n);
+        for (unsigned int n = start >> BPT_BLOCK_SHIFT; n <= (end >> BPT_BLOCK_SHIFT); ++n)
+            BPT_BIT_SET(bpt_blocks[t], n);
+
+        bpt_index_types |= (1 << t);
+    }
+}
+
+int get_breakpoints_hook_mask()
+{
+    if (!dbg_req_core || dbg_req_core->dbg_active != 1)
+        return 0;
+
+    // execution is always needed for stepping and pausing, data accesses only
+    // when a breakpoint of that kind is enabled
+    return BPT_M68K_E | (bpt_index_types & (BPT_M68K_RW | BPT_VRAM_RW | BPT_CRAM_RW | BPT_VSRAM_RW));
+}
+
+static void update_hook_mask()
+{
+#ifdef HOOK_CPU
+    if (cpu_hook)
+        set_cpu_hook(cpu_hook, (hook_type_t)get_breakpoints_hook_mask());
+#endif
+}
+
+static void rebuild_bpt_index()
+{
+    breakpoint_t *p;
+
+    bpt_index_types = 0;
+    memset(bpt_pages, 0, sizeof(bpt_pages));
+    memset(bpt_blocks, 0, sizeof(bpt_blocks));
+
+    for (p = first_bp; p; p = next_breakpoint(p)) {
+        if (p->enabled)
+            index_bpt(p);
+    }
+
+    update_hook_mask();
+}
+
+static int is_bpt_indexed(bpt_type_t type, int width, unsigned int address)
+{
+    unsigned int types = type & bpt_index_types;
+
+    if (!types)
+        return 0;
+
+    // an access hits a breakpoint when [address, address + width] overlaps it,
+    // the access itself spans at most two blocks
+    unsigned int first = address & BPT_INDEX_MASK;
+    unsigned int last = (address + width) & BPT_INDEX_MASK;
+
+    for (int t = 0; types; ++t, types >>= 1) {
+        if (!(types & 1))
+            continue;
+
+        if ((BPT_BIT_TEST(bpt_pages[t], first >> BPT_PAGE_SHIFT) && BPT_BIT_TEST(bpt_blocks[t], first >> BPT_BLOCK_SHIFT)) ||
+            (BPT_BIT_TEST(bpt_pages[t], last >> BPT_PAGE_SHIFT) && BPT_BIT_TEST(bpt_blocks[t], last >> BPT_BLOCK_SHIFT)))
+            return 1;
+    }
+
+    return 0;
+}
+
 static breakpoint_t *add_bpt(bpt_type_t type, unsigned int address, int width) {
     breakpoint_t *bp = (breakpoint_t *)malloc(sizeof(breakpoint_t));
 
@@ -56,6 +193,8 @@ static breakpoint_t *add_bpt(bpt_type_t type, unsigned int address, int width) {
     bp->address = address;
     bp->width = width;
     bp->enabled = 1;
+    bp->cond = NULL;
+    bp->hit_count = bp->hits = 0;
 
     if (first_bp) {
         bp->next = first_bp;
@@ -69,6 +208,9 @@ static breakpoint_t *add_bpt(bpt_type_t type, unsigned int address, int width) {
         bp->prev = bp;
     }
 
+    index_bpt(bp);
+    update_hook_mask();
+
     return bp;
 }
 
@@ -85,11 +227,10 @@ static void delete_breakpoint(breakpoint_t * bp) {
     bp->next->prev = bp->prev;
     bp->prev->next = bp->next;
 
+    free(bp->cond);
     free(bp);
-}
 
-static breakpoint_t *next_breakpoint(breakpoint_t *bp) {
-    return bp->next != first_bp ? bp->next : 0;
+    rebuild_bpt_index();
 }
 
 static breakpoint_t *find_breakpoint(unsigned int address, bpt_type_t type) {
@@ -134,6 +275,10 @@ static void get_bpt_data(int index, bpt_data_t *data)
             data->width = p->width;
             data->type = p->type;
             data->enabled = p->enabled;
+            data->hit_count = p->hit_count;
+            data->hits = p->hits;
+            data->cond_set = (p->cond != NULL);
+            data->cond_error = 0;
             break;
         }
         ++i;
@@ -150,15 +295,75 @@ static void init_bpt_list()
         clear_bpt_list();
 }
 
-static void send_dbg_event(unsigned int address, dbg_event_type_t type)
+// Compiles text (empty for none) into the breakpoint condition, returns the
+// offset + 1 of a syntax error or 0.
+static int set_bpt_condition(breakpoint_t *bp, const char *text, unsigned int hit_count)
+{
+    unsigned char code[COND_MAX_CODE];
+    unsigned char *cond = NULL;
+    int size, error;
+
+    while (*text == ' ')
+        text++;
+
+    if (*text) {
+        if (!(size = cond_compile(text, code, sizeof(code), &error)))
+            return error + 1;
+        cond = (unsigned char *)malloc(size);
+        memcpy(cond, code, size);
+    }
+
+    free(bp->cond);
+    bp->cond = cond;
+    bp->hit_count = hit_count;
+    bp->hits = 0;
+    return 0;
+}
+
+static unsigned int cond_reg(int index)
+{
+    return (index < COND_SR) ? REG_DA[index] : m68k_get_reg(M68K_REG_SR);
+}
+
+// Conditions must not touch the bus: a VDP or I/O port read has side
+// effects and would re-enter the hooks, so banks with read handlers read 0.
+static unsigned int cond_read(unsigned int address, int size)
 {
-    dbg_req_core->dbg_events[dbg_req_core->dbg_events_count].pc = address;
-    dbg_req_core->dbg_events[dbg_req_core->dbg_events_count].type = type;
-    dbg_req_core->dbg_events_count += 1;
+    unsigned int value = 0;
+    int i;
+
+    for (i = 0; i < size; ++i, ++address) {
+        const cpu_memory_map *map = &m68k.memory_map[(address >> 16) & 0xff];
+
+        value <<= 8;
+        if (!map->read8 && map->base)
+            value |= READ_BYTE(map->base, address & 0xFFFF);
+    }
+    return value;
+}
+
+static int eval_condition(const breakpoint_t *bp, bpt_type_t type, unsigned int address, unsigned int value)
+{
+    cond_env_t env;
+    unsigned int result;
+
+    env.reg = cond_reg;
+    env.read = cond_read;
+    env.pc = (type == BPT_M68K_E) ? address : REG_PPC;
+    env.value = value;
+    env.address = address;
+
+    dbg_dont_check_bp = 1;
+    result = cond_eval(bp->cond, &env);
+    dbg_dont_check_bp = 0;
+    return result != 0;
 }
 
 void check_breakpoint(bpt_type_t type, int width, unsigned int address, unsigned int value)
 {
+    if (!is_bpt_indexed(type, width, address))
+        return;
+
     if (!dbg_req_core || !dbg_req_core->dbg_active == 1 || dbg_dont_check_bp)
         return;
 
@@ -166,9 +371,28 @@ void check_breakpoint(bpt_type_t type, int width, unsigned int address, unsigned
     for (bp = first_bp; bp; bp = next_breakpoint(bp)) {
         if (!(bp->type & type) || !bp->enabled) continue;
         if ((address <= (bp->address + bp->width)) && ((address + width) >= bp->address)) {
+            // only true hits stop emulation
+            if (bp->cond && !eval_condition(bp, type, address, value))
+                continue;
+
+            // hit counts are not replayed, any true hit is reported
+            if (dbg_replay == DBG_REPLAY_SCAN) {
+                // where the debugger would have stopped: before the
+                // instruction for execute breakpoints, after it otherwise
+                unsigned int position = dbg_insn_count + (type != BPT_M68K_E);
+                if (position < dbg_scan_limit) {
+                    dbg_scan_hit = position;
+                    dbg_scan_found = 1;
+                }
+                break;
+            }
+
+            if (++bp->hits < bp->hit_count)
+                continue;
+
             dbg_req_core->dbg_paused = 1;
 
-            send_dbg_event(address, DBG_EVT_BREAK);
+            send_dbg_event(dbg_req_core, address, DBG_EVT_BREAK);
             break;
         }
     }
@@ -195,11 +419,13 @@ static void detach_debugger()
 static void activate_debugger()
 {
     dbg_req_core->dbg_active = 1;
+    update_hook_mask();
 }
 
 static void deactivate_debugger()
 {
     dbg_req_core->dbg_active = 0;
+    update_hook_mask();
 }
 
 static unsigned int calc_step(int is_step_in) {
@@ -324,6 +550,472 @@ static unsigned int calc_step(int is_step_in) {
     return dest_pc;
 }
 
+static unsigned int get_time_us()
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (unsigned int)(now.QuadPart * 1000000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned int)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+}
+
+static void update_history_stats()
+{
+    history_stats_t *history = &dbg_req_core->history;
+
+    history->position = dbg_insn_count;
+    history->oldest = dbg_history.count ? snapshot_tag(&dbg_history, 0) : dbg_insn_count;
+    history->snapshots = dbg_history.count;
+    history->keyframes = dbg_history.keyframes;
+    history->bytes = dbg_history.bytes;
+}
+
+static void init_history()
+{
+    if (!dbg_state) {
+        dbg_state = malloc(STATE_SIZE);
+        if (dbg_state && !snapshot_ring_init(&dbg_history, DBG_HISTORY_SIZE, DBG_HISTORY_KEYFRAMES,
+                                             DBG_HISTORY_MAX_BYTES, DBG_HISTORY_INTERVAL * sizeof(dbg_input_t))) {
+            free(dbg_state);
+            dbg_state = NULL;
+        }
+    }
+    else {
+        snapshot_ring_clear(&dbg_history);
+    }
+
+    dbg_insn_count = 0;
+    dbg_frame_open = dbg_history_frames = 0;
+    dbg_replay = DBG_REPLAY_NONE;
+}
+
+static void free_history()
+{
+    if (dbg_state) {
+        snapshot_ring_free(&dbg_history);
+        free(dbg_state);
+        dbg_state = NULL;
+    }
+}
+
+void begin_debug_frame()
+{
+    if (!dbg_req_core || dbg_req_core->dbg_active != 1 || !dbg_first_paused || !dbg_state)
+        return;
+
+    if (!dbg_history.count || dbg_frame_open || dbg_history_frames >= DBG_HISTORY_INTERVAL) {
+        snapshot_push(&dbg_history, dbg_state, state_save(dbg_state), dbg_insn_count);
+        dbg_history_frames = 0;
+        update_history_stats();
+    }
+
+    dbg_frame_open = 1;
+}
+
+void end_debug_frame()
+{
+    if (!dbg_frame_open)
+        return;
+
+    dbg_frame_open = 0;
+    dbg_history_frames++;
+}
+
+void update_debug_input()
+{
+    dbg_input_t *frame_input;
+
+    if (dbg_replay != DBG_REPLAY_NONE) {
+        if (dbg_replay_frame >= DBG_HISTORY_INTERVAL)
+            return;
+
+        frame_input = (dbg_input_t *)snapshot_user(&dbg_history, dbg_replay_snapshot) + dbg_replay_frame;
+        memcpy(input.pad, frame_input->pad, sizeof(input.pad));
+        memcpy(input.analog, frame_input->analog, sizeof(input.analog));
+    }
+    else if (dbg_frame_open && dbg_history.count) {
+        frame_input = (dbg_input_t *)snapshot_user(&dbg_history, dbg_history.count - 1) + dbg_history_frames;
+        memcpy(frame_input->pad, input.pad, sizeof(input.pad));
+        memcpy(frame_input->analog, input.analog, sizeof(input.analog));
+    }
+}
+
+// newest snapshot taken at or before position
+static int find_snapshot(unsigned int position)
+{
+    int i;
+
+    for (i = dbg_history.count - 1; i >= 0; --i) {
+        if (snapshot_tag(&dbg_history, i) <= position)
+            return i;
+    }
+
+    return -1;
+}
+
+static int restore_snapshot(int index)
+{
+    if (!snapshot_get(&dbg_history, index, dbg_state) || !state_load_hot(dbg_state))
+        return 0;
+
+    dbg_insn_count = snapshot_tag(&dbg_history, index);
+    dbg_replay_snapshot = index;
+    dbg_replay_frame = 0;
+
+    dbg_trace = dbg_step_over = dbg_in_interrupt = dbg_continue_after_bp = 0;
+    dbg_step_over_addr = 0;
+    return 1;
+}
+
+static void check_replay_position()
+{
+    if ((dbg_replay == DBG_REPLAY_STEP && dbg_insn_count == dbg_replay_target) ||
+        (dbg_replay == DBG_REPLAY_SCAN && dbg_insn_count >= dbg_replay_target)) {
+        longjmp(jmp_env, 1);
+    }
+}
+
+// Runs frames from the restored snapshot until the execute hook reaches the
+// target (it longjmps back here) or the snapshot frames are exhausted. The
+// emulator is left paused in the middle of a frame, like after a breakpoint.
+static int replay_to(int mode, unsigned int target)
+{
+    jmp_buf frame_env;
+    volatile int frames = 0;
+    volatile int reached = 1;
+#ifdef HOOK_CPU
+    // replayed instructions are already in the trace
+    int tracing = trace_m68k_active;
+    trace_m68k_active = 0;
+#endif
+
+    memcpy(frame_env, jmp_env, sizeof(jmp_buf));
+
+    dbg_replay = mode;
+    dbg_replay_target = target;
+    dbg_dont_check_bp = (mode == DBG_REPLAY_STEP);
+    dbg_req_core->dbg_paused = 0;
+
+    if (!setjmp(jmp_env)) {
+        static int16 sound[3068];
+
+        while (frames++ <= DBG_HISTORY_INTERVAL) {
+            if (system_hw == SYSTEM_MCD)
+                system_frame_scd(0);
+            else if ((system_hw & SYSTEM_PBC) == SYSTEM_MD)
+                system_frame_gen(0);
+            else
+                system_frame_sms(0);
+
+            audio_update(sound);
+            dbg_replay_frame++;
+        }
+
+        reached = 0;
+    }
+
+    memcpy(jmp_env, frame_env, sizeof(jmp_buf));
+#ifdef HOOK_CPU
+    trace_m68k_active = tracing;
+#endif
+
+    dbg_replay = DBG_REPLAY_NONE;
+    dbg_dont_check_bp = 0;
+    dbg_req_core->dbg_paused = 1;
+    dbg_frame_open = 1;
+
+    // do not break again on the current instruction when resuming
+    dbg_continue_after_bp = reached;
+
+    return reached;
+}
+
+static void step_back()
+{
+    unsigned int start = get_time_us();
+    unsigned int target = dbg_insn_count - 1;
+    int index;
+
+    if (dbg_insn_count && (index = find_snapshot(target)) >= 0 && restore_snapshot(index)) {
+        snapshot_truncate(&dbg_history, index + 1);
+        replay_to(DBG_REPLAY_STEP, target);
+    }
+
+    update_history_stats();
+    dbg_req_core->history.last_us = get_time_us() - start;
+}
+
+// Scans snapshot intervals backwards, replaying each one with breakpoints
+// recorded instead of taken, then replays up to the last hit found. Without
+// any hit the emulator stops at the oldest snapshot.
+static void reverse_continue()
+{
+    unsigned int start = get_time_us();
+    unsigned int end = dbg_insn_count;
+    int index = dbg_insn_count ? find_snapshot(dbg_insn_count - 1) : -1;
+
+    dbg_scan_limit = dbg_insn_count;
+    dbg_scan_found = 0;
+
+    for (; index >= 0 && restore_snapshot(index); --index) {
+        replay_to(DBG_REPLAY_SCAN, end);
+        if (dbg_scan_found)
+            break;
+
+        end = snapshot_tag(&dbg_history, index);
+    }
+
+    if (!dbg_scan_found) {
+        index = 0;
+        dbg_scan_hit = dbg_history.count ? snapshot_tag(&dbg_history, 0) : dbg_insn_count;
+    }
+
+    if (dbg_history.count && restore_snapshot(index)) {
+        snapshot_truncate(&dbg_history, index + 1);
+        replay_to(DBG_REPLAY_STEP, dbg_scan_hit);
+    }
+
+    update_history_stats();
+    dbg_req_core->history.last_us = get_time_us() - start;
+}
+
+static void update_rewind_stats()
+{
+    dbg_rewind_t *rewind = &dbg_req_core->rewind;
+
+    rewind->budget = rewind_stats.budget;
+    rewind->available = rewind_stats.frames;
+    rewind->bytes = rewind_stats.bytes;
+    rewind->last_bytes = rewind_stats.last_bytes;
+    rewind->avg_bytes = (rewind_stats.captures > 1) ? (unsigned int)(rewind_stats.total_bytes / (rewind_stats.captures - 1)) : 0;
+}
+
+// Called after every emulated frame when the rewind buffer is enabled.
+void capture_rewind_frame()
+{
+    unsigned int start;
+
+    if (!rewind_stats.budget)
+        return;
+
+    start = get_time_us();
+    rewind_capture();
+
+    if (dbg_req_core) {
+        dbg_req_core->rewind.capture_us = get_time_us() - start;
+        update_rewind_stats();
+    }
+}
+
+int rewind_frames(int frames)
+{
+    unsigned int start = get_time_us();
+
+    frames = rewind_step(frames);
+
+    // snapshots of the reverse debugging history are now in the future
+    if (frames && dbg_state)
+        init_history();
+
+    if (dbg_req_core) {
+        dbg_req_core->rewind.restore_us = get_time_us() - start;
+        update_rewind_stats();
+        update_history_stats();
+    }
+
+    return frames;
+}
+
+#ifdef HOOK_CPU
+static void update_trace_stats()
+{
+    dbg_trace_t *trace = &dbg_req_core->trace;
+
+    trace->active = trace_m68k_active;
+    trace->entries = trace_stats.entries;
+    trace->raw_bytes = trace_stats.raw_bytes;
+    trace->packed_bytes = trace_stats.packed_bytes;
+    trace->blocks = trace_stats.blocks;
+    trace->stored = trace_stats.stored;
+    trace->frames = trace_stats.frames;
+    trace->stall_us = trace_stats.stall_us;
+    trace->compress_us = trace_stats.compress_us;
+    trace->elapsed_us = trace_stats.elapsed_us;
+    trace->error = trace_stats.error;
+}
+#endif
+
+// Bulk memory access for the debugger. Banks mapped to plain memory
+// (cart.rom, work_ram, zram) and VDP memories are copied directly; only
+// banks with read/write handlers go through the bus, one byte at a time.
+static void read_68k_block(unsigned int address, unsigned char *data, int size)
+{
+    while (size > 0)
+    {
+        const cpu_memory_map *map = &m68k.memory_map[(address >> 16) & 0xff];
+        unsigned int offset = address & 0xFFFF;
+        int chunk = 0x10000 - offset;
+        if (chunk > size)
+            chunk = size;
+
+        if (!map->read8 && map->base)
+        {
+#ifdef LSB_FIRST
+            for (int i = 0; i < chunk; ++i)
+                data[i] = READ_BYTE(map->base, offset + i);
+#else
+            memcpy(data, map->base + offset, chunk);
+#endif
+        }
+        else
+        {
+            for (int i = 0; i < chunk; ++i)
+                data[i] = m68ki_read_8(address + i);
+        }
+
+        address += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+static void write_68k_block(unsigned int address, const unsigned char *data, int size)
+{
+    while (size > 0)
+    {
+        const cpu_memory_map *map = &m68k.memory_map[(address >> 16) & 0xff];
+        unsigned int offset = address & 0xFFFF;
+        int chunk = 0x10000 - offset;
+        if (chunk > size)
+            chunk = size;
+
+        if (!map->write8 && map->base)
+        {
+#ifdef LSB_FIRST
+            for (int i = 0; i < chunk; ++i)
+                WRITE_BYTE(map->base, offset + i, data[i]);
+#else
+            memcpy(map->base + offset, data, chunk);
+#endif
+            for (int i = 0; i < chunk; i += CHECKPOINT_PAGE_SIZE)
+                MARK_RAM_DIRTY(map->base + offset + i);
+            MARK_RAM_DIRTY(map->base + offset + chunk - 1);
+        }
+        else
+        {
+            for (int i = 0; i < chunk; ++i)
+                m68ki_write_8(address + i, data[i]);
+        }
+
+        address += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+// Work RAM writes wrap within 0xFF0000-0xFFFFFF like the 68K bus mirror
+static void write_68k_ram(unsigned int address, const unsigned char *data, int size)
+{
+    while (size > 0)
+    {
+        unsigned int offset = address & 0xFFFF;
+        int chunk = 0x10000 - offset;
+        if (chunk > size)
+            chunk = size;
+
+        write_68k_block(0xFF0000 | offset, data, chunk);
+
+        address += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+static int is_zram_address(unsigned int address)
+{
+    // Z80 RAM and its mirror, anything above is banked or I/O
+    return ((system_hw & SYSTEM_PBC) == SYSTEM_MD) && ((address & 0xFFFF) < 0x4000);
+}
+
+static void read_z80_block(unsigned int address, unsigned char *data, int size)
+{
+    for (int i = 0; i < size; ++i)
+        data[i] = is_zram_address(address + i) ? zram[(address + i) & 0x1FFF] : z80_readmem(address + i);
+}
+
+static void write_z80_block(unsigned int address, const unsigned char *data, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        if (is_zram_address(address + i))
+        {
+            zram[(address + i) & 0x1FFF] = data[i];
+            MARK_PAGE_DIRTY(zram_dirty, (address + i) & 0x1FFF);
+        }
+        else
+            z80_writemem(address + i, data[i]);
+    }
+}
+
+static unsigned int cram_bus_word(unsigned int address)
+{
+    unsigned int data = *(uint16 *)&cram[address & 0x7E];
+
+    // Modes 0-4 keep the native palette word (6-bit SMS, 12-bit GG), see vdp_debug_cram_w
+    if (!(system_hw & SYSTEM_MD) || !(reg[1] & 0x04))
+        return data;
+
+    // 9-bit CRAM data (BBBGGGRRR) to 16-bit bus data (BBB0GGG0RRR0)
+    return ((data & 0x1C0) << 3) | ((data & 0x038) << 2) | ((data & 0x007) << 1);
+}
+
+static void read_vdp_block(request_type_t type, unsigned int address, unsigned char *data, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        unsigned int addr = address + i;
+
+        switch (type)
+        {
+        case REQ_READ_VRAM: data[i] = READ_BYTE(vram, addr & 0xFFFF); break;
+        case REQ_READ_CRAM: data[i] = (cram_bus_word(addr) >> ((~addr & 1) << 3)) & 0xFF; break;
+        case REQ_READ_VSRAM: data[i] = READ_BYTE(vsram, addr & 0x7F); break;
+        default:
+            break;
+        }
+    }
+}
+
+static void write_vdp_block(request_type_t type, unsigned int address, const unsigned char *data, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        unsigned int addr = address + i;
+
+        switch (type)
+        {
+        case REQ_WRITE_VRAM: vdp_debug_vram_w(addr, data[i]); break;
+        case REQ_WRITE_CRAM:
+        {
+            unsigned int word = cram_bus_word(addr);
+            if (addr & 1)
+                word = (word & 0xFF00) | data[i];
+            else
+                word = (word & 0x00FF) | (data[i] << 8);
+            vdp_debug_cram_w(addr, word);
+        } break;
+        case REQ_WRITE_VSRAM: WRITE_BYTE(vsram, addr & 0x7F, data[i]); break;
+        default:
+            break;
+        }
+    }
+}
+
 void process_request()
 {
     if (!dbg_req_core || dbg_req_core->dbg_active != 1)
@@ -514,20 +1206,23 @@ void process_request()
     case REQ_READ_68K_ROM:
     case REQ_READ_68K_RAM:
     case REQ_READ_Z80:
+    case REQ_READ_VRAM:
+    case REQ_READ_CRAM:
+    case REQ_READ_VSRAM:
     {
         dbg_dont_check_bp = 1;
 
         memory_data_t *mem_data = &dbg_req_core->mem_data;
-        for (int i = 0; i < mem_data->size; ++i)
+        unsigned char *data = dbg_data(dbg_req_core);
+        if (mem_data->size > DBG_DATA_SIZE)
+            mem_data->size = DBG_DATA_SIZE;
+
+        switch (dbg_req_core->req_type)
         {
-            switch (dbg_req_core->req_type)
-            {
-            case REQ_READ_68K_ROM: mem_data->m68k_rom[mem_data->address + i] = m68ki_read_8(mem_data->address + i); break;
-            case REQ_READ_68K_RAM: mem_data->m68k_ram[(mem_data->address + i) & 0xFFFF] = m68ki_read_8(mem_data->address + i); break;
-            case REQ_READ_Z80: mem_data->z80_ram[(mem_data->address + i) & 0x1FFF] = z80_readmem(mem_data->address + i); break;
-            default:
-                break;
-            }
+        case REQ_READ_68K_ROM:
+        case REQ_READ_68K_RAM: read_68k_block(mem_data->address, data, mem_data->size); break;
+        case REQ_READ_Z80: read_z80_block(mem_data->address, data, mem_data->size); break;
+        default: read_vdp_block(dbg_req_core->req_type, mem_data->address, data, mem_data->size); break;
         }
 
         dbg_dont_check_bp = 0;
@@ -535,20 +1230,23 @@ void process_request()
     case REQ_WRITE_68K_ROM:
     case REQ_WRITE_68K_RAM:
     case REQ_WRITE_Z80:
+    case REQ_WRITE_VRAM:
+    case REQ_WRITE_CRAM:
+    case REQ_WRITE_VSRAM:
     {
         dbg_dont_check_bp = 1;
 
         memory_data_t *mem_data = &dbg_req_core->mem_data;
-        for (int i = 0; i < mem_data->size; ++i)
+        unsigned char *data = dbg_data(dbg_req_core);
+        if (mem_data->size > DBG_DATA_SIZE)
+            mem_data->size = DBG_DATA_SIZE;
+
+        switch (dbg_req_core->req_type)
         {
-            switch (dbg_req_core->req_type)
-            {
-            case REQ_WRITE_68K_ROM: m68ki_write_8(mem_data->address + i, mem_data->m68k_rom[mem_data->address + i]); break;
-            case REQ_WRITE_68K_RAM: m68ki_write_8(0xFF0000 | ((mem_data->address + i) & 0xFFFF), mem_data->m68k_ram[(mem_data->address + i) & 0xFFFF]); break;
-            case REQ_WRITE_Z80: z80_writemem(mem_data->address + i, mem_data->z80_ram[(mem_data->address + i) & 0x1FFF]); break;
-            default:
-                break;
-            }
+        case REQ_WRITE_68K_ROM: write_68k_block(mem_data->address, data, mem_data->size); m68k_block_flush(); break;
+        case REQ_WRITE_68K_RAM: write_68k_ram(mem_data->address, data, mem_data->size); break;
+        case REQ_WRITE_Z80: write_z80_block(mem_data->address, data, mem_data->size); break;
+        default: write_vdp_block(dbg_req_core->req_type, mem_data->address, data, mem_data->size); break;
         }
 
         dbg_dont_check_bp = 0;
@@ -556,16 +1254,31 @@ void process_request()
     case REQ_ADD_BREAK:
     {
         bpt_data_t *bpt_data = &dbg_req_core->bpt_data;
-        if (!find_breakpoint(bpt_data->address, bpt_data->type))
-            add_bpt(bpt_data->type, bpt_data->address, bpt_data->width);
+        breakpoint_t *bp = find_breakpoint(bpt_data->address, bpt_data->type);
+        int added = (bp == NULL);
+
+        if (added)
+            bp = add_bpt(bpt_data->type, bpt_data->address, bpt_data->width);
+
+        bpt_data->cond_error = 0;
+        if (bpt_data->cond_set) {
+            char *text = (char *)dbg_data(dbg_req_core);
+            text[dbg_req_core->data_size - 1] = '\0';
+
+            // a breakpoint with a bad condition would stop on every hit
+            if ((bpt_data->cond_error = set_bpt_condition(bp, text, bpt_data->hit_count)) && added)
+                delete_breakpoint(bp);
+        }
     } break;
     case REQ_TOGGLE_BREAK:
     {
         bpt_data_t *bpt_data = &dbg_req_core->bpt_data;
         breakpoint_t *bp = find_breakpoint(bpt_data->address, bpt_data->type);
 
-        if (bp != NULL)
+        if (bp != NULL) {
             bp->enabled = !bp->enabled;
+            rebuild_bpt_index();
+        }
     } break;
     case REQ_DEL_BREAK:
     {
@@ -577,9 +1290,12 @@ void process_request()
     case REQ_LIST_BREAKS:
     {
         bpt_list_t *bpt_list = &dbg_req_core->bpt_list;
+        bpt_data_t *breaks = (bpt_data_t *)dbg_data(dbg_req_core);
         bpt_list->count = count_bpt_list();
+        if (bpt_list->count > (int)(DBG_DATA_SIZE / sizeof(bpt_data_t)))
+            bpt_list->count = DBG_DATA_SIZE / sizeof(bpt_data_t);
         for (int i = 0; i < bpt_list->count; ++i)
-            get_bpt_data(i, &bpt_list->breaks[i]);
+            get_bpt_data(i, &breaks[i]);
     } break;
     case REQ_ATTACH:
         activate_debugger();
@@ -594,6 +1310,43 @@ void process_request()
     case REQ_STOP:
         stop_debugging();
         break;
+    case REQ_GET_HOOK_STATS:
+    {
+        hook_stats_t *hook_stats = &dbg_req_core->hook_stats;
+#ifdef HOOK_CPU
+        hook_stats->mask = cpu_hook_mask;
+        hook_stats->fired = cpu_hook_frame_stats.fired;
+        hook_stats->filtered = cpu_hook_frame_stats.filtered;
+#else
+        memset(hook_stats, 0, sizeof(hook_stats_t));
+#endif
+    } break;
+    case REQ_CLEAR_COVERAGE:
+    {
+        clear_dbg_coverage(dbg_req_core);
+    } break;
+    case REQ_TRACE_START:
+    case REQ_TRACE_STOP:
+    {
+        dbg_trace_t *trace = &dbg_req_core->trace;
+#ifdef HOOK_CPU
+        if (dbg_req_core->req_type == REQ_TRACE_START) {
+            char *path = (char *)dbg_data(dbg_req_core);
+            path[dbg_req_core->data_size - 1] = '\0';
+            trace_start(path, trace->flags);
+        } else {
+            trace_stop();
+        }
+        update_trace_stats();
+#else
+        memset(trace, 0, sizeof(dbg_trace_t));
+#endif
+    } break;
+    case REQ_REWIND:
+    {
+        dbg_rewind_t *rewind = &dbg_req_core->rewind;
+        rewind->frames = rewind_frames(rewind->frames);
+    } break;
     case REQ_STEP_INTO:
     case REQ_STEP_OVER:
     {
@@ -616,16 +1369,27 @@ void process_request()
             dbg_req_core->dbg_paused = 0;
         }
     } break;
+    case REQ_STEP_BACK:
+    case REQ_REVERSE_CONTINUE:
+    {
+        if (dbg_req_core->dbg_paused && dbg_state)
+        {
+            if (dbg_req_core->req_type == REQ_STEP_BACK)
+                step_back();
+            else
+                reverse_continue();
+        }
+    } break;
     default:
         break;
     }
 
-    dbg_req_core->req_type = REQ_NO_REQUEST;
+    ack_dbg_request(dbg_req_core);
 }
 
 void stop_debugging()
 {
-    send_dbg_event(0, DBG_EVT_STOPPED);
+    send_dbg_event(dbg_req_core, 0, DBG_EVT_STOPPED);
     detach_debugger();
 #ifdef _WIN32
     Sleep(1000);
@@ -633,6 +1397,10 @@ void stop_debugging()
     usleep(1000 * 1000);
 #endif
     deactivate_debugger();
+    free_history();
+#ifdef HOOK_CPU
+    trace_stop();
+#endif
 
     dbg_first_paused = dbg_req_core->dbg_paused = dbg_trace = dbg_dont_check_bp = dbg_step_over = dbg_step_over_addr = dbg_in_interrupt = dbg_continue_after_bp = 0;
 }
@@ -645,6 +1413,7 @@ void start_debugging()
     activate_debugger();
 
     init_bpt_list();
+    init_history();
 
     dbg_first_paused = dbg_req_core->dbg_paused = dbg_trace = dbg_dont_check_bp = dbg_step_over = dbg_step_over_addr = dbg_in_interrupt = dbg_continue_after_bp = 0;
 }
@@ -654,79 +1423,86 @@ int is_debugger_accessible()
     return (dbg_req_core != NULL);
 }
 
-void process_breakpoints(bpt_type_t type, int width, unsigned int address, unsigned int value) {
-    if (!dbg_req_core || dbg_req_core->dbg_active != 1)
+static void process_execute(unsigned int address) {
+    if (dbg_first_paused && dbg_in_interrupt) {
+        unsigned int pc = REG_PC;
+        unsigned short opc = m68k_read_immediate_16(pc);
+
+        if (opc != 0x4E73) { // rte
+            return;
+        }
+
+        dbg_in_interrupt = 0; // we at rte
         return;
+    }
 
-    switch (type) {
-    case BPT_M68K_E: {
-        if (dbg_first_paused && dbg_in_interrupt) {
-            unsigned int pc = REG_PC;
-            unsigned short opc = m68k_read_immediate_16(pc);
+    if (dbg_req_core->dbg_paused && dbg_first_paused && !dbg_trace) {
+        longjmp(jmp_env, 1);
+    }
 
-            if (opc != 0x4E73) { // rte
-                break;
-            }
+    if (!dbg_first_paused) {
+        dbg_first_paused = 1;
+        dbg_req_core->dbg_paused = 1;
 
-            dbg_in_interrupt = 0; // we at rte
-            break;
-        }
+        send_dbg_event(dbg_req_core, address, DBG_EVT_STARTED);
+    }
 
-        if (dbg_req_core->dbg_paused && dbg_first_paused && !dbg_trace) {
-            longjmp(jmp_env, 1);
-        }
+    if (dbg_trace) {
+        dbg_trace = 0;
+        dbg_req_core->dbg_paused = 1;
 
-        if (!dbg_first_paused) {
-            dbg_first_paused = 1;
-            dbg_req_core->dbg_paused = 1;
+        send_dbg_event(dbg_req_core, address, DBG_EVT_STEP);
+        return;
+    }
 
-            send_dbg_event(address, DBG_EVT_STARTED);
-        }
+    if (!dbg_req_core->dbg_paused) {
+        mark_dbg_coverage(dbg_req_core, address);
 
-        if (dbg_trace) {
-            dbg_trace = 0;
-            dbg_req_core->dbg_paused = 1;
+        if (dbg_step_over && address == dbg_step_over_addr) {
+            dbg_step_over = 0;
+            dbg_step_over_addr = 0;
 
-            send_dbg_event(address, DBG_EVT_STEP);
-            break;
-        }
+            dbg_req_core->dbg_paused = 1;
 
-        if (!dbg_req_core->dbg_paused) {
-            if (address < MAXROMSIZE && !dbg_req_core->pc_map[address >> 1].applied) {
-                dbg_req_core->pc_map[address >> 1].to_apply = 1;
-            }
+            send_dbg_event(dbg_req_core, address, DBG_EVT_STEP);
 
-            if (dbg_step_over && address == dbg_step_over_addr) {
-                dbg_step_over = 0;
-                dbg_step_over_addr = 0;
+            longjmp(jmp_env, 1);
+        }
 
-                dbg_req_core->dbg_paused = 1;
+        if (!dbg_continue_after_bp) {
+            check_breakpoint(BPT_M68K_E, 1, address, address);
+        }
 
-                send_dbg_event(address, DBG_EVT_STEP);
+        if (dbg_req_core->dbg_paused) {
+            dbg_continue_after_bp = 1;
 
-                longjmp(jmp_env, 1);
+            longjmp(jmp_env, 1);
+        }
+        else {
+            if (dbg_continue_after_bp) {
+                dbg_continue_after_bp = 0;
             }
+        }
+    }
+    else {
+        send_dbg_event(dbg_req_core, address, DBG_EVT_PAUSED);
 
-            if (!dbg_continue_after_bp) {
-                check_breakpoint(BPT_M68K_E, 1, address, address);
-            }
+        longjmp(jmp_env, 1);
+    }
+}
 
-            if (dbg_req_core->dbg_paused) {
-                dbg_continue_after_bp = 1;
+void process_breakpoints(bpt_type_t type, int width, unsigned int address, unsigned int value) {
+    if (!dbg_req_core || dbg_req_core->dbg_active != 1)
+        return;
 
-                longjmp(jmp_env, 1);
-            }
-            else {
-                if (dbg_continue_after_bp) {
-                    dbg_continue_after_bp = 0;
-                }
-            }
-        }
-        else {
-            send_dbg_event(address, DBG_EVT_PAUSED);
+    switch (type) {
+    case BPT_M68K_E: {
+        if (dbg_replay != DBG_REPLAY_NONE)
+            check_replay_position();
 
-            longjmp(jmp_env, 1);
-        }
+        // returns only if the instruction is going to be executed
+        process_execute(address);
+        dbg_insn_count++;
     } break;
     default: {
         check_breakpoint(type, width, address, value);
@@ -15,6 +15,12 @@ extern void process_request();
 extern int is_debugger_paused();
 extern void resume_debugger();
 extern void process_breakpoints(bpt_type_t type, int width, unsigned int address, unsigned int value);
+extern int get_breakpoints_hook_mask();
+extern void begin_debug_frame();
+extern void end_debug_frame();
+extern void update_debug_input();
+extern void capture_rewind_frame();
+extern int rewind_frames(int frames);
 
 extern int dbg_trace;
 extern int dbg_step_over;
@@ -3,10 +3,19 @@
 #else
 #include <sys/mman.h>
 #include <fcntl.h>
-#include <stddef.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <limits.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 #endif
 
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "debug_wrap.h"
 
 #ifdef _WIN32
@@ -15,19 +24,99 @@ static HANDLE hMapFile = NULL;
 static int shm;
 #endif
 
+typedef char dbg_header_size_check[(sizeof(dbg_request_t) <= DBG_HEADER_SIZE) ? 1 : -1];
+
+// Both sides block on a 32-bit word of the shared mapping until it changes:
+// futex on Linux, named auto-reset events on Windows, short sleeps elsewhere.
+// Waits always time out so that callers can re-check dbg_active.
+enum {
+    DBG_SYNC_REQ, // request posted, emulator waits
+    DBG_SYNC_ACK, // request handled, debugger waits
+    DBG_SYNC_EVT, // event pushed, debugger waits
+    DBG_SYNC_COUNT
+};
+
+#ifdef _WIN32
+static HANDLE hSync[DBG_SYNC_COUNT];
+static const char *const sync_names[DBG_SYNC_COUNT] = {
+    SHARED_MEM_NAME "_REQ",
+    SHARED_MEM_NAME "_ACK",
+    SHARED_MEM_NAME "_EVT",
+};
+
+#define LOAD_ACQ(p) (MemoryBarrier(), *(volatile unsigned int *)(p))
+#define STORE_REL(p, v) do { MemoryBarrier(); *(volatile unsigned int *)(p) = (v); } while (0)
+#define STORE_REL_8(p, v) do { MemoryBarrier(); *(volatile unsigned char *)(p) = (v); } while (0)
+#else
+#define LOAD_ACQ(p) __atomic_load_n((unsigned int *)(p), __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n((unsigned int *)(p), (v), __ATOMIC_RELEASE)
+#define STORE_REL_8(p, v) __atomic_store_n((unsigned char *)(p), (v), __ATOMIC_RELEASE)
+#endif
+
+static void open_sync()
+{
+#ifdef _WIN32
+    for (int i = 0; i < DBG_SYNC_COUNT; ++i)
+    {
+        if (hSync[i] == NULL)
+            hSync[i] = CreateEventA(NULL, FALSE, FALSE, sync_names[i]);
+    }
+#endif
+}
+
+static void close_sync()
+{
+#ifdef _WIN32
+    for (int i = 0; i < DBG_SYNC_COUNT; ++i)
+    {
+        if (hSync[i] != NULL)
+            CloseHandle(hSync[i]);
+        hSync[i] = NULL;
+    }
+#endif
+}
+
+static void sync_wait(void *addr, unsigned int val, int sync, int timeout_ms)
+{
+    if (LOAD_ACQ(addr) != val)
+        return;
+
+#ifdef _WIN32
+    WaitForSingleObject(hSync[sync], timeout_ms);
+#elif defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+#else
+    usleep(1000);
+#endif
+}
+
+static void sync_wake(void *addr, int sync)
+{
+#ifdef _WIN32
+    SetEvent(hSync[sync]);
+#elif defined(__linux__)
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
 dbg_request_t* create_shared_mem()
 {
     dbg_request_t* request = NULL;
 
 #ifdef _WIN32
-    hMapFile = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(dbg_request_t), SHARED_MEM_NAME);
+    hMapFile = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, DBG_SHARED_MEM_SIZE, SHARED_MEM_NAME);
 
     if (hMapFile == 0)
     {
         return NULL;
     }
 
-    request = (dbg_request_t*)MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(dbg_request_t));
+    int stale = (GetLastError() == ERROR_ALREADY_EXISTS);
+
+    request = (dbg_request_t*)MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, DBG_SHARED_MEM_SIZE);
 
     if (request == NULL)
     {
@@ -35,12 +124,19 @@ dbg_request_t* create_shared_mem()
         return NULL;
     }
 #else
-    request = shm_open(SHARED_MEM_NAME, O_CREAT | O_RDWR, 0777);
+    shm = shm_open(SHARED_MEM_NAME, O_CREAT | O_RDWR, 0777);
 
     if (shm == -1)
         return NULL;
 
-    request = mmap(NULL, sizeof(dbg_request_t), PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+    // truncating first drops stale contents without touching the pages
+    if (ftruncate(shm, 0) == -1 || ftruncate(shm, DBG_SHARED_MEM_SIZE) == -1) {
+        close(shm);
+        shm_unlink(SHARED_MEM_NAME);
+        return NULL;
+    }
+
+    request = mmap(NULL, DBG_SHARED_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
 
     if (request == MAP_FAILED) {
         close(shm);
@@ -49,7 +145,24 @@ dbg_request_t* create_shared_mem()
     }
 #endif
 
+    // pages are zero filled on demand, only the header is written here
     memset(request, 0, sizeof(dbg_request_t));
+#ifdef _WIN32
+    if (stale)
+        memset((unsigned char *)request + DBG_HEADER_SIZE, 0, DBG_COV_MAP_SIZE + DBG_COV_DIRTY_SIZE);
+#endif
+
+    request->map_size = DBG_SHARED_MEM_SIZE;
+    request->cov_map_offset = DBG_HEADER_SIZE;
+    request->cov_map_size = DBG_COV_MAP_SIZE;
+    request->cov_dirty_offset = request->cov_map_offset + DBG_COV_MAP_SIZE;
+    request->cov_queue_offset = request->cov_dirty_offset + DBG_COV_DIRTY_SIZE;
+    request->data_offset = request->cov_queue_offset + MAX_COV_QUEUE * 4;
+    request->data_size = DBG_DATA_SIZE;
+    request->caps = DBG_CAPS;
+    request->version = DBG_PROTOCOL_VERSION;
+
+    open_sync();
 
     return request;
 }
@@ -64,7 +177,7 @@ dbg_request_t *open_shared_mem()
     if (hMapFile == NULL)
         return NULL;
 
-    request = (dbg_request_t *)MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(dbg_request_t));
+    request = (dbg_request_t *)MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, DBG_SHARED_MEM_SIZE);
 
     if (request == NULL)
     {
@@ -78,7 +191,7 @@ dbg_request_t *open_shared_mem()
     if (shm == -1)
         return NULL;
 
-    request = mmap(NULL, sizeof(dbg_request_t), PROT_READ|PROT_WRITE, MAP_SHARED, shm, 0);
+    request = mmap(NULL, DBG_SHARED_MEM_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, shm, 0);
 
     if (request == MAP_FAILED) {
         close(shm);
@@ -87,12 +200,31 @@ dbg_request_t *open_shared_mem()
     }
 #endif
 
+    // refuse a core speaking another protocol (or one still starting up)
+    if (request->version != DBG_PROTOCOL_VERSION || request->map_size != DBG_SHARED_MEM_SIZE)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(request);
+        CloseHandle(hMapFile);
+        hMapFile = NULL;
+#else
+        munmap(request, DBG_SHARED_MEM_SIZE);
+        close(shm);
+#endif
+        return NULL;
+    }
+
+    open_sync();
+
     return request;
 }
 
 void close_shared_mem(dbg_request_t **request, int do_unmap)
 {
-    memset(*request, 0, sizeof(dbg_request_t));
+    // keep the layout fields, the other side may still be mapped
+    memset(&(*request)->req_type, 0, sizeof(dbg_request_t) - offsetof(dbg_request_t, req_type));
+
+    close_sync();
 
 #ifdef _WIN32
     if (do_unmap) {
@@ -102,54 +234,177 @@ void close_shared_mem(dbg_request_t **request, int do_unmap)
     hMapFile = NULL;
     *request = NULL;
 #else
-    munmap(*request, sizeof(dbg_request_t));
+    munmap(*request, DBG_SHARED_MEM_SIZE);
     close(shm);
     shm_unlink(SHARED_MEM_NAME);
 #endif
 }
 
-int recv_dbg_event_ida(dbg_request_t* request, int wait)
+int dbg_events_pending(dbg_request_t *request)
+{
+    return request && (LOAD_ACQ(&request->dbg_events.head) != request->dbg_events.tail);
+}
+
+int recv_dbg_event_ida(dbg_request_t* request, debugger_event_t *event, int wait)
+{
+    dbg_event_ring_t *ring;
+    unsigned int head;
+
+    if (!request)
+        return 0;
+
+    ring = &request->dbg_events;
+    head = LOAD_ACQ(&ring->head);
+
+    if (head == ring->tail)
+    {
+        if (!wait || request->dbg_active != 1)
+            return 0;
+
+        sync_wait(&ring->head, head, DBG_SYNC_EVT, 100);
+
+        head = LOAD_ACQ(&ring->head);
+        if (head == ring->tail)
+            return 0;
+    }
+
+    *event = ring->events[ring->tail & (MAX_DBG_EVENTS - 1)];
+    STORE_REL(&ring->tail, ring->tail + 1);
+
+    return 1;
+}
+
+void send_dbg_event(dbg_request_t *request, unsigned int pc, dbg_event_type_t type)
 {
-    while (request && (request->dbg_active == 1 || request->dbg_events_count > 0))
+    dbg_event_ring_t *ring = &request->dbg_events;
+    unsigned int head = ring->head;
+
+    if (head - LOAD_ACQ(&ring->tail) >= MAX_DBG_EVENTS)
     {
-        for (int i = 0; i < MAX_DBG_EVENTS; ++i)
-        {
-            if (request && request->dbg_events[i].type != DBG_EVT_NO_EVENT)
-            {
-                request->dbg_events_count -= 1;
-                return i;
-            }
-        }
-
-        if (!wait)
-            return -1;
-#ifdef _WIN32
-        Sleep(10);
-#else
-        usleep(10 * 1000);
-#endif
+        ring->lost += 1;
+        return;
     }
 
-    return -1;
+    ring->events[head & (MAX_DBG_EVENTS - 1)].pc = pc;
+    ring->events[head & (MAX_DBG_EVENTS - 1)].type = type;
+    STORE_REL(&ring->head, head + 1);
+
+    sync_wake(&ring->head, DBG_SYNC_EVT);
+}
+
+void mark_dbg_coverage(dbg_request_t *request, unsigned int address)
+{
+    dbg_coverage_t *cov = &request->coverage;
+    unsigned char *map = dbg_cov_map(request);
+    unsigned char bit = 1 << ((address >> 1) & 7);
+    unsigned int head;
+
+    if (address >= MAXROMSIZE || (map[address >> 4] & bit))
+        return;
+
+    map[address >> 4] |= bit;
+    STORE_REL_8(&dbg_cov_dirty(request)[address >> DBG_COV_PAGE_SHIFT], 1);
+    cov->executed += 1;
+
+    head = cov->head;
+    if (head - LOAD_ACQ(&cov->tail) >= MAX_COV_QUEUE)
+    {
+        STORE_REL(&cov->lost, cov->lost + 1);
+        return;
+    }
+
+    dbg_cov_queue(request)[head & (MAX_COV_QUEUE - 1)] = address;
+    STORE_REL(&cov->head, head + 1);
+}
+
+void clear_dbg_coverage(dbg_request_t *request)
+{
+    // queued addresses stay valid, they were executed before the clear
+    memset(dbg_cov_map(request), 0, DBG_COV_MAP_SIZE);
+    memset(dbg_cov_dirty(request), 0, DBG_COV_DIRTY_SIZE);
+    request->coverage.executed = 0;
+}
+
+int drain_dbg_coverage(dbg_request_t *request, unsigned int *addresses, int max_count)
+{
+    dbg_coverage_t *cov;
+    unsigned int tail, head;
+    int count = 0;
+
+    if (!request)
+        return 0;
+
+    cov = &request->coverage;
+    tail = cov->tail;
+    head = LOAD_ACQ(&cov->head);
+
+    while (tail != head && count < max_count)
+        addresses[count++] = dbg_cov_queue(request)[tail++ & (MAX_COV_QUEUE - 1)];
+
+    STORE_REL(&cov->tail, tail);
+
+    return count;
+}
+
+// Coverage file: "GXCV", format version, ROM bytes per bit, map size, map.
+int save_dbg_coverage(dbg_request_t *request, const char *path)
+{
+    unsigned int header[4];
+    FILE *f;
+    int ok;
+
+    if (!request)
+        return 0;
+
+    f = fopen(path, "wb");
+    if (!f)
+        return 0;
+
+    memcpy(&header[0], "GXCV", 4);
+    header[1] = 1;
+    header[2] = 2;
+    header[3] = request->cov_map_size;
+
+    ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+         fwrite(dbg_cov_map(request), request->cov_map_size, 1, f) == 1;
+
+    return (fclose(f) == 0) && ok;
 }
 
 void send_dbg_request(dbg_request_t *request, request_type_t type, int ignore_active)
 {
+    unsigned int cur;
+
     if (!request)
         return;
 
-    request->req_type = type;
+    STORE_REL(&request->req_type, type);
 
     if (ignore_active) {
         request->dbg_active = 1;
     }
 
-    while (request && request->dbg_active == 1 && request->req_type != REQ_NO_REQUEST)
+    sync_wake(&request->req_type, DBG_SYNC_REQ);
+
+    while (request && request->dbg_active == 1 && (cur = LOAD_ACQ(&request->req_type)) != REQ_NO_REQUEST)
     {
-#ifdef _WIN32
-        Sleep(10);
-#else
-        usleep(10 * 1000);
-#endif
+        sync_wait(&request->req_type, cur, DBG_SYNC_ACK, 100);
     }
 }
+
+int wait_dbg_request(dbg_request_t *request, int timeout_ms)
+{
+    if (!request)
+        return 0;
+
+    sync_wait(&request->req_type, REQ_NO_REQUEST, DBG_SYNC_REQ, timeout_ms);
+
+    return LOAD_ACQ(&request->req_type) != REQ_NO_REQUEST;
+}
+
+void ack_dbg_request(dbg_request_t *request)
+{
+    STORE_REL(&request->req_type, REQ_NO_REQUEST);
+
+    sync_wake(&request->req_type, DBG_SYNC_ACK);
+}
@@ -6,13 +6,26 @@ extern "C" {
 #endif
 
 #define SHARED_MEM_NAME "GX_PLUS_SHARED_MEM"
-#define MAX_BREAKPOINTS 1000
-#define MAX_DBG_EVENTS 20
+#define MAX_DBG_EVENTS 32 // power of two
 
 #ifndef MAXROMSIZE
 #define MAXROMSIZE ((unsigned int)0xA00000)
 #endif
 
+// Shared memory layout: dbg_request_t header, code coverage (1 bit per ROM
+// word, one dirty byte per coverage page, queue of newly executed words)
+// and a data window used by bulk requests (memory contents, breakpoint
+// list). Offsets and sizes are published in the header so that both sides
+// agree on them, the version is bumped on any layout change.
+#define DBG_PROTOCOL_VERSION 8
+#define DBG_HEADER_SIZE 0x1000
+#define DBG_COV_MAP_SIZE (MAXROMSIZE >> 4)
+#define DBG_COV_PAGE_SHIFT 12 // ROM bytes per dirty byte
+#define DBG_COV_DIRTY_SIZE (MAXROMSIZE >> DBG_COV_PAGE_SHIFT)
+#define MAX_COV_QUEUE 0x1000 // power of two
+#define DBG_DATA_SIZE 0x10000
+#define DBG_SHARED_MEM_SIZE (DBG_HEADER_SIZE + DBG_COV_MAP_SIZE + DBG_COV_DIRTY_SIZE + MAX_COV_QUEUE * 4 + DBG_DATA_SIZE)
+
 #pragma pack(push, 4)
     // copy from cpuhook.h:: hook_type_t
 typedef enum {
@@ -71,6 +84,14 @@ typedef enum {
     REQ_READ_Z80,
     REQ_WRITE_Z80,
 
+    // address is an offset into the VDP memory, CRAM uses the bus format
+    REQ_READ_VRAM,
+    REQ_WRITE_VRAM,
+    REQ_READ_CRAM,
+    REQ_WRITE_CRAM,
+    REQ_READ_VSRAM,
+    REQ_WRITE_VSRAM,
+
     REQ_ADD_BREAK,
     REQ_TOGGLE_BREAK,
     REQ_DEL_BREAK,
@@ -84,8 +105,35 @@ typedef enum {
 
     REQ_STEP_INTO,
     REQ_STEP_OVER,
+
+    // handled synchronously, no event is sent
+    REQ_STEP_BACK,
+    REQ_REVERSE_CONTINUE,
+
+    REQ_GET_HOOK_STATS,
+
+    REQ_CLEAR_COVERAGE,
+
+    REQ_TRACE_START, // path in the data window
+    REQ_TRACE_STOP,
+
+    REQ_REWIND, // rewind.frames back, handled synchronously
 } request_type_t;
 
+typedef enum {
+    DBG_CAP_EVENT_RING = (1 << 0),
+    DBG_CAP_HOOK_STATS = (1 << 1),
+    DBG_CAP_COVERAGE = (1 << 2),
+    DBG_CAP_DATA_WINDOW = (1 << 3),
+    DBG_CAP_VDP_MEMORY = (1 << 4),
+    DBG_CAP_REVERSE = (1 << 5),
+    DBG_CAP_TRACE = (1 << 6),
+    DBG_CAP_CONDITIONS = (1 << 7),
+    DBG_CAP_REWIND = (1 << 8),
+} dbg_caps_t;
+
+#define DBG_CAPS (DBG_CAP_EVENT_RING | DBG_CAP_HOOK_STATS | DBG_CAP_COVERAGE | DBG_CAP_DATA_WINDOW | DBG_CAP_VDP_MEMORY | DBG_CAP_REVERSE | DBG_CAP_TRACE | DBG_CAP_CONDITIONS | DBG_CAP_REWIND)
+
 typedef enum {
     REG_TYPE_M68K = (1 << 0),
     REG_TYPE_S80 = (1 << 1),
@@ -107,6 +155,14 @@ typedef struct {
     unsigned int pc;
 } debugger_event_t;
 
+// single producer (emulator) / single consumer (debugger) event ring
+typedef struct {
+    unsigned int head; // next slot written by the emulator
+    unsigned int tail; // next slot read by the debugger
+    unsigned int lost; // events dropped because the ring was full
+    debugger_event_t events[MAX_DBG_EVENTS];
+} dbg_event_ring_t;
+
 typedef struct {
     int index;
     unsigned int val;
@@ -227,12 +283,8 @@ typedef struct {
 } register_data_t;
 
 typedef struct {
-    int size;
+    int size; // at most data_size, contents in the data window
     unsigned int address;
-
-    unsigned char m68k_rom[MAXROMSIZE];
-    unsigned char m68k_ram[0x10000];
-    unsigned char z80_ram[0x2000];
 } memory_data_t;
 
 typedef struct {
@@ -240,37 +292,107 @@ typedef struct {
     unsigned int address;
     int width;
     int enabled;
+    unsigned int hit_count; // stop from this true hit on, 0 or 1 for every hit
+    unsigned int hits; // true hits so far (REQ_LIST_BREAKS)
+    int cond_set; // REQ_ADD_BREAK: replace condition and hit count, condition text in the data window
+    int cond_error; // offset + 1 of a syntax error in the condition, 0 when compiled
 } bpt_data_t;
 
 typedef struct {
-    int count;
-    bpt_data_t breaks[MAX_BREAKPOINTS];
+    int count; // bpt_data_t entries in the data window
 } bpt_list_t;
 
 typedef struct {
-    int to_apply;
-    int applied;
-} pc_map_t;
+    unsigned int mask; // subscribed hook_type_t classes
+    unsigned int fired, filtered; // last frame, 68K accesses are filtered only while a 68K class is subscribed
+} hook_stats_t;
+
+// Written by the emulator when a ROM word executes for the first time: its
+// bit is set in the map, its page is marked dirty and its address is pushed
+// to the queue. When the queue is full the address is only counted in lost,
+// the debugger then rescans the dirty pages.
+typedef struct {
+    unsigned int head, tail;
+    unsigned int lost;
+    unsigned int executed; // distinct words
+} dbg_coverage_t;
+
+typedef struct {
+    unsigned int position; // M68K instructions executed since debugging started
+    unsigned int oldest; // earliest position reachable backwards
+    unsigned int snapshots, keyframes;
+    unsigned int bytes; // memory held by the snapshot ring
+    unsigned int last_us; // duration of the last reverse request
+} history_stats_t;
+
+// M68K execution trace (see trace.h), updated by REQ_TRACE_START/STOP
+typedef struct {
+    int active;
+    unsigned int flags; // TRACE_REGS, TRACE_STORE
+    unsigned long long entries;
+    unsigned long long raw_bytes, packed_bytes;
+    unsigned int blocks, stored, frames;
+    unsigned int stall_us, compress_us, elapsed_us;
+    int error;
+} dbg_trace_t;
+
+// Rewind buffer (see rewind.h), sized by the core options. frames is set by
+// the debugger for REQ_REWIND and holds the frames actually rewound after it.
+typedef struct {
+    int frames;
+    unsigned int budget; // 0 when disabled
+    unsigned int available; // frames that can be rewound
+    unsigned int bytes;
+    unsigned int last_bytes, avg_bytes; // per captured frame
+    unsigned int capture_us, restore_us; // last capture, last rewind
+} dbg_rewind_t;
 
 typedef struct {
+    unsigned int version; // DBG_PROTOCOL_VERSION
+    unsigned int caps; // dbg_caps_t
+    unsigned int map_size;
+    unsigned int cov_map_offset, cov_map_size;
+    unsigned int cov_dirty_offset, cov_queue_offset;
+    unsigned int data_offset, data_size;
+
     request_type_t req_type;
     register_data_t regs_data;
     memory_data_t mem_data;
     bpt_data_t bpt_data;
-    unsigned int dbg_events_count;
-    debugger_event_t dbg_events[MAX_DBG_EVENTS];
-    pc_map_t pc_map[MAXROMSIZE >> 1];
+    dbg_event_ring_t dbg_events;
     bpt_list_t bpt_list;
+    hook_stats_t hook_stats;
+    dbg_coverage_t coverage;
+    history_stats_t history;
+    dbg_trace_t trace;
+    dbg_rewind_t rewind;
     int dbg_active, dbg_paused;
 } dbg_request_t;
 #pragma pack(pop)
 
+#define dbg_cov_map(request) ((unsigned char *)(request) + (request)->cov_map_offset)
+#define dbg_cov_dirty(request) ((unsigned char *)(request) + (request)->cov_dirty_offset)
+#define dbg_cov_queue(request) ((unsigned int *)((unsigned char *)(request) + (request)->cov_queue_offset))
+#define dbg_data(request) ((unsigned char *)(request) + (request)->data_offset)
+
 dbg_request_t* create_shared_mem();
 dbg_request_t *open_shared_mem();
 void close_shared_mem(dbg_request_t **request, int do_unmap);
-int recv_dbg_event_ida(dbg_request_t* request, int wait);
+
+// debugger side
+int recv_dbg_event_ida(dbg_request_t* request, debugger_event_t *event, int wait);
+int drain_dbg_coverage(dbg_request_t *request, unsigned int *addresses, int max_count);
+int save_dbg_coverage(dbg_request_t *request, const char *path);
+int dbg_events_pending(dbg_request_t *request);
 void send_dbg_request(dbg_request_t *request, request_type_t type, int ignore_active);
 
+// emulator side
+void send_dbg_event(dbg_request_t *request, unsigned int pc, dbg_event_type_t type);
+void mark_dbg_coverage(dbg_request_t *request, unsigned int address);
+void clear_dbg_coverage(dbg_request_t *request);
+int wait_dbg_request(dbg_request_t *request, int timeout_ms);
+void ack_dbg_request(dbg_request_t *request);
+
 #ifdef __cplusplus
 }
 #endif
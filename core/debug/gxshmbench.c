@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "debug_wrap.h"
+
+// Debugger channel round trip over the POSIX shared mapping: a forked
+// debugger process posts REQ_STEP_INTO and waits for the DBG_EVT_STEP
+// event, the parent plays the emulator side of retro_run() while paused.
+//   gxshmbench [-n steps]
+//
+// Prints the time taken by create_shared_mem() and open_shared_mem() with
+// the resident memory of each side right after it, then the round trip
+// distribution in microseconds.
+
+static double now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+// VmRSS and RssShmem in KB, 0 when /proc is not available
+static void print_attach(const char *name, double us)
+{
+    char line[256];
+    unsigned long rss = 0, shmem = 0;
+    FILE *f = fopen("/proc/self/status", "r");
+
+    while (f && fgets(line, sizeof(line), f)) {
+        sscanf(line, "VmRSS: %lu", &rss);
+        sscanf(line, "RssShmem: %lu", &shmem);
+    }
+    if (f)
+        fclose(f);
+
+    printf("%s: %.1f us, RSS %lu KB (shared mapping %lu KB)\n", name, us, rss, shmem);
+    fflush(stdout);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int run_debugger(int steps)
+{
+    double start = now_us();
+    dbg_request_t *request = open_shared_mem();
+    double *times;
+    int i;
+
+    if (!request) {
+        fprintf(stderr, "cannot open " SHARED_MEM_NAME "\n");
+        return 1;
+    }
+    print_attach("open_shared_mem", now_us() - start);
+
+    times = malloc(steps * sizeof(*times));
+    if (!times)
+        return 1;
+
+    for (i = 0; i < steps; ++i) {
+        debugger_event_t event;
+        double start = now_us();
+
+        send_dbg_request(request, REQ_STEP_INTO, 0);
+        while (!recv_dbg_event_ida(request, &event, 1))
+            ;
+
+        times[i] = now_us() - start;
+    }
+
+    // lets the emulator side leave its loop
+    request->dbg_active = 0;
+
+    qsort(times, steps, sizeof(*times), compare_double);
+    printf("%d steps, round trip us: min %.1f, median %.1f, p99 %.1f, max %.1f\n",
+        steps, times[0], times[steps / 2], times[steps * 99 / 100], times[steps - 1]);
+    fflush(stdout);
+
+    free(times);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    dbg_request_t *request;
+    int steps = 10000, status;
+    unsigned int pc = 0;
+    double start;
+    pid_t pid;
+
+    if (argc == 3 && !strcmp(argv[1], "-n"))
+        steps = atoi(argv[2]);
+    else if (argc != 1)
+        steps = 0;
+
+    if (steps <= 0) {
+        fprintf(stderr, "usage: gxshmbench [-n steps]\n");
+        return 1;
+    }
+
+    start = now_us();
+    request = create_shared_mem();
+    if (!request) {
+        fprintf(stderr, "cannot create " SHARED_MEM_NAME "\n");
+        return 1;
+    }
+    print_attach("create_shared_mem", now_us() - start);
+    request->dbg_active = 1;
+    request->dbg_paused = 1;
+
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    if (!pid)
+        _exit(run_debugger(steps));
+
+    while (request->dbg_active == 1) {
+        if (wait_dbg_request(request, 100)) {
+            send_dbg_event(request, pc += 2, DBG_EVT_STEP);
+            ack_dbg_request(request);
+        }
+    }
+
+    waitpid(pid, &status, 0);
+    close_shared_mem(&request, 1);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+// Dumps a M68K execution trace written by the debugger.
+//   gxtrace [-f frame] [-n count] [-s] file
+
+static const char *reg_names[17] = {
+    "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+    "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "sr",
+};
+
+static void print_summary(trace_reader_t *reader)
+{
+    unsigned long long entries = 0, raw = 0, packed = 0;
+    unsigned int frames = 0;
+    trace_block_t info;
+    int i;
+
+    for (i = 0; i < reader->blocks; ++i) {
+        if (!trace_block_info(reader, i, &info))
+            break;
+        entries += info.entries;
+        raw += info.raw_size;
+        packed += sizeof(info) + info.packed_size;
+    }
+
+    if (reader->blocks)
+        frames = reader->index[reader->blocks - 1].frame + 1;
+
+    printf("%d blocks, %u frames, %llu instructions%s\n", reader->blocks, frames, entries,
+        (reader->header.flags & TRACE_REGS) ? ", registers" : "");
+    if (entries)
+        printf("%.2f bytes per instruction encoded, %.3f compressed\n", (double)raw / entries, (double)packed / entries);
+}
+
+int main(int argc, char **argv)
+{
+    trace_reader_t reader;
+    trace_entry_t entry;
+    unsigned long long count = ~0ULL;
+    unsigned int start = 0, frame;
+    int summary = 0, i;
+    const char *path = NULL;
+
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-f") && i + 1 < argc)
+            start = (unsigned int)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            count = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-s"))
+            summary = 1;
+        else if (argv[i][0] != '-' && !path)
+            path = argv[i];
+        else
+            path = NULL, i = argc;
+    }
+
+    if (!path) {
+        fprintf(stderr, "usage: gxtrace [-f frame] [-n count] [-s] file\n");
+        return 1;
+    }
+
+    if (!trace_open(&reader, path)) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        return 1;
+    }
+
+    if (summary) {
+        print_summary(&reader);
+        trace_close(&reader);
+        return 0;
+    }
+
+    if (!trace_seek_frame(&reader, start)) {
+        fprintf(stderr, "%s: no instruction from frame %u\n", path, start);
+        trace_close(&reader);
+        return 1;
+    }
+
+    while (count-- && trace_next(&reader, &entry, &frame)) {
+        unsigned long long position = reader.info.first_entry + reader.info.entries - reader.left - 1;
+
+        printf("%6u %12llu %06X %04X %8u", frame, position, entry.pc, entry.ir, entry.cycles);
+        for (i = 0; i < 17; ++i) {
+            if (entry.changed & (1 << i))
+                printf(" %s=%0*X", reg_names[i], (i < 16) ? 8 : 4, entry.regs[i]);
+        }
+        printf("\n");
+    }
+
+    trace_close(&reader);
+    return 0;
+}
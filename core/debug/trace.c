@@ -0,0 +1,497 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared.h"
+#include "trace.h"
+#include "LzmaEnc.h"
+
+#ifdef HOOK_CPU
+
+// Block buffers cycle between the emulator (filling one), the compressor
+// queue and the free list. Blocks are numbered when queued and written in
+// that order whichever thread compressed them. LZMA (fast mode) does not
+// keep up with a busy 68K on its own, so once TRACE_BEHIND blocks are
+// waiting the compressors write them stored until they catch up. Only when
+// no buffer is free at all does the emulator wait; entries are never
+// dropped, the wait is reported in trace_stats.stall_us.
+#define TRACE_BUFFERS 16
+#define TRACE_BEHIND (TRACE_BUFFERS / 2)
+#define TRACE_THREADS 2
+#define TRACE_LZMA_LEVEL 0
+#define TRACE_PACKED_SIZE (TRACE_BLOCK_SIZE + TRACE_BLOCK_SIZE / 2 + 0x100)
+
+typedef struct {
+    unsigned char *data;
+    trace_block_t block;
+    unsigned int seq;
+} trace_buffer_t;
+
+int trace_m68k_active = 0;
+trace_stats_t trace_stats;
+
+// emulator side
+static trace_buffer_t *trace_cur;
+static unsigned char *trace_pos, *trace_limit;
+static unsigned int trace_prev_pc, trace_prev_cycles;
+static unsigned int trace_ir_cache[TRACE_IR_CACHE][2];
+static unsigned int trace_regs[17];
+static int trace_flags;
+static unsigned int trace_regs_full; // mask forced at block start
+static unsigned int trace_frame_number, trace_seq, trace_start_us;
+
+// shared with the compressor threads, under trace_lock
+static trace_buffer_t trace_pool[TRACE_BUFFERS];
+static trace_buffer_t *trace_free[TRACE_BUFFERS];
+static trace_buffer_t *trace_queue[TRACE_BUFFERS];
+static int trace_free_count, trace_queue_head, trace_queue_count;
+static unsigned int trace_write_seq;
+static int trace_quit;
+static FILE *trace_file;
+static unsigned long long trace_offset;
+static trace_index_t *trace_index;
+static int trace_index_count, trace_index_alloc;
+
+#ifdef _WIN32
+static CRITICAL_SECTION trace_lock;
+static CONDITION_VARIABLE trace_filled, trace_freed, trace_written;
+static HANDLE trace_threads[TRACE_THREADS];
+
+#define lock_trace() EnterCriticalSection(&trace_lock)
+#define unlock_trace() LeaveCriticalSection(&trace_lock)
+#define wait_trace(cond) SleepConditionVariableCS(&(cond), &trace_lock, INFINITE)
+#define signal_trace(cond) WakeConditionVariable(&(cond))
+#define broadcast_trace(cond) WakeAllConditionVariable(&(cond))
+#else
+static pthread_mutex_t trace_lock;
+static pthread_cond_t trace_filled, trace_freed, trace_written;
+static pthread_t trace_threads[TRACE_THREADS];
+
+#define lock_trace() pthread_mutex_lock(&trace_lock)
+#define unlock_trace() pthread_mutex_unlock(&trace_lock)
+#define wait_trace(cond) pthread_cond_wait(&(cond), &trace_lock)
+#define signal_trace(cond) pthread_cond_signal(&(cond))
+#define broadcast_trace(cond) pthread_cond_broadcast(&(cond))
+#endif
+
+static unsigned int trace_time_us()
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (unsigned int)(now.QuadPart * 1000000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned int)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+}
+
+static void *trace_alloc(void *p, size_t size) { return malloc(size); }
+static void trace_release(void *p, void *address) { free(address); }
+static ISzAlloc trace_lzma_alloc = { trace_alloc, trace_release };
+
+static void write_trace_block(trace_buffer_t *buf, const unsigned char *data)
+{
+    trace_index_t *index;
+
+    if (trace_stats.error)
+        return;
+
+    if (trace_index_count == trace_index_alloc) {
+        int alloc = trace_index_alloc ? trace_index_alloc * 2 : 1024;
+        trace_index_t *grown = (trace_index_t *)realloc(trace_index, alloc * sizeof(trace_index_t));
+        if (!grown) {
+            trace_stats.error = 1;
+            return;
+        }
+        trace_index = grown;
+        trace_index_alloc = alloc;
+    }
+
+    if (fwrite(&buf->block, 1, sizeof(trace_block_t), trace_file) != sizeof(trace_block_t) ||
+        fwrite(data, 1, buf->block.packed_size, trace_file) != buf->block.packed_size) {
+        trace_stats.error = 1;
+        return;
+    }
+
+    index = &trace_index[trace_index_count++];
+    index->frame = buf->block.frame;
+    index->flags = buf->block.flags;
+    index->first_entry = buf->block.first_entry;
+    index->offset = trace_offset;
+    trace_offset += sizeof(trace_block_t) + buf->block.packed_size;
+
+    trace_stats.blocks++;
+    if (buf->block.flags & TRACE_BLOCK_STORED)
+        trace_stats.stored++;
+    trace_stats.raw_bytes += buf->block.raw_size;
+    trace_stats.packed_bytes += sizeof(trace_block_t) + buf->block.packed_size;
+}
+
+static void compress_trace_blocks()
+{
+    unsigned char *packed = (unsigned char *)malloc(TRACE_PACKED_SIZE);
+
+    lock_trace();
+
+    for (;;) {
+        trace_buffer_t *buf;
+        const unsigned char *data;
+        unsigned int start;
+        int behind;
+
+        while (!trace_queue_count && !trace_quit)
+            wait_trace(trace_filled);
+        if (!trace_queue_count)
+            break;
+
+        behind = (trace_queue_count >= TRACE_BEHIND);
+        buf = trace_queue[trace_queue_head];
+        trace_queue_head = (trace_queue_head + 1) % TRACE_BUFFERS;
+        trace_queue_count--;
+        unlock_trace();
+
+        start = trace_time_us();
+        data = buf->data;
+        buf->block.packed_size = buf->block.raw_size;
+        buf->block.flags |= TRACE_BLOCK_STORED;
+
+        if (packed && !behind && !(trace_flags & TRACE_STORE)) {
+            CLzmaEncProps props;
+            SizeT packed_size = TRACE_PACKED_SIZE, props_size = 5;
+
+            LzmaEncProps_Init(&props);
+            props.level = TRACE_LZMA_LEVEL;
+            props.dictSize = TRACE_BLOCK_SIZE;
+            props.reduceSize = buf->block.raw_size;
+            props.numThreads = 1;
+
+            if (LzmaEncode(packed, &packed_size, buf->data, buf->block.raw_size, &props,
+                    buf->block.props, &props_size, 0, NULL, &trace_lzma_alloc, &trace_lzma_alloc) == SZ_OK &&
+                packed_size < buf->block.raw_size) {
+                data = packed;
+                buf->block.packed_size = (unsigned int)packed_size;
+                buf->block.flags &= ~TRACE_BLOCK_STORED;
+            }
+        }
+
+        lock_trace();
+        trace_stats.compress_us += trace_time_us() - start;
+
+        while (buf->seq != trace_write_seq)
+            wait_trace(trace_written);
+
+        write_trace_block(buf, data);
+
+        trace_write_seq++;
+        broadcast_trace(trace_written);
+
+        trace_free[trace_free_count++] = buf;
+        signal_trace(trace_freed);
+    }
+
+    unlock_trace();
+    free(packed);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI trace_thread(LPVOID param)
+{
+    compress_trace_blocks();
+    return 0;
+}
+#else
+static void *trace_thread(void *param)
+{
+    compress_trace_blocks();
+    return NULL;
+}
+#endif
+
+// lock held
+static void submit_trace_block()
+{
+    trace_cur->block.raw_size = (unsigned int)(trace_pos - trace_cur->data);
+    trace_stats.entries += trace_cur->block.entries;
+
+    trace_queue[(trace_queue_head + trace_queue_count) % TRACE_BUFFERS] = trace_cur;
+    trace_queue_count++;
+    signal_trace(trace_filled);
+
+    trace_cur = NULL;
+    trace_pos = trace_limit = NULL;
+}
+
+static unsigned char *next_trace_block()
+{
+    int cont = (trace_cur != NULL);
+    trace_buffer_t *buf;
+
+    lock_trace();
+
+    if (trace_cur)
+        submit_trace_block();
+
+    if (!trace_free_count) {
+        unsigned int start = trace_time_us();
+        while (!trace_free_count)
+            wait_trace(trace_freed);
+        trace_stats.stall_us += trace_time_us() - start;
+    }
+
+    buf = trace_free[--trace_free_count];
+    unlock_trace();
+
+    memset(&buf->block, 0, sizeof(trace_block_t));
+    buf->block.magic = TRACE_BLOCK_MAGIC;
+    buf->block.frame = trace_frame_number;
+    buf->block.first_entry = trace_stats.entries;
+    buf->block.flags = cont ? TRACE_BLOCK_CONT : 0;
+    buf->seq = trace_seq++;
+
+    // blocks decode on their own
+    trace_prev_pc = trace_prev_cycles = 0;
+    memset(trace_ir_cache, 0xFF, sizeof(trace_ir_cache));
+    trace_regs_full = 0x1FFFF;
+
+    trace_cur = buf;
+    trace_pos = buf->data;
+    trace_limit = buf->data + TRACE_BLOCK_SIZE - TRACE_MAX_ENTRY;
+    return trace_pos;
+}
+
+static unsigned char *put_varint(unsigned char *p, unsigned int value)
+{
+    while (value >= 0x80) {
+        *p++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    return p;
+}
+
+#define ZIGZAG(v) (((v) << 1) ^ (unsigned int)((int)(v) >> 31))
+
+static unsigned char *put_regs(unsigned char *p)
+{
+    unsigned int sr = m68k_get_reg(M68K_REG_SR);
+    unsigned int mask = trace_regs_full | ((sr != trace_regs[16]) << 16);
+    unsigned int changed;
+    int i;
+
+    for (i = 0; i < 16; ++i)
+        mask |= (m68k.dar[i] != trace_regs[i]) << i;
+    trace_regs_full = 0;
+
+    p = put_varint(p, mask);
+    for (i = 0, changed = mask & 0xFFFF; changed; ++i, changed >>= 1) {
+        if (changed & 1) {
+            unsigned int value = trace_regs[i] = m68k.dar[i];
+            p[0] = (unsigned char)value;
+            p[1] = (unsigned char)(value >> 8);
+            p[2] = (unsigned char)(value >> 16);
+            p[3] = (unsigned char)(value >> 24);
+            p += 4;
+        }
+    }
+    if (mask & (1 << 16)) {
+        trace_regs[16] = sr;
+        p[0] = (unsigned char)sr;
+        p[1] = (unsigned char)(sr >> 8);
+        p += 2;
+    }
+
+    return p;
+}
+
+void trace_m68k(unsigned int pc, unsigned int ir, unsigned int cycles)
+{
+    unsigned char *p = trace_pos;
+    unsigned int delta, ticks, tag = 0;
+    unsigned int *cached;
+
+    if (p >= trace_limit)
+        p = next_trace_block();
+
+    delta = pc - trace_prev_pc;
+    ticks = cycles - trace_prev_cycles;
+    cached = trace_ir_cache[(pc >> 1) & (TRACE_IR_CACHE - 1)];
+
+    if (!(delta & 1) && delta - 2 < 12)
+        tag = delta >> 1;
+    if (ticks - 7 < 15 * 7 && !(ticks % 7))
+        tag |= (ticks / 7) << 4;
+    if (cached[0] != pc || cached[1] != ir) {
+        cached[0] = pc;
+        cached[1] = ir;
+        tag |= 8;
+    }
+
+    *p++ = (unsigned char)tag;
+    if (!(tag & 7))
+        p = put_varint(p, ZIGZAG(delta));
+    if (tag & 8) {
+        *p++ = (unsigned char)ir;
+        *p++ = (unsigned char)(ir >> 8);
+    }
+    if (!(tag >> 4))
+        p = put_varint(p, ZIGZAG(ticks));
+    if (trace_flags & TRACE_REGS)
+        p = put_regs(p);
+
+    trace_prev_pc = pc;
+    trace_prev_cycles = cycles;
+    trace_cur->block.entries++;
+    trace_pos = p;
+}
+
+void trace_frame(void)
+{
+    if (!trace_m68k_active)
+        return;
+
+    if (trace_cur) {
+        lock_trace();
+        submit_trace_block();
+        unlock_trace();
+    }
+
+    trace_frame_number++;
+    trace_stats.frames = trace_frame_number;
+    trace_stats.elapsed_us = trace_time_us() - trace_start_us;
+
+    if (trace_stats.error)
+        trace_stop();
+}
+
+static void free_trace_buffers()
+{
+    int i;
+
+    for (i = 0; i < TRACE_BUFFERS; ++i) {
+        free(trace_pool[i].data);
+        trace_pool[i].data = NULL;
+    }
+
+    free(trace_index);
+    trace_index = NULL;
+    trace_index_count = trace_index_alloc = 0;
+}
+
+int trace_start(const char *path, int flags)
+{
+    trace_header_t header;
+    int i;
+
+    trace_stop();
+
+    memset(&trace_stats, 0, sizeof(trace_stats));
+    for (i = 0; i < TRACE_BUFFERS; ++i) {
+        trace_pool[i].data = (unsigned char *)malloc(TRACE_BLOCK_SIZE);
+        if (!trace_pool[i].data) {
+            free_trace_buffers();
+            return 0;
+        }
+        trace_free[i] = &trace_pool[i];
+    }
+
+    trace_file = fopen(path, "wb");
+    if (!trace_file) {
+        free_trace_buffers();
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.flags = flags;
+    header.block_size = TRACE_BLOCK_SIZE;
+    fwrite(&header, 1, sizeof(header), trace_file);
+    trace_offset = sizeof(header);
+
+    trace_flags = flags;
+    trace_cur = NULL;
+    trace_pos = trace_limit = NULL;
+    trace_frame_number = trace_seq = trace_write_seq = 0;
+    trace_free_count = TRACE_BUFFERS;
+    trace_queue_head = trace_queue_count = 0;
+    trace_quit = 0;
+    trace_start_us = trace_time_us();
+
+#ifdef _WIN32
+    InitializeCriticalSection(&trace_lock);
+    InitializeConditionVariable(&trace_filled);
+    InitializeConditionVariable(&trace_freed);
+    InitializeConditionVariable(&trace_written);
+    for (i = 0; i < TRACE_THREADS; ++i)
+        trace_threads[i] = CreateThread(NULL, 0, trace_thread, NULL, 0, NULL);
+#else
+    pthread_mutex_init(&trace_lock, NULL);
+    pthread_cond_init(&trace_filled, NULL);
+    pthread_cond_init(&trace_freed, NULL);
+    pthread_cond_init(&trace_written, NULL);
+    for (i = 0; i < TRACE_THREADS; ++i)
+        pthread_create(&trace_threads[i], NULL, trace_thread, NULL);
+#endif
+
+    trace_m68k_active = 1;
+    return 1;
+}
+
+void trace_stop(void)
+{
+    trace_trailer_t trailer;
+    int i;
+
+    if (!trace_m68k_active)
+        return;
+
+    trace_m68k_active = 0;
+
+    lock_trace();
+    if (trace_cur)
+        submit_trace_block();
+    trace_quit = 1;
+    broadcast_trace(trace_filled);
+    unlock_trace();
+
+#ifdef _WIN32
+    WaitForMultipleObjects(TRACE_THREADS, trace_threads, TRUE, INFINITE);
+    for (i = 0; i < TRACE_THREADS; ++i)
+        CloseHandle(trace_threads[i]);
+    DeleteCriticalSection(&trace_lock);
+#else
+    for (i = 0; i < TRACE_THREADS; ++i)
+        pthread_join(trace_threads[i], NULL);
+    pthread_mutex_destroy(&trace_lock);
+    pthread_cond_destroy(&trace_filled);
+    pthread_cond_destroy(&trace_freed);
+    pthread_cond_destroy(&trace_written);
+#endif
+
+    // without the index (crash, write error) readers scan the block headers
+    if (!trace_stats.error) {
+        trailer.index_offset = trace_offset;
+        trailer.count = trace_index_count;
+        trailer.magic = TRACE_INDEX_MAGIC;
+        if (fwrite(trace_index, 1, trace_index_count * sizeof(trace_index_t), trace_file) != trace_index_count * sizeof(trace_index_t) ||
+            fwrite(&trailer, 1, sizeof(trailer), trace_file) != sizeof(trailer))
+            trace_stats.error = 1;
+    }
+
+    fclose(trace_file);
+    trace_file = NULL;
+    free_trace_buffers();
+
+    trace_stats.elapsed_us = trace_time_us() - trace_start_us;
+}
+
+#endif /* HOOK_CPU */
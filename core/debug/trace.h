@@ -0,0 +1,131 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+// M68K execution trace. Every instruction executed by the hooked 68K
+// instance is appended to a block buffer as a tag byte followed by the
+// fields that cannot be predicted:
+//   tag bits 0-2: PC delta / 2 (1..6), 0 = zigzag varint delta follows
+//   tag bit 3:    IR follows (16-bit), otherwise the IR last seen at this PC
+//   tag bits 4-7: cycle delta / 7 (1..15), 0 = zigzag varint delta follows
+// With TRACE_REGS a varint mask of the registers changed since the previous
+// entry follows (bits 0-15 D0-D7/A0-A7, bit 16 SR), then their values.
+// Registers are sampled before the instruction executes.
+//
+// A block holds the entries of a single frame and is encoded from a reset
+// state, so that any block can be decoded on its own. Full blocks are
+// compressed (LZMA) by background threads and written in order; an index of
+// the blocks is appended when the trace is stopped.
+
+#define TRACE_MAGIC "GXTRACE1"
+#define TRACE_VERSION 1
+#define TRACE_BLOCK_MAGIC 0x42545847 // "GXTB"
+#define TRACE_INDEX_MAGIC 0x49545847 // "GXTI"
+
+#define TRACE_BLOCK_SIZE (1 << 20)
+#define TRACE_MAX_ENTRY 96 // tag, varints, IR, register mask and values
+#define TRACE_IR_CACHE 4096 // power of two
+
+enum {
+    TRACE_REGS = (1 << 0), // record register deltas
+    TRACE_STORE = (1 << 1), // write blocks uncompressed
+};
+
+enum {
+    TRACE_BLOCK_CONT = (1 << 0), // continues the frame of the previous block
+    TRACE_BLOCK_STORED = (1 << 1), // not compressed
+};
+
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    unsigned int flags;
+    unsigned int block_size;
+    unsigned int reserved;
+} trace_header_t;
+
+typedef struct {
+    unsigned int magic;
+    unsigned int frame; // frames counted from the start of the trace
+    unsigned long long first_entry;
+    unsigned int entries;
+    unsigned int raw_size, packed_size;
+    unsigned int flags;
+    unsigned char props[8]; // LZMA properties (5 bytes)
+} trace_block_t;
+
+typedef struct {
+    unsigned int frame;
+    unsigned int flags;
+    unsigned long long first_entry;
+    unsigned long long offset;
+} trace_index_t;
+
+typedef struct {
+    unsigned long long index_offset;
+    unsigned int count;
+    unsigned int magic;
+} trace_trailer_t;
+
+typedef struct {
+    unsigned int pc;
+    unsigned int ir;
+    unsigned int cycles; // m68k.cycles when the instruction started
+    unsigned int changed; // registers updated by this entry
+    unsigned int regs[17]; // D0-D7, A0-A7, SR (TRACE_REGS)
+} trace_entry_t;
+
+// recorder (HOOK_CPU builds)
+
+typedef struct {
+    unsigned long long entries;
+    unsigned long long raw_bytes, packed_bytes;
+    unsigned int blocks, frames;
+    unsigned int stored; // blocks written uncompressed
+    unsigned int stall_us; // emulator waiting for a free buffer
+    unsigned int compress_us; // spent by the compressor threads
+    unsigned int elapsed_us;
+    int error; // write failed, the trace was stopped
+} trace_stats_t;
+
+extern int trace_m68k_active;
+extern trace_stats_t trace_stats;
+
+int trace_start(const char *path, int flags);
+void trace_stop(void);
+void trace_frame(void);
+void trace_m68k(unsigned int pc, unsigned int ir, unsigned int cycles);
+
+// reader
+
+typedef struct {
+    FILE *file;
+    trace_header_t header;
+    trace_index_t *index;
+    int blocks;
+
+    int block; // current block, -1 before the first one
+    trace_block_t info;
+    unsigned char *raw, *packed;
+    unsigned int raw_alloc, packed_alloc;
+    unsigned int pos, left;
+    trace_entry_t last; // decoder state
+    unsigned int ir_cache[TRACE_IR_CACHE][2];
+} trace_reader_t;
+
+int trace_open(trace_reader_t *reader, const char *path);
+void trace_close(trace_reader_t *reader);
+int trace_block_info(trace_reader_t *reader, int block, trace_block_t *info);
+int trace_seek_frame(trace_reader_t *reader, unsigned int frame);
+int trace_next(trace_reader_t *reader, trace_entry_t *entry, unsigned int *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
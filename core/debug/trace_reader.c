@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "LzmaDec.h"
+
+// Reader side of the trace format (see trace.h). Does not depend on the
+// emulator core so that tools can link it alone with LzmaDec.c.
+
+#ifdef _WIN32
+#define trace_fseek _fseeki64
+#define trace_ftell _ftelli64
+#else
+#define trace_fseek fseeko
+#define trace_ftell ftello
+#endif
+
+static void *trace_alloc(void *p, size_t size) { return malloc(size); }
+static void trace_release(void *p, void *address) { free(address); }
+static ISzAlloc trace_lzma_alloc = { trace_alloc, trace_release };
+
+static int grow_buffer(unsigned char **buffer, unsigned int *alloc, unsigned int size)
+{
+    unsigned char *grown;
+
+    if (size <= *alloc)
+        return 1;
+
+    grown = (unsigned char *)realloc(*buffer, size);
+    if (!grown)
+        return 0;
+
+    *buffer = grown;
+    *alloc = size;
+    return 1;
+}
+
+static int add_index(trace_reader_t *reader, const trace_block_t *block, unsigned long long offset, int *alloc)
+{
+    trace_index_t *index;
+
+    if (reader->blocks == *alloc) {
+        int size = *alloc ? *alloc * 2 : 1024;
+        trace_index_t *grown = (trace_index_t *)realloc(reader->index, size * sizeof(trace_index_t));
+        if (!grown)
+            return 0;
+        reader->index = grown;
+        *alloc = size;
+    }
+
+    index = &reader->index[reader->blocks++];
+    index->frame = block->frame;
+    index->flags = block->flags;
+    index->first_entry = block->first_entry;
+    index->offset = offset;
+    return 1;
+}
+
+static int read_index(trace_reader_t *reader)
+{
+    trace_trailer_t trailer;
+    long long end;
+
+    if (trace_fseek(reader->file, 0, SEEK_END) || (end = trace_ftell(reader->file)) < (long long)sizeof(trailer))
+        return 0;
+    if (trace_fseek(reader->file, end - sizeof(trailer), SEEK_SET) || fread(&trailer, sizeof(trailer), 1, reader->file) != 1)
+        return 0;
+    if (trailer.magic != TRACE_INDEX_MAGIC ||
+        trailer.index_offset + (unsigned long long)trailer.count * sizeof(trace_index_t) + sizeof(trailer) != (unsigned long long)end)
+        return 0;
+
+    reader->index = (trace_index_t *)malloc((trailer.count ? trailer.count : 1) * sizeof(trace_index_t));
+    if (!reader->index)
+        return 0;
+
+    if (trace_fseek(reader->file, trailer.index_offset, SEEK_SET) ||
+        fread(reader->index, sizeof(trace_index_t), trailer.count, reader->file) != trailer.count) {
+        free(reader->index);
+        reader->index = NULL;
+        return 0;
+    }
+
+    reader->blocks = trailer.count;
+    return 1;
+}
+
+// trace not stopped properly: walk the block headers
+static int scan_blocks(trace_reader_t *reader)
+{
+    unsigned long long offset = sizeof(trace_header_t);
+    trace_block_t block;
+    int alloc = 0;
+
+    reader->blocks = 0;
+
+    while (!trace_fseek(reader->file, offset, SEEK_SET) && fread(&block, sizeof(block), 1, reader->file) == 1) {
+        if (block.magic != TRACE_BLOCK_MAGIC)
+            break;
+        if (!add_index(reader, &block, offset, &alloc))
+            return 0;
+        offset += sizeof(block) + block.packed_size;
+    }
+
+    // the last block may have been cut short
+    if (reader->blocks) {
+        long long end;
+        trace_fseek(reader->file, 0, SEEK_END);
+        end = trace_ftell(reader->file);
+        if ((long long)offset > end)
+            reader->blocks--;
+    }
+
+    return 1;
+}
+
+int trace_open(trace_reader_t *reader, const char *path)
+{
+    memset(reader, 0, sizeof(trace_reader_t));
+    reader->block = -1;
+
+    reader->file = fopen(path, "rb");
+    if (!reader->file)
+        return 0;
+
+    if (fread(&reader->header, sizeof(trace_header_t), 1, reader->file) != 1 ||
+        memcmp(reader->header.magic, TRACE_MAGIC, sizeof(reader->header.magic)) ||
+        reader->header.version != TRACE_VERSION ||
+        (!read_index(reader) && !scan_blocks(reader))) {
+        trace_close(reader);
+        return 0;
+    }
+
+    return 1;
+}
+
+void trace_close(trace_reader_t *reader)
+{
+    if (reader->file)
+        fclose(reader->file);
+    free(reader->index);
+    free(reader->raw);
+    free(reader->packed);
+    memset(reader, 0, sizeof(trace_reader_t));
+    reader->block = -1;
+}
+
+static int load_block(trace_reader_t *reader, int block)
+{
+    trace_block_t *info = &reader->info;
+
+    reader->block = block;
+    reader->pos = reader->left = 0;
+
+    if (trace_fseek(reader->file, reader->index[block].offset, SEEK_SET) ||
+        fread(info, sizeof(trace_block_t), 1, reader->file) != 1 ||
+        info->magic != TRACE_BLOCK_MAGIC ||
+        !grow_buffer(&reader->raw, &reader->raw_alloc, info->raw_size) ||
+        !grow_buffer(&reader->packed, &reader->packed_alloc, info->packed_size) ||
+        fread(reader->packed, 1, info->packed_size, reader->file) != info->packed_size)
+        return 0;
+
+    if (info->flags & TRACE_BLOCK_STORED) {
+        if (info->packed_size != info->raw_size)
+            return 0;
+        memcpy(reader->raw, reader->packed, info->raw_size);
+    } else {
+        SizeT raw_size = info->raw_size, packed_size = info->packed_size;
+        ELzmaStatus status;
+
+        if (LzmaDecode(reader->raw, &raw_size, reader->packed, &packed_size, info->props, LZMA_PROPS_SIZE,
+                LZMA_FINISH_END, &status, &trace_lzma_alloc) != SZ_OK || raw_size != info->raw_size)
+            return 0;
+    }
+
+    memset(&reader->last, 0, sizeof(trace_entry_t));
+    memset(reader->ir_cache, 0xFF, sizeof(reader->ir_cache));
+    reader->left = info->entries;
+    return 1;
+}
+
+int trace_block_info(trace_reader_t *reader, int block, trace_block_t *info)
+{
+    return block >= 0 && block < reader->blocks &&
+        !trace_fseek(reader->file, reader->index[block].offset, SEEK_SET) &&
+        fread(info, sizeof(trace_block_t), 1, reader->file) == 1 &&
+        info->magic == TRACE_BLOCK_MAGIC;
+}
+
+// first block holding entries of frame or of a later one
+int trace_seek_frame(trace_reader_t *reader, unsigned int frame)
+{
+    int low = 0, high = reader->blocks;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (reader->index[mid].frame < frame)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low >= reader->blocks)
+        return 0;
+
+    return load_block(reader, low);
+}
+
+static unsigned int get_byte(trace_reader_t *reader)
+{
+    // reading past the end is detected once the entry is decoded
+    unsigned int pos = reader->pos++;
+    return (pos < reader->info.raw_size) ? reader->raw[pos] : 0;
+}
+
+static unsigned int get_varint(trace_reader_t *reader)
+{
+    unsigned int value = 0, shift = 0, byte;
+
+    do {
+        byte = get_byte(reader);
+        value |= (byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && shift < 35);
+
+    return value;
+}
+
+static unsigned int get_signed(trace_reader_t *reader)
+{
+    unsigned int value = get_varint(reader);
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+int trace_next(trace_reader_t *reader, trace_entry_t *entry, unsigned int *frame)
+{
+    trace_entry_t *last = &reader->last;
+    unsigned int tag, *cached;
+    int i;
+
+    while (!reader->left) {
+        if (reader->block + 1 >= reader->blocks || !load_block(reader, reader->block + 1))
+            return 0;
+    }
+
+    tag = get_byte(reader);
+
+    last->pc += (tag & 7) ? (tag & 7) << 1 : get_signed(reader);
+
+    cached = reader->ir_cache[(last->pc >> 1) & (TRACE_IR_CACHE - 1)];
+    if (tag & 8) {
+        last->ir = get_byte(reader);
+        last->ir |= get_byte(reader) << 8;
+        cached[0] = last->pc;
+        cached[1] = last->ir;
+    } else {
+        last->ir = cached[1];
+    }
+
+    last->cycles += (tag >> 4) ? (tag >> 4) * 7 : get_signed(reader);
+
+    last->changed = 0;
+    if (reader->header.flags & TRACE_REGS) {
+        last->changed = get_varint(reader);
+        for (i = 0; i < 17; ++i) {
+            if (!(last->changed & (1 << i)))
+                continue;
+            last->regs[i] = get_byte(reader);
+            last->regs[i] |= get_byte(reader) << 8;
+            if (i < 16) {
+                last->regs[i] |= get_byte(reader) << 16;
+                last->regs[i] |= get_byte(reader) << 24;
+            }
+        }
+    }
+
+    // corrupted block: skip to the next one
+    if (reader->pos > reader->info.raw_size) {
+        reader->left = 0;
+        return trace_next(reader, entry, frame);
+    }
+
+    reader->left--;
+    *entry = *last;
+    if (frame)
+        *frame = reader->info.frame;
+    return 1;
+}
@@ -42,18 +42,18 @@
 #include "shared.h"
 
 #ifdef USE_DYNAMIC_ALLOC
-external_t *ext;
+MACHINE_LOCAL external_t *ext;
 #else                     /* External Hardware (Cartridge, CD unit, ...) */
-external_t ext;
+MACHINE_LOCAL external_t ext;
 #endif
-uint8 boot_rom[0x800];    /* Genesis BOOT ROM   */
-uint8 work_ram[0x10000];  /* 68K RAM  */
-uint8 zram[0x2000];       /* Z80 RAM  */
-uint32 zbank;             /* Z80 bank window address */
-uint8 zstate;             /* Z80 bus state (d0 = BUSACK, d1 = /RESET) */
-uint8 pico_current;       /* PICO current page */
+MACHINE_LOCAL uint8 boot_rom[0x800];    /* Genesis BOOT ROM   */
+MACHINE_LOCAL uint8 work_ram[0x10000];  /* 68K RAM  */
+MACHINE_LOCAL uint8 zram[0x2000];       /* Z80 RAM  */
+MACHINE_LOCAL uint32 zbank;             /* Z80 bank window address */
+MACHINE_LOCAL uint8 zstate;             /* Z80 bus state (d0 = BUSACK, d1 = /RESET) */
+MACHINE_LOCAL uint8 pico_current;       /* PICO current page */
 
-static uint8 tmss[4];     /* TMSS security register */
+static MACHINE_LOCAL uint8 tmss[4];     /* TMSS security register */
 
 /*--------------------------------------------------------------------------*/
 /* Init, reset, shutdown functions                                          */
@@ -73,6 +73,17 @@ void gen_init(void)
     m68k_init();
     m68k.aerr_enabled = config.addr_error; 
 
+    /* code executed from cartridge ROM (resp. CD BOOT ROM) can be cached */
+    /* cart.rom is shared with CD hardware RAM, SRAM and cheat/SVP RAM above the loaded ROM */
+    if (system_hw == SYSTEM_MCD)
+    {
+      m68k_block_rom(scd.bootrom, sizeof(scd.bootrom));
+    }
+    else
+    {
+      m68k_block_rom(cart.rom, cart.romsize);
+    }
+
     /* initialize main 68k memory map */
 
     /* $800000-$DFFFFF : illegal access by default */
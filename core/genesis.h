@@ -59,16 +59,16 @@ typedef union
 
 /* Global variables */
 #ifdef USE_DYNAMIC_ALLOC
-extern external_t *ext;
+extern MACHINE_LOCAL external_t *ext;
 #else
-extern external_t ext;
+extern MACHINE_LOCAL external_t ext;
 #endif
-extern uint8 boot_rom[0x800];
-extern uint8 work_ram[0x10000];
-extern uint8 zram[0x2000];
-extern uint32 zbank;
-extern uint8 zstate;
-extern uint8 pico_current;
+extern MACHINE_LOCAL uint8 boot_rom[0x800];
+extern MACHINE_LOCAL uint8 work_ram[0x10000];
+extern MACHINE_LOCAL uint8 zram[0x2000];
+extern MACHINE_LOCAL uint32 zbank;
+extern MACHINE_LOCAL uint8 zstate;
+extern MACHINE_LOCAL uint8 pico_current;
 
 /* Function prototypes */
 extern void gen_init(void);
@@ -38,7 +38,7 @@
 
 #include "shared.h"
 
-static struct
+static MACHINE_LOCAL struct
 {
   uint8 State;
   uint8 Counter;
@@ -151,8 +151,8 @@ typedef struct
 } t_input;
 
 /* Global variables */
-extern t_input input;
-extern int old_system[2];
+extern MACHINE_LOCAL t_input input;
+extern MACHINE_LOCAL int old_system[2];
 
 /* Function prototypes */
 extern void input_init(void);
@@ -55,8 +55,8 @@ extern "C" {
 #define REGION_EUROPE     0xC0
 
 /* Global variables */
-extern uint8 io_reg[0x10];
-extern uint8 region_code;
+extern MACHINE_LOCAL uint8 io_reg[0x10];
+extern MACHINE_LOCAL uint8 region_code;
 
 /* Function prototypes */
 extern void io_init(void);
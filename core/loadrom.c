@@ -89,10 +89,10 @@ typedef struct
 } PERIPHERALINFO;
 
 
-ROMINFO rominfo;
-uint8 romtype;
+MACHINE_LOCAL ROMINFO rominfo;
+MACHINE_LOCAL uint8 romtype;
 
-static uint8 rom_region;
+static MACHINE_LOCAL uint8 rom_region;
 
 /***************************************************************************
  * Genesis ROM Manufacturers
@@ -66,8 +66,8 @@ typedef struct
 
 
 /* Global variables */
-extern ROMINFO rominfo;
-extern uint8 romtype;
+extern MACHINE_LOCAL ROMINFO rominfo;
+extern MACHINE_LOCAL uint8 romtype;
 
 /* Function prototypes */
 extern int load_bios(int system);
@@ -46,6 +46,7 @@ extern "C" {
 /* ======================================================================== */
 
 #include <setjmp.h>
+#include "types.h"
 #include "macros.h"
 #ifdef HOOK_CPU
 #include "cpuhook.h"
@@ -290,8 +291,8 @@ typedef struct
 } m68ki_cpu_core;
 
 /* CPU cores */
-extern m68ki_cpu_core m68k;
-extern m68ki_cpu_core s68k;
+extern MACHINE_LOCAL m68ki_cpu_core m68k;
+extern MACHINE_LOCAL m68ki_cpu_core s68k;
 
 
 /* ======================================================================== */
@@ -389,6 +390,13 @@ extern void m68k_clear_halt(void);
 extern void s68k_pulse_halt(void);
 extern void s68k_clear_halt(void);
 
+/* Set the read-only memory the MAIN-CPU block cache may hold code from.
+ * The cache must be flushed whenever this memory is modified (cheats,
+ * debugger, ROM write enable). Bank switching does not need a flush.
+ */
+extern void m68k_block_rom(const unsigned char *base, unsigned int size);
+extern void m68k_block_flush(void);
+
 
 /* Peek at the internals of a CPU context.  This can either be a context
  * retrieved using m68k_get_context() or the currently running context.
@@ -72,6 +72,23 @@
  */
 #define M68K_CHECK_PC_ADDRESS_ERROR OPT_OFF
 
+/* If ON, writes to 68k RAM through memory map base pointers mark modified
+ * pages for incremental savestates (see checkpoint.h).
+ */
+#define M68K_TRACK_RAM_WRITES       OPT_ON
+
+/* If ON, instructions are dispatched through a 16-bit index into a table of
+ * the distinct handler & cycle count pairs (see m68kops.h) rather than the
+ * full 64K entries handler and cycle tables, which are only used at init.
+ */
+#define M68K_COMPACT_DISPATCH       OPT_ON
+
+/* If ON, runs of instructions executed from read-only memory (cartridge ROM
+ * or CD BOOT ROM, see m68k_block_rom) are recorded in a block cache and replayed without
+ * fetching & decoding their opcodes again.
+ */
+#define M68K_BLOCK_CACHE            OPT_ON
+
 
 /* ----------------------------- COMPATIBILITY ---------------------------- */
 
@@ -4,8 +4,16 @@
 
 extern int vdp_68k_irq_ack(int int_level);
 
+#ifdef HOOK_CPU
+/* Debugger hooked instance (see m68khook.c) */
+extern void m68k_run_hook(unsigned int cycles);
+extern void m68k_execute_hook(void);
+#include "trace.h"
+#endif
+
 #define m68ki_cpu m68k
 #define MUL (7)
+#define M68K_NO_HOOK
 
 /* ======================================================================== */
 /* ================================ INCLUDES ============================== */
@@ -27,9 +35,37 @@ extern int vdp_68k_irq_ack(int int_level);
 static unsigned char m68ki_cycles[0x10000];
 #endif
 
-static int irq_latency;
+static MACHINE_LOCAL int irq_latency;
 
-m68ki_cpu_core m68k;
+MACHINE_LOCAL m68ki_cpu_core m68k;
+
+#if M68K_BLOCK_CACHE
+/* Block cache: runs of instructions executed from ROM, recorded by m68k_run */
+/* at their first execution, keyed by address & bank (page base) of the     */
+/* first instruction. A run ends with a branch (any non sequential PC), at a */
+/* 64KB page boundary or after BLOCK_LENGTH instructions.                   */
+#define BLOCK_COUNT  1024
+#define BLOCK_LENGTH 16
+
+typedef struct
+{
+  void (*handler)(void);  /* opcode handler */
+  uint pc;                /* instruction address */
+  uint16 ir;              /* opcode */
+  uint16 cycles;          /* opcode cycles */
+} m68ki_block_op;
+
+typedef struct
+{
+  const unsigned char *base;  /* page base when recorded, NULL if unused */
+  uint count;                 /* recorded instructions */
+  m68ki_block_op op[BLOCK_LENGTH];
+} m68ki_block;
+
+static MACHINE_LOCAL m68ki_block blocks[BLOCK_COUNT];
+static MACHINE_LOCAL const unsigned char *block_rom;
+static MACHINE_LOCAL uint block_rom_size;
+#endif
 
 
 /* ======================================================================== */
@@ -193,7 +229,7 @@ void m68k_set_fc_callback(void  (*callback)(unsigned int new_fc))
 #ifdef LOGERROR
 
 extern void error(char *format, ...);
-extern uint16 v_counter;
+extern MACHINE_LOCAL uint16 v_counter;
 #endif
 
 /* ASG: rewrote so that the int_level is a mask of the IPL0/IPL1/IPL2 bits */
@@ -232,14 +268,21 @@ void m68k_set_irq_delay(unsigned int int_level)
     if ((REG_IR & 0xF000) != 0x2000)
     {
       /* Finish executing current instruction */
-      USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+      USE_CYCLES(OPCODE_CYCLES(REG_IR));
 
       /* One instruction delay before interrupt */
       irq_latency = 1;
       m68ki_trace_t1() /* auto-disable (see m68kcpu.h) */
       m68ki_use_data_space() /* auto-disable (see m68kcpu.h) */
       REG_IR = m68ki_read_imm_16();
-      m68ki_instruction_jump_table[REG_IR]();
+#ifdef HOOK_CPU
+      if (trace_m68k_active)
+        trace_m68k(REG_PC - 2, REG_IR, m68k.cycles);
+      if (cpu_hook_mask & HOOK_M68K_RW)
+        m68k_execute_hook();
+      else
+#endif
+      OPCODE_HANDLER(REG_IR)();
       m68ki_exception_if_trace() /* auto-disable (see m68kcpu.h) */
       irq_latency = 0;
     }
@@ -256,8 +299,116 @@ void m68k_set_irq_delay(unsigned int int_level)
   m68ki_check_interrupts(); /* Level triggered (IRQ) */
 }
 
+#if M68K_BLOCK_CACHE
+/* Execute instructions while recording them in a block */
+static void m68ki_record_block(m68ki_block *block, const cpu_memory_map *map, uint cycles)
+{
+  uint pc;
+
+  block->base = map->base;
+  block->count = 0;
+
+  do
+  {
+    m68ki_block_op *op = &block->op[block->count];
+
+    m68ki_trace_t1() /* auto-disable (see m68kcpu.h) */
+    m68ki_use_data_space() /* auto-disable (see m68kcpu.h) */
+
+    pc = REG_PPC = REG_PC;
+    REG_IR = m68ki_read_imm_16();
+
+    op->pc = pc;
+    op->ir = REG_IR;
+    op->handler = OPCODE_HANDLER(REG_IR);
+    op->cycles = OPCODE_CYCLES(REG_IR);
+
+    op->handler();
+    USE_CYCLES(OPCODE_CYCLES(REG_IR));
+
+    m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
+
+    /* cache flushed or bank switched by this instruction */
+    if (block->base != map->base)
+    {
+      block->base = NULL;
+      return;
+    }
+
+    block->count++;
+
+    /* next instruction must directly follow in the same page (REG_IR is only modified by delayed IRQ) */
+    if (((REG_PC - pc - 2) > 8) || ((REG_PC >> 16) != (pc >> 16)) || (REG_IR != op->ir))
+    {
+      return;
+    }
+  }
+  while ((block->count < BLOCK_LENGTH) && (m68k.cycles < cycles));
+
+  /* incomplete run, recorded again next time */
+  if (block->count < BLOCK_LENGTH)
+  {
+    block->count = 0;
+  }
+}
+
+/* Execute instructions from the block cache, returns 0 if the current page can not be cached */
+static int m68ki_run_block(uint cycles)
+{
+  const cpu_memory_map *map = &m68k.memory_map[(REG_PC >> 16) & 0xff];
+  m68ki_block *block = &blocks[(REG_PC >> 1) & (BLOCK_COUNT - 1)];
+  uint i;
+
+  /* only pages of the registered ROM area are cached, unless ROM write is enabled (no write handlers) */
+  if ((((size_t)map->base - (size_t)block_rom) >= block_rom_size) || !map->write8 || !map->write16)
+  {
+    return 0;
+  }
+
+  if ((block->base != map->base) || !block->count || (block->op[0].pc != REG_PC))
+  {
+    m68ki_record_block(block, map, cycles);
+    return 1;
+  }
+
+  for (i = 0; (i < block->count) && (m68k.cycles < cycles); i++)
+  {
+    const m68ki_block_op *op = &block->op[i];
+
+    /* leave on taken branch, exception or bank switching */
+    if ((REG_PC != op->pc) || (map->base != block->base))
+    {
+      break;
+    }
+
+    m68ki_trace_t1() /* auto-disable (see m68kcpu.h) */
+    m68ki_use_data_space() /* auto-disable (see m68kcpu.h) */
+
+    REG_PPC = REG_PC;
+    REG_IR = op->ir;
+    REG_PC += 2;
+
+    op->handler();
+    USE_CYCLES((REG_IR == op->ir) ? op->cycles : OPCODE_CYCLES(REG_IR));
+
+    m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
+  }
+
+  return 1;
+}
+#endif
+
 void m68k_run(unsigned int cycles) 
 {
+#ifdef HOOK_CPU
+  /* 68K events subscribed or execution traced: use the instance with memory & execution hooks */
+  if ((cpu_hook_mask & (HOOK_M68K_E | HOOK_M68K_RW)) || trace_m68k_active)
+  {
+    m68k_run_hook(cycles);
+    return;
+  }
+#endif
+
   /* Make sure CPU is not already ahead */
   if (m68k.cycles >= cycles)
   {
@@ -286,27 +437,29 @@ void m68k_run(unsigned int cycles)
 
   while (m68k.cycles < cycles)
   {
+#if M68K_BLOCK_CACHE
+    /* Execute cached instructions if possible */
+    if (m68ki_run_block(cycles))
+    {
+      continue;
+    }
+#endif
+
     /* Set tracing accodring to T1. */
     m68ki_trace_t1() /* auto-disable (see m68kcpu.h) */
 
     /* Set the address space for reads */
     m68ki_use_data_space() /* auto-disable (see m68kcpu.h) */
 
-#ifdef HOOK_CPU
-    /* Trigger execution hook */
-    if (cpu_hook)
-      cpu_hook(HOOK_M68K_E, 0, REG_PC, 0);
-#endif
-
     /* Record previous program counter */
     REG_PPC = REG_PC;
 
     /* Decode next instruction */
     REG_IR = m68ki_read_imm_16();
 
-    /* Execute instruction */
-    m68ki_instruction_jump_table[REG_IR]();
-    USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+    /* Execute instruction (REG_IR is reloaded when an IRQ is delayed) */
+    OPCODE_HANDLER(REG_IR)();
+    USE_CYCLES(OPCODE_CYCLES(REG_IR));
 
     /* Trace m68k_exception, if necessary */
     m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
@@ -320,13 +473,18 @@ int m68k_cycles(void)
 
 void m68k_init(void)
 {
-#ifdef BUILD_TABLES
+#if defined(BUILD_TABLES) || M68K_COMPACT_DISPATCH
   static uint emulation_initialized = 0;
 
   /* The first call to this function initializes the opcode handler jump table */
   if(!emulation_initialized)
   {
+#ifdef BUILD_TABLES
     m68ki_build_opcode_table();
+#endif
+#if M68K_COMPACT_DISPATCH
+    m68ki_build_opcode_index();
+#endif
     emulation_initialized = 1;
   }
 #endif
@@ -401,6 +559,23 @@ void m68k_clear_halt(void)
   CPU_STOPPED &= ~STOP_LEVEL_HALT;
 }
 
+void m68k_block_rom(const unsigned char *base, unsigned int size)
+{
+#if M68K_BLOCK_CACHE
+  block_rom = base;
+  block_rom_size = size;
+#endif
+  m68k_block_flush();
+}
+
+void m68k_block_flush(void)
+{
+#if M68K_BLOCK_CACHE
+  /* also ends execution of the current block (see m68ki_run_block) */
+  memset(blocks, 0, sizeof(blocks));
+#endif
+}
+
 /* ======================================================================== */
 /* ============================== END OF FILE ============================= */
 /* ======================================================================== */
@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 
 #if M68K_EMULATE_ADDRESS_ERROR
@@ -15,6 +16,7 @@
 
 #include "m68k.h"
 #include "debug.h"
+#include "checkpoint.h"
 
 
 /* ======================================================================== */
@@ -217,6 +219,13 @@
 #endif
 
 #define CYC_INSTRUCTION   m68ki_cycles
+#if M68K_COMPACT_DISPATCH
+#define OPCODE_HANDLER(A) m68ki_opcode_table[m68ki_opcode_index[A]].handler
+#define OPCODE_CYCLES(A)  m68ki_opcode_table[m68ki_opcode_index[A]].cycles
+#else
+#define OPCODE_HANDLER(A) m68ki_instruction_jump_table[A]
+#define OPCODE_CYCLES(A)  CYC_INSTRUCTION[A]
+#endif
 #define CYC_EXCEPTION     m68ki_exception_cycle_table
 #define CYC_BCC_NOTAKE_B  ( -2 * MUL)
 #define CYC_BCC_NOTAKE_W  (  2 * MUL)
@@ -337,6 +346,21 @@
 #endif /* M68K_ADDRESS_ERROR */
 
 
+/* Enable or disable CPU hooks (see cpuhook.h) */
+#if defined(HOOK_CPU) && !defined(M68K_NO_HOOK)
+  #define m68ki_cpu_hook(TYPE, WIDTH, ADDR, VAL) cpu_hook_call(TYPE, WIDTH, ADDR, VAL)
+#else
+  #define m68ki_cpu_hook(TYPE, WIDTH, ADDR, VAL)
+#endif /* HOOK_CPU */
+
+/* Track modified RAM pages (see checkpoint.h) */
+#if M68K_TRACK_RAM_WRITES
+  #define m68ki_mark_ram(BASE, ADDR) MARK_RAM_DIRTY((BASE) + ((ADDR) & 0xffff))
+#else
+  #define m68ki_mark_ram(BASE, ADDR)
+#endif /* M68K_TRACK_RAM_WRITES */
+
+
 /* -------------------------- EA / Operand Access ------------------------- */
 
 /*
@@ -859,10 +883,7 @@ INLINE uint m68ki_read_8(uint address)
   if (temp->read8) val = (*temp->read8)(ADDRESS_68K(address));
   else val = READ_BYTE(temp->base, (address) & 0xffff);
 
-#ifdef HOOK_CPU
-  if (cpu_hook)
-    cpu_hook(HOOK_M68K_R, 1, address, val);
-#endif
+  m68ki_cpu_hook(HOOK_M68K_R, 1, address, val); /* auto-disable (see m68kcpu.h) */
 
   return val;
 }
@@ -879,10 +900,7 @@ INLINE uint m68ki_read_16(uint address)
   if (temp->read16) val = (*temp->read16)(ADDRESS_68K(address));
   else val = *(uint16 *)(temp->base + ((address) & 0xffff));
 
-#ifdef HOOK_CPU
-  if (cpu_hook)
-    cpu_hook(HOOK_M68K_R, 2, address, val);
-#endif
+  m68ki_cpu_hook(HOOK_M68K_R, 2, address, val); /* auto-disable (see m68kcpu.h) */
 
   return val;
 }
@@ -899,10 +917,7 @@ INLINE uint m68ki_read_32(uint address)
   if (temp->read16) val = ((*temp->read16)(ADDRESS_68K(address)) << 16) | ((*temp->read16)(ADDRESS_68K(address + 2)));
   else val = m68k_read_immediate_32(address);
 
-#ifdef HOOK_CPU
-  if (cpu_hook)
-    cpu_hook(HOOK_M68K_R, 4, address, val);
-#endif
+  m68ki_cpu_hook(HOOK_M68K_R, 4, address, val); /* auto-disable (see m68kcpu.h) */
 
   return val;
 }
@@ -913,14 +928,15 @@ INLINE void m68ki_write_8(uint address, uint value)
 
   m68ki_set_fc(FLAG_S | FUNCTION_CODE_USER_DATA) /* auto-disable (see m68kcpu.h) */
 
-#ifdef HOOK_CPU
-  if (cpu_hook)
-    cpu_hook(HOOK_M68K_W, 1, address, value);
-#endif
+  m68ki_cpu_hook(HOOK_M68K_W, 1, address, value); /* auto-disable (see m68kcpu.h) */
 
   temp = &m68ki_cpu.memory_map[((address)>>16)&0xff];
   if (temp->write8) (*temp->write8)(ADDRESS_68K(address),value);
-  else WRITE_BYTE(temp->base, (address) & 0xffff, value);
+  else
+  {
+    WRITE_BYTE(temp->base, (address) & 0xffff, value);
+    m68ki_mark_ram(temp->base, address) /* auto-disable (see m68kcpu.h) */
+  }
 }
 
 INLINE void m68ki_write_16(uint address, uint value)
@@ -930,14 +946,15 @@ INLINE void m68ki_write_16(uint address, uint value)
   m68ki_set_fc(FLAG_S | FUNCTION_CODE_USER_DATA) /* auto-disable (see m68kcpu.h) */
   m68ki_check_address_error(address, MODE_WRITE, FLAG_S | FUNCTION_CODE_USER_DATA); /* auto-disable (see m68kcpu.h) */
 
-#ifdef HOOK_CPU
-  if (cpu_hook)
-    cpu_hook(HOOK_M68K_W, 2, address, value);
-#endif
+  m68ki_cpu_hook(HOOK_M68K_W, 2, address, value); /* auto-disable (see m68kcpu.h) */
 
   temp = &m68ki_cpu.memory_map[((address)>>16)&0xff];
   if (temp->write16) (*temp->write16)(ADDRESS_68K(address),value);
-  else *(uint16 *)(temp->base + ((address) & 0xffff)) = value;
+  else
+  {
+    *(uint16 *)(temp->base + ((address) & 0xffff)) = value;
+    m68ki_mark_ram(temp->base, address) /* auto-disable (see m68kcpu.h) */
+  }
 }
 
 INLINE void m68ki_write_32(uint address, uint value)
@@ -947,18 +964,23 @@ INLINE void m68ki_write_32(uint address, uint value)
   m68ki_set_fc(FLAG_S | FUNCTION_CODE_USER_DATA) /* auto-disable (see m68kcpu.h) */
   m68ki_check_address_error(address, MODE_WRITE, FLAG_S | FUNCTION_CODE_USER_DATA) /* auto-disable (see m68kcpu.h) */
 
-#ifdef HOOK_CPU
-  if (cpu_hook)
-    cpu_hook(HOOK_M68K_W, 4, address, value);
-#endif
+  m68ki_cpu_hook(HOOK_M68K_W, 4, address, value); /* auto-disable (see m68kcpu.h) */
 
   temp = &m68ki_cpu.memory_map[((address)>>16)&0xff];
   if (temp->write16) (*temp->write16)(ADDRESS_68K(address),value>>16);
-  else *(uint16 *)(temp->base + ((address) & 0xffff)) = value >> 16;
+  else
+  {
+    *(uint16 *)(temp->base + ((address) & 0xffff)) = value >> 16;
+    m68ki_mark_ram(temp->base, address) /* auto-disable (see m68kcpu.h) */
+  }
 
   temp = &m68ki_cpu.memory_map[((address + 2)>>16)&0xff];
   if (temp->write16) (*temp->write16)(ADDRESS_68K(address+2),value&0xffff);
-  else *(uint16 *)(temp->base + ((address + 2) & 0xffff)) = value;
+  else
+  {
+    *(uint16 *)(temp->base + ((address + 2) & 0xffff)) = value;
+    m68ki_mark_ram(temp->base, address + 2) /* auto-disable (see m68kcpu.h) */
+  }
 }
 
 
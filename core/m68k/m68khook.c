@@ -0,0 +1,123 @@
+/* ======================================================================== */
+/*                     MAIN 68K CORE (DEBUGGER HOOKS)                       */
+/* ======================================================================== */
+
+/* Second instance of the MAIN 68K core, compiled with CPU hooks on every
+ * memory access and instruction fetch. m68k_run() switches to it while 68K
+ * events are subscribed, so the regular core (m68kcpu.c) does not have to
+ * test the hook on each access. Both instances share the m68k context.
+ */
+
+#ifdef HOOK_CPU
+
+extern int vdp_68k_irq_ack(int int_level);
+
+#include "trace.h"
+
+#define m68ki_cpu m68k
+#define MUL (7)
+
+/* ======================================================================== */
+/* ================================ INCLUDES ============================== */
+/* ======================================================================== */
+
+#ifndef BUILD_TABLES
+#include "m68ki_cycles.h"
+#endif
+
+#include "m68kconf.h"
+
+/* Hooked instance keeps the full handler & cycle tables */
+#undef M68K_COMPACT_DISPATCH
+#define M68K_COMPACT_DISPATCH OPT_OFF
+
+#include "m68kcpu.h"
+#include "m68kops.h"
+
+/* ======================================================================== */
+/* ================================= DATA ================================= */
+/* ======================================================================== */
+
+#ifdef BUILD_TABLES
+static unsigned char m68ki_cycles[0x10000];
+#endif
+
+/* ======================================================================== */
+/* ================================= API ================================== */
+/* ======================================================================== */
+
+void m68k_execute_hook(void)
+{
+  m68ki_instruction_jump_table[REG_IR]();
+}
+
+void m68k_run_hook(unsigned int cycles) 
+{
+#ifdef BUILD_TABLES
+  static uint emulation_initialized = 0;
+
+  /* The first call to this function initializes the opcode handler jump table */
+  if(!emulation_initialized)
+  {
+    m68ki_build_opcode_table();
+    emulation_initialized = 1;
+  }
+#endif
+
+  /* Make sure CPU is not already ahead */
+  if (m68k.cycles >= cycles)
+  {
+    return;
+  }
+
+  /* Check interrupt mask to process IRQ if needed */
+  m68ki_check_interrupts();
+
+  /* Make sure we're not stopped */
+  if (CPU_STOPPED)
+  {
+    m68k.cycles = cycles;
+    return;
+  }
+
+  /* Save end cycles count for when CPU is stopped */
+  m68k.cycle_end = cycles;
+
+  /* Return point for when we have an address error (TODO: use goto) */
+  m68ki_set_address_error_trap() /* auto-disable (see m68kcpu.h) */
+
+  while (m68k.cycles < cycles)
+  {
+    /* Set tracing accodring to T1. */
+    m68ki_trace_t1() /* auto-disable (see m68kcpu.h) */
+
+    /* Set the address space for reads */
+    m68ki_use_data_space() /* auto-disable (see m68kcpu.h) */
+
+    /* Trigger execution hook */
+    cpu_hook_call(HOOK_M68K_E, 0, REG_PC, 0);
+
+    /* Record previous program counter */
+    REG_PPC = REG_PC;
+
+    /* Decode next instruction */
+    REG_IR = m68ki_read_imm_16();
+
+    /* Record instruction in the execution trace */
+    if (trace_m68k_active)
+      trace_m68k(REG_PPC, REG_IR, m68k.cycles);
+
+    /* Execute instruction */
+    m68ki_instruction_jump_table[REG_IR]();
+    USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+
+    /* Trace m68k_exception, if necessary */
+    m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
+  }
+}
+
+#endif /* HOOK_CPU */
+
+/* ======================================================================== */
+/* ============================== END OF FILE ============================= */
+/* ======================================================================== */
@@ -25483,6 +25483,66 @@ static void m68ki_build_opcode_table(void)
 
 #endif
 
+#if M68K_COMPACT_DISPATCH
+
+/* Distinct handler & cycle count pairs (1702 of them) */
+#define M68K_OPCODE_MAX 0x800
+
+typedef struct
+{
+  void (*handler)(void);  /* handler function */
+  uint cycles;            /* master cycles */
+} m68ki_opcode_struct;
+
+static m68ki_opcode_struct m68ki_opcode_table[M68K_OPCODE_MAX];
+
+/* opcode to compact table entry (128 KB instead of 576 KB of jump & cycle tables) */
+static uint16 m68ki_opcode_index[0x10000];
+
+/* Build the compact opcode table from the handler jump & cycle tables */
+INLINE void m68ki_build_opcode_index(void)
+{
+  uint16 hash[M68K_OPCODE_MAX * 2] = {0};
+  uint count = 0;
+  int i;
+
+  for(i = 0; i < 0x10000; i++)
+  {
+    void (*handler)(void) = m68ki_instruction_jump_table[i];
+    uint cycles = CYC_INSTRUCTION[i];
+    uint h;
+
+    /* neighbour opcodes mostly share their handler */
+    if(i && (m68ki_opcode_table[m68ki_opcode_index[i - 1]].handler == handler) && (m68ki_opcode_table[m68ki_opcode_index[i - 1]].cycles == cycles))
+    {
+      m68ki_opcode_index[i] = m68ki_opcode_index[i - 1];
+      continue;
+    }
+
+    h = ((uint)((size_t)handler >> 4) ^ (cycles * 0x9e37)) & (M68K_OPCODE_MAX * 2 - 1);
+    while(hash[h])
+    {
+      const m68ki_opcode_struct *entry = &m68ki_opcode_table[hash[h] - 1];
+      if((entry->handler == handler) && (entry->cycles == cycles))
+      {
+        break;
+      }
+      h = (h + 1) & (M68K_OPCODE_MAX * 2 - 1);
+    }
+
+    if(!hash[h])
+    {
+      m68ki_opcode_table[count].handler = handler;
+      m68ki_opcode_table[count].cycles = cycles;
+      hash[h] = ++count;
+    }
+
+    m68ki_opcode_index[i] = hash[h] - 1;
+  }
+}
+
+#endif /* M68K_COMPACT_DISPATCH */
+
 /* ======================================================================== */
 /* ============================== END OF FILE ============================= */
 /* ======================================================================== */
@@ -72,6 +72,23 @@
  */
 #define M68K_CHECK_PC_ADDRESS_ERROR OPT_OFF
 
+/* If ON, writes to 68k RAM through memory map base pointers mark modified
+ * pages for incremental savestates (see checkpoint.h).
+ */
+#define M68K_TRACK_RAM_WRITES       OPT_OFF
+
+/* If ON, instructions are dispatched through a 16-bit index into a table of
+ * the distinct handler & cycle count pairs (see m68kops.h) rather than the
+ * full 64K entries handler and cycle tables, which are only used at init.
+ */
+#define M68K_COMPACT_DISPATCH       OPT_ON
+
+/* If ON, loops only reading memory are detected and skipped until the end
+ * of the current execution slice when entered with unchanged registers
+ * (see s68kcpu.c).
+ */
+#define M68K_IDLE_SKIP              OPT_ON
+
 
 /* ----------------------------- COMPATIBILITY ---------------------------- */
 
@@ -26,7 +26,7 @@ extern int scd_68k_irq_ack(int level);
 #ifdef BUILD_TABLES
 static unsigned char s68ki_cycles[0x10000];
 #endif
-static int irq_latency;
+static MACHINE_LOCAL int irq_latency;
 
 /* IRQ priority */
 static const uint8 irq_level[0x40] = 
@@ -41,7 +41,20 @@ static const uint8 irq_level[0x40] =
   6, 6, 6, 6, 6, 6, 6, 6
 };
 
-m68ki_cpu_core s68k;
+MACHINE_LOCAL m68ki_cpu_core s68k;
+
+#if M68K_IDLE_SKIP
+/* Last loop entered through a backward branch (see s68ki_idle_check) */
+static MACHINE_LOCAL struct
+{
+  uint pc;        /* loop start address, 1 if none */
+  uint branch;    /* address of the branch back to loop start */
+  uint enabled;   /* loop may be skipped */
+  uint cycles;    /* cycle counter when the loop was last entered */
+  uint dar[16];   /* registers & flags when the loop was last entered */
+  uint sr[8];
+} s68k_idle;
+#endif
 
 
 /* ======================================================================== */
@@ -84,6 +97,227 @@ static void default_set_fc_callback(unsigned int new_fc)
 #endif
 
 
+#if M68K_IDLE_SKIP
+/* ======================================================================== */
+/* ============================ IDLE LOOPS ================================ */
+/* ======================================================================== */
+
+/* SUB-CPU code often waits in a loop reading PRG-RAM or Word-RAM until an
+ * interrupt handler or the MAIN-CPU modifies it (BIOS main loop, VBLANK
+ * counters...), which is not caught by register polling detection (see
+ * scd.c). Interrupts are only processed on s68k_run() entry or when SR is
+ * modified and no other code touches memory during an execution slice, so
+ * a loop that only reads memory and enters twice with the same registers &
+ * flags will run identically until the end of the slice: remaining loop
+ * iterations are skipped by only incrementing the cycle counter.
+ */
+
+static void s68ki_idle_save(void)
+{
+  memcpy(s68k_idle.dar, REG_DA, sizeof(s68k_idle.dar));
+  s68k_idle.sr[0] = FLAG_T1;
+  s68k_idle.sr[1] = FLAG_S;
+  s68k_idle.sr[2] = FLAG_X;
+  s68k_idle.sr[3] = FLAG_N;
+  s68k_idle.sr[4] = FLAG_Z;
+  s68k_idle.sr[5] = FLAG_V;
+  s68k_idle.sr[6] = FLAG_C;
+  s68k_idle.sr[7] = FLAG_INT_MASK;
+  s68k_idle.cycles = s68k.cycles;
+}
+
+static int s68ki_idle_same(void)
+{
+  return !memcmp(s68k_idle.dar, REG_DA, sizeof(s68k_idle.dar)) &&
+         (s68k_idle.sr[0] == FLAG_T1) && (s68k_idle.sr[1] == FLAG_S) &&
+         (s68k_idle.sr[2] == FLAG_X) && (s68k_idle.sr[3] == FLAG_N) &&
+         (s68k_idle.sr[4] == FLAG_Z) && (s68k_idle.sr[5] == FLAG_V) &&
+         (s68k_idle.sr[6] == FLAG_C) && (s68k_idle.sr[7] == FLAG_INT_MASK);
+}
+
+/* Check an effective address only reads memory without I/O handler (size: 0=byte, 1=word, 2=long) */
+static int s68ki_idle_ea(uint ea, uint size, uint src, uint *pc)
+{
+  uint address;
+
+  switch (ea >> 3)
+  {
+    case 0: /* Dn */
+      return 1;
+
+    case 2: /* (An) */
+      address = REG_A[ea & 7];
+      break;
+
+    case 5: /* (d16,An) */
+      address = REG_A[ea & 7] + MAKE_INT_16(m68k_read_immediate_16(*pc));
+      *pc += 2;
+      break;
+
+    case 7:
+    {
+      switch (ea & 7)
+      {
+        case 0: /* (xxx).W */
+          address = MAKE_INT_16(m68k_read_immediate_16(*pc));
+          *pc += 2;
+          break;
+
+        case 1: /* (xxx).L */
+          address = m68k_read_immediate_32(*pc);
+          *pc += 4;
+          break;
+
+        case 2: /* (d16,PC) */
+          if (!src) return 0;
+          address = *pc + MAKE_INT_16(m68k_read_immediate_16(*pc));
+          *pc += 2;
+          break;
+
+        case 4: /* #imm */
+          if (!src) return 0;
+          *pc += (size == 2) ? 4 : 2;
+          return 1;
+
+        default:
+          return 0;
+      }
+      break;
+    }
+
+    default:
+      return 0;
+  }
+
+  /* first and last accessed bytes */
+  address = ADDRESS_68K(address);
+  size = ADDRESS_68K(address + (1 << size) - 1);
+  return !m68ki_cpu.memory_map[(address >> 16) & 0xff].read8 && !m68ki_cpu.memory_map[(address >> 16) & 0xff].read16 &&
+         !m68ki_cpu.memory_map[(size >> 16) & 0xff].read8 && !m68ki_cpu.memory_map[(size >> 16) & 0xff].read16;
+}
+
+/* Check loop body only contains instructions reading memory & modifying data registers or flags */
+static int s68ki_idle_body(uint pc, uint branch)
+{
+  while (pc < branch)
+  {
+    uint op = m68k_read_immediate_16(pc);
+    uint size = (op >> 6) & 3;
+    uint src = 1;
+    pc += 2;
+
+    if (op == 0x4e71)
+    {
+      /* NOP */
+      continue;
+    }
+    else if (((op & 0xf100) == 0xb000) || ((op & 0xf100) == 0xc000) || ((op & 0xf100) == 0x8000))
+    {
+      /* CMP/AND/OR <ea>,Dn */
+      if (size == 3) return 0;
+    }
+    else if (!(op & 0xc1c0) && (op & 0x3000))
+    {
+      /* MOVE <ea>,Dn */
+      size = (op & 0x1000) ? ((op >> 13) & 1) : 2;
+    }
+    else if ((op & 0xff00) == 0x4a00)
+    {
+      /* TST <ea> */
+      if (size == 3) return 0;
+      src = 0;
+    }
+    else if ((op & 0xff00) == 0x0c00)
+    {
+      /* CMPI #imm,<ea> */
+      if (size == 3) return 0;
+      pc += (size == 2) ? 4 : 2;
+      src = 0;
+    }
+    else if ((op & 0xffc0) == 0x0800)
+    {
+      /* BTST #n,<ea> */
+      pc += 2;
+      size = 0;
+      src = 0;
+    }
+    else if ((op & 0xf1c0) == 0x0100)
+    {
+      /* BTST Dn,<ea> */
+      size = 0;
+      src = 0;
+    }
+    else
+    {
+      return 0;
+    }
+
+    /* An direct (or MOVEP) and address register updates are not allowed */
+    if (((op & 0x38) == 0x08) || !s68ki_idle_ea(op & 0x3f, size, src, &pc))
+    {
+      return 0;
+    }
+  }
+
+  return (pc == branch);
+}
+
+/* Called after a backward branch from branch address */
+static void s68ki_idle_check(uint branch, uint cycles)
+{
+  uint count;
+
+  /* new loop ? */
+  if ((REG_PC != s68k_idle.pc) || (branch != s68k_idle.branch))
+  {
+    s68k_idle.pc = REG_PC;
+    s68k_idle.branch = branch;
+
+    /* short loops ending with BRA or Bcc only */
+    count = m68k_read_immediate_16(branch);
+    s68k_idle.enabled = ((branch - REG_PC) <= 32) && ((count & 0xf000) == 0x6000) && ((count & 0x0f00) != 0x0100);
+    if (s68k_idle.enabled)
+    {
+      s68ki_idle_save();
+    }
+    return;
+  }
+
+  /* loop rejected ? */
+  if (!s68k_idle.enabled)
+  {
+    return;
+  }
+
+  /* registers or flags modified by last iteration ? */
+  if (!s68ki_idle_same())
+  {
+    s68ki_idle_save();
+    return;
+  }
+
+  /* loop body not safe to skip ? */
+  if (!s68ki_idle_body(REG_PC, branch))
+  {
+    s68k_idle.enabled = 0;
+    return;
+  }
+
+  /* skip all loop iterations except the last one, which may end after the slice */
+  if (s68k.cycles < cycles)
+  {
+    uint loop_cycles = s68k.cycles - s68k_idle.cycles;
+    count = (cycles - s68k.cycles) / loop_cycles;
+    if (count > 1)
+    {
+      s68k.cycles += (count - 1) * loop_cycles;
+    }
+  }
+
+  s68k_idle.cycles = s68k.cycles;
+}
+#endif
+
 /* ======================================================================== */
 /* ================================= API ================================== */
 /* ======================================================================== */
@@ -201,7 +435,7 @@ void s68k_set_fc_callback(void  (*callback)(unsigned int new_fc))
 #endif
 
 extern void error(char *format, ...);
-extern uint16 v_counter;
+extern MACHINE_LOCAL uint16 v_counter;
 
 /* update IRQ level according to triggered interrupts */
 void s68k_update_irq(unsigned int mask)
@@ -238,6 +472,11 @@ void s68k_run(unsigned int cycles)
   /* Save end cycles count for when CPU is stopped */
   s68k.cycle_end = cycles;
 
+#if M68K_IDLE_SKIP
+  /* memory may have been modified since last execution */
+  s68k_idle.pc = 1;
+#endif
+
   /* Return point for when we have an address error (TODO: use goto) */
   m68ki_set_address_error_trap() /* auto-disable (see m68kcpu.h) */
 
@@ -247,6 +486,10 @@ void s68k_run(unsigned int cycles)
  
   while (s68k.cycles < cycles)
   {
+#if M68K_IDLE_SKIP
+    uint pc = REG_PC;
+#endif
+
     /* Set tracing accodring to T1. */
     m68ki_trace_t1() /* auto-disable (see m68kcpu.h) */
 
@@ -257,8 +500,16 @@ void s68k_run(unsigned int cycles)
     REG_IR = m68ki_read_imm_16();
 
     /* Execute instruction */
-    m68ki_instruction_jump_table[REG_IR]();
-    USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+    OPCODE_HANDLER(REG_IR)();
+    USE_CYCLES(OPCODE_CYCLES(REG_IR));
+
+#if M68K_IDLE_SKIP
+    /* Check loops for idle SUB-CPU */
+    if (REG_PC < pc)
+    {
+      s68ki_idle_check(pc, cycles);
+    }
+#endif
 
     /* Trace m68k_exception, if necessary */
     m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
@@ -273,13 +524,18 @@ int s68k_cycles(void)
 
 void s68k_init(void)
 {
-#ifdef BUILD_TABLES
+#if defined(BUILD_TABLES) || M68K_COMPACT_DISPATCH
   static uint emulation_initialized = 0;
 
   /* The first call to this function initializes the opcode handler jump table */
   if(!emulation_initialized)
   {
+#ifdef BUILD_TABLES
     m68ki_build_opcode_table();
+#endif
+#if M68K_COMPACT_DISPATCH
+    m68ki_build_opcode_index();
+#endif
     emulation_initialized = 1;
   }
 #endif
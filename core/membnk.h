@@ -59,7 +59,7 @@ typedef struct
   void (*write)(unsigned int address, unsigned int data);
 } t_zbank_memory_map;
 
-extern t_zbank_memory_map zbank_memory_map[256];
+extern MACHINE_LOCAL t_zbank_memory_map zbank_memory_map[256];
 
 #ifdef __cplusplus
 }
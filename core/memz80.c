@@ -142,6 +142,7 @@ void z80_memory_w(unsigned int address, unsigned char data)
     case 1: 
     {
       zram[address & 0x1FFF] = data;
+      MARK_PAGE_DIRTY(zram_dirty, address & 0x1FFF);
       return;
     }
 
@@ -189,6 +190,7 @@ void z80_memory_w(unsigned int address, unsigned char data)
         return;
       }
       WRITE_BYTE(m68k.memory_map[address >> 16].base, address & 0xFFFF, data);
+      MARK_RAM_DIRTY(m68k.memory_map[address >> 16].base + (address & 0xFFFF));
       return;
     }
   }
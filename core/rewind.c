@@ -0,0 +1,107 @@
+/***************************************************************************************
+ *  Genesis Plus
+ *  Rewind buffer (XOR deltas between consecutive savestates)
+ *
+ ****************************************************************************************/
+
+#include "shared.h"
+#include "snapshot.h"
+#include "rewind.h"
+
+/* Captures are pushed to a snapshot ring without keyframes (see snapshot.c): */
+/* the newest state is kept in full, older ones as backward XOR deltas that  */
+/* are dropped oldest first when the budget is exceeded.                     */
+
+#define FRAME_BYTES 1024 /* at most one frame per KB of budget */
+
+MACHINE_LOCAL rewind_stats_t rewind_stats;
+
+static MACHINE_LOCAL snapshot_ring_t ring;
+static MACHINE_LOCAL uint8 *state;
+
+static void update_stats(void)
+{
+  rewind_stats.frames = ring.count;
+  rewind_stats.bytes = ring.bytes;
+  rewind_stats.state_size = ring.newest.size;
+}
+
+int rewind_init(uint32 budget)
+{
+  rewind_shutdown();
+
+  if (!budget)
+  {
+    return 1;
+  }
+
+  state = malloc(STATE_SIZE);
+
+  if (!state || !snapshot_ring_init(&ring, budget / FRAME_BYTES, 0, budget, 0))
+  {
+    rewind_shutdown();
+    return 0;
+  }
+
+  rewind_stats.budget = budget;
+  return 1;
+}
+
+void rewind_shutdown(void)
+{
+  snapshot_ring_free(&ring);
+  free(state);
+  state = NULL;
+  memset(&rewind_stats, 0, sizeof(rewind_stats));
+}
+
+void rewind_clear(void)
+{
+  /* next capture starts over from a full state */
+  snapshot_ring_clear(&ring);
+  rewind_stats.last_bytes = 0;
+  update_stats();
+}
+
+int rewind_capture(void)
+{
+  int first;
+
+  if (!rewind_stats.budget)
+  {
+    return 0;
+  }
+
+  first = !ring.newest.size;
+
+  if (!snapshot_push(&ring, state, state_save(state), rewind_stats.captures))
+  {
+    return 0;
+  }
+
+  if (!first)
+  {
+    rewind_stats.last_bytes = ring.last_size;
+    rewind_stats.total_bytes += ring.last_size;
+  }
+
+  rewind_stats.captures++;
+  update_stats();
+  return 1;
+}
+
+/* Loads the state captured up to frames captures before the newest one,    */
+/* returns the number of frames actually rewound. */
+int rewind_step(int frames)
+{
+  int count = snapshot_step_back(&ring, frames);
+
+  if (count && !state_load_hot(snapshot_newest(&ring)))
+  {
+    rewind_clear();
+    return 0;
+  }
+
+  update_stats();
+  return count;
+}
@@ -0,0 +1,38 @@
+/***************************************************************************************
+ *  Genesis Plus
+ *  Rewind buffer (XOR deltas between consecutive savestates)
+ *
+ ****************************************************************************************/
+
+#ifndef _REWIND_H_
+#define _REWIND_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  uint32 budget;      /* bytes reserved for deltas, 0 when disabled */
+  uint32 frames;      /* captures that can be rewound */
+  uint32 bytes;       /* bytes held by their deltas */
+  uint32 last_bytes;  /* delta size of the newest capture */
+  uint32 state_size;  /* size of the newest state */
+  uint32 captures;    /* since rewind_init */
+  unsigned long long total_bytes; /* delta bytes of all captures */
+} rewind_stats_t;
+
+extern MACHINE_LOCAL rewind_stats_t rewind_stats;
+
+/* Function prototypes */
+extern int rewind_init(uint32 budget);
+extern void rewind_shutdown(void);
+extern void rewind_clear(void);
+extern int rewind_capture(void);
+extern int rewind_step(int frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _REWIND_H_ */
@@ -40,6 +40,7 @@ extern "C" {
 #include "areplay.h"
 #include "svp.h"
 #include "state.h"
+#include "checkpoint.h"
 
 #ifdef __cplusplus
 }
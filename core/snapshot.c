@@ -0,0 +1,571 @@
+/***************************************************************************************
+ *  Genesis Plus
+ *  Savestate snapshot ring (keyframes + delta encoded states)
+ *
+ ****************************************************************************************/
+
+#include "shared.h"
+#include "snapshot.h"
+
+/* Snapshots are grouped behind a keyframe: a delta only depends on the     */
+/* newest keyframe pushed before it, so the ring always drops whole groups, */
+/* oldest first.                                                            */
+/*                                                                          */
+/* Rings without keyframe interval keep only the newest state as a full     */
+/* image. Every push stores the XOR of the new state with the previous one, */
+/* so that stepping back a snapshot applies a single delta to the newest    */
+/* state, and older deltas are never needed to restore newer snapshots:     */
+/* the oldest ones are dropped one at a time.                               */
+/*                                                                          */
+/* Deltas are sequences of (equal words, changed words) varint pairs, each  */
+/* followed by the XOR of the changed 32-bit words (see pack_word).         */
+
+/* mask bytes, runs are at least two equal words apart */
+#define MAX_DELTA(words) (((words) << 2) + ((words) >> 1) + 16)
+
+static int slot_index(snapshot_ring_t *ring, int index)
+{
+  return (ring->first + index) % ring->capacity;
+}
+
+static void free_slot(snapshot_ring_t *ring, int slot)
+{
+  snapshot_t *s = &ring->slots[slot];
+
+  if (s->key)
+  {
+    ring->keyframes--;
+  }
+
+  ring->bytes -= s->data_size;
+  free(s->data);
+  memset(s, 0, sizeof(snapshot_t));
+}
+
+static void drop_oldest_group(snapshot_ring_t *ring)
+{
+  do
+  {
+    free_slot(ring, ring->first);
+    ring->first = (ring->first + 1) % ring->capacity;
+    ring->count--;
+  }
+  while (ring->count && ring->keyframe_interval && !ring->slots[ring->first].key);
+}
+
+static snapshot_t *newest_keyframe(snapshot_ring_t *ring)
+{
+  int i;
+
+  for (i = ring->count - 1; i >= 0; i--)
+  {
+    snapshot_t *s = &ring->slots[slot_index(ring, i)];
+    if (s->key)
+    {
+      return s;
+    }
+  }
+
+  return NULL;
+}
+
+static uint8 *put_varint(uint8 *out, uint32 value)
+{
+  while (value >= 0x80)
+  {
+    *out++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+
+  *out++ = value;
+  return out;
+}
+
+static const uint8 *get_varint(const uint8 *in, uint32 *value)
+{
+  uint32 result = 0;
+  int shift = 0;
+
+  do
+  {
+    result |= (*in & 0x7f) << shift;
+    shift += 7;
+  }
+  while (*in++ & 0x80);
+
+  *value = result;
+  return in;
+}
+
+/* Changed words are mostly zero bytes once XORed: each pair of words is   */
+/* stored as a mask byte (a nibble per word, a bit per non zero byte)       */
+/* followed by the non zero bytes. */
+static uint8 *pack_word(uint8 *out, uint32 diff, uint8 *mask, int shift)
+{
+  int i;
+
+  for (i = 0; i < 4; i++, diff >>= 8)
+  {
+    if (diff & 0xff)
+    {
+      *mask |= 1 << (shift + i);
+      *out++ = diff;
+    }
+  }
+
+  return out;
+}
+
+static const uint8 *unpack_word(const uint8 *in, uint32 *data, uint32 mask)
+{
+  uint32 diff = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+  {
+    if (mask & (1 << i))
+    {
+      diff |= (uint32)*in++ << (i * 8);
+    }
+  }
+
+  *data ^= diff;
+  return in;
+}
+
+/* Encodes the XOR of two states (words long) into out, which must hold */
+/* MAX_DELTA(words) bytes, returns the encoded bytes. */
+static uint32 encode_delta(const uint32 *older, const uint32 *newer, uint32 words, uint8 *out)
+{
+  uint8 *ptr = out;
+  uint32 pos = 0;
+
+  while (pos < words)
+  {
+    uint32 start = pos;
+
+    /* unchanged words, two at a time */
+    while ((pos + 2 <= words) && !((older[pos] ^ newer[pos]) | (older[pos + 1] ^ newer[pos + 1])))
+    {
+      pos += 2;
+    }
+
+    while ((pos < words) && (older[pos] == newer[pos]))
+    {
+      pos++;
+    }
+
+    if (pos == words)
+    {
+      break;
+    }
+
+    ptr = put_varint(ptr, pos - start);
+    start = pos;
+
+    /* changed words, a single unchanged word does not end the run */
+    while ((pos < words) && ((older[pos] != newer[pos]) || ((pos + 1 < words) && (older[pos + 1] != newer[pos + 1]))))
+    {
+      pos++;
+    }
+
+    ptr = put_varint(ptr, pos - start);
+
+    for (; start < pos; start += 2)
+    {
+      uint8 *mask = ptr++;
+      *mask = 0;
+      ptr = pack_word(ptr, older[start] ^ newer[start], mask, 0);
+      if (start + 1 < pos)
+      {
+        ptr = pack_word(ptr, older[start + 1] ^ newer[start + 1], mask, 4);
+      }
+    }
+  }
+
+  return ptr - out;
+}
+
+/* XORs an encoded delta into data, turning either state into the other */
+static void apply_delta(uint32 *data, const uint8 *in, uint32 size)
+{
+  const uint8 *end = in + size;
+  uint32 skip, count;
+
+  while (in < end)
+  {
+    in = get_varint(in, &skip);
+    in = get_varint(in, &count);
+    data += skip;
+
+    while (count)
+    {
+      uint32 mask = *in++;
+      in = unpack_word(in, data++, mask);
+      if (--count)
+      {
+        in = unpack_word(in, data++, mask >> 4);
+        count--;
+      }
+    }
+  }
+}
+
+static int reserve(uint8 **buffer, uint32 *size, uint32 needed)
+{
+  uint8 *data;
+
+  if (*size >= needed)
+  {
+    return 1;
+  }
+
+  data = (uint8 *)realloc(*buffer, needed);
+  if (!data)
+  {
+    return 0;
+  }
+
+  *buffer = data;
+  *size = needed;
+  return 1;
+}
+
+/* Without keyframes, the newest state and the spare buffer share a size and */
+/* are zero filled past the state they hold. */
+static int reserve_states(snapshot_ring_t *ring, uint32 needed)
+{
+  snapshot_t *newest = &ring->newest;
+  uint8 *data;
+
+  if (newest->data_size >= needed)
+  {
+    return 1;
+  }
+
+  data = (uint8 *)realloc(ring->spare, needed);
+  if (!data)
+  {
+    return 0;
+  }
+  ring->spare = data;
+
+  data = (uint8 *)realloc(newest->data, needed);
+  if (!data)
+  {
+    return 0;
+  }
+  memset(data + newest->data_size, 0, needed - newest->data_size);
+  newest->data = data;
+  newest->data_size = needed;
+  return 1;
+}
+
+/* Stores the encoded delta into the next slot */
+static snapshot_t *push_delta(snapshot_ring_t *ring, uint32 len)
+{
+  snapshot_t *s = &ring->slots[slot_index(ring, ring->count)];
+
+  /* unchanged states give empty deltas */
+  s->data = NULL;
+  if (len)
+  {
+    s->data = malloc(len);
+    if (!s->data)
+    {
+      return NULL;
+    }
+    memcpy(s->data, ring->delta, len);
+  }
+
+  s->data_size = len;
+  s->key = 0;
+  ring->last_size = len;
+  return s;
+}
+
+static void clear_user(snapshot_ring_t *ring, int index)
+{
+  if (ring->user)
+  {
+    memset(ring->user + slot_index(ring, index) * ring->user_size, 0, ring->user_size);
+  }
+}
+
+static int push_backward(snapshot_ring_t *ring, const uint8 *state, int size, uint32 tag)
+{
+  snapshot_t *newest = &ring->newest, *s;
+  uint32 words = ((((uint32)size > newest->size) ? (uint32)size : newest->size) + 3) >> 2;
+  uint32 len;
+  uint8 *swap;
+
+  if (!reserve_states(ring, words << 2) || !reserve(&ring->delta, &ring->delta_size, MAX_DELTA(words)))
+  {
+    return 0;
+  }
+
+  memcpy(ring->spare, state, size);
+  memset(ring->spare + size, 0, newest->data_size - size);
+
+  if (newest->size)
+  {
+    len = encode_delta((const uint32 *)newest->data, (const uint32 *)ring->spare, words, ring->delta);
+
+    if (len > ring->max_bytes)
+    {
+      /* cannot step back past this state */
+      while (ring->count)
+      {
+        drop_oldest_group(ring);
+      }
+    }
+    else
+    {
+      while ((ring->count >= ring->capacity) || (ring->bytes + len > ring->max_bytes))
+      {
+        drop_oldest_group(ring);
+      }
+
+      s = push_delta(ring, len);
+      if (!s)
+      {
+        return 0;
+      }
+
+      s->size = newest->size;
+      s->tag = newest->tag;
+      ring->bytes += len;
+      clear_user(ring, ring->count++);
+    }
+
+    ring->last_size = len;
+  }
+
+  swap = newest->data;
+  newest->data = ring->spare;
+  ring->spare = swap;
+  newest->size = size;
+  newest->tag = tag;
+  return 1;
+}
+
+int snapshot_ring_init(snapshot_ring_t *ring, int capacity, int keyframe_interval, uint32 max_bytes, int user_size)
+{
+  memset(ring, 0, sizeof(snapshot_ring_t));
+
+  ring->slots = calloc(capacity, sizeof(snapshot_t));
+  ring->user = user_size ? calloc(capacity, user_size) : NULL;
+
+  if (!ring->slots || (user_size && !ring->user))
+  {
+    snapshot_ring_free(ring);
+    return 0;
+  }
+
+  ring->capacity = capacity;
+  ring->keyframe_interval = keyframe_interval;
+  ring->max_bytes = max_bytes;
+  ring->user_size = user_size;
+  return 1;
+}
+
+void snapshot_ring_free(snapshot_ring_t *ring)
+{
+  snapshot_ring_clear(ring);
+  free(ring->slots);
+  free(ring->user);
+  free(ring->newest.data);
+  free(ring->spare);
+  free(ring->delta);
+  memset(ring, 0, sizeof(snapshot_ring_t));
+}
+
+void snapshot_ring_clear(snapshot_ring_t *ring)
+{
+  while (ring->count)
+  {
+    drop_oldest_group(ring);
+  }
+
+  ring->first = 0;
+  ring->since_key = 0;
+  ring->last_size = 0;
+  ring->newest.size = 0;
+}
+
+int snapshot_push(snapshot_ring_t *ring, const uint8 *state, int size, uint32 tag)
+{
+  uint32 words = (size + 3) >> 2;
+  snapshot_t *key, *s = NULL;
+  int delta = 0;
+
+  if (!ring->capacity)
+  {
+    return 0;
+  }
+
+  if (!ring->keyframe_interval)
+  {
+    return push_backward(ring, state, size, tag);
+  }
+
+  while (ring->count >= ring->capacity)
+  {
+    drop_oldest_group(ring);
+  }
+
+  key = newest_keyframe(ring);
+
+  if (key && (key->size == (uint32)size) && (ring->since_key + 1 < ring->keyframe_interval) &&
+      reserve(&ring->delta, &ring->delta_size, MAX_DELTA(words)))
+  {
+    uint32 len = encode_delta((const uint32 *)key->data, (const uint32 *)state, words, ring->delta);
+
+    /* a delta not smaller than the state is stored as a keyframe */
+    if (len < (words << 2))
+    {
+      s = push_delta(ring, len);
+      delta = 1;
+    }
+  }
+
+  if (delta)
+  {
+    if (!s)
+    {
+      return 0;
+    }
+    ring->since_key++;
+  }
+  else
+  {
+    s = &ring->slots[slot_index(ring, ring->count)];
+    s->data = malloc(words << 2);
+    if (!s->data)
+    {
+      return 0;
+    }
+    memcpy(s->data, state, size);
+    memset(s->data + size, 0, (words << 2) - size);
+    s->data_size = words << 2;
+    s->key = 1;
+    ring->since_key = 0;
+    ring->keyframes++;
+  }
+
+  s->size = size;
+  s->tag = tag;
+  ring->bytes += s->data_size;
+  clear_user(ring, ring->count++);
+
+  /* keep at least the group being written to */
+  while ((ring->bytes > ring->max_bytes) && (ring->keyframes > 1))
+  {
+    drop_oldest_group(ring);
+  }
+
+  return 1;
+}
+
+/* Without keyframes, state must hold the largest state pushed (rounded up */
+/* to 32-bit words). */
+int snapshot_get(snapshot_ring_t *ring, int index, uint8 *state)
+{
+  const snapshot_t *s, *key;
+  int i = index;
+
+  if ((index < 0) || (index >= ring->count))
+  {
+    return 0;
+  }
+
+  s = &ring->slots[slot_index(ring, index)];
+
+  if (!ring->keyframe_interval)
+  {
+    memcpy(state, ring->newest.data, ring->newest.data_size);
+
+    for (i = ring->count - 1; i >= index; i--)
+    {
+      key = &ring->slots[slot_index(ring, i)];
+      apply_delta((uint32 *)state, key->data, key->data_size);
+    }
+
+    return s->size;
+  }
+
+  do
+  {
+    key = &ring->slots[slot_index(ring, i--)];
+  }
+  while (!key->key);
+
+  memcpy(state, key->data, key->data_size);
+
+  if (s != key)
+  {
+    apply_delta((uint32 *)state, s->data, s->data_size);
+  }
+
+  return s->size;
+}
+
+/* Keyframe rings only, see snapshot_step_back otherwise */
+void snapshot_truncate(snapshot_ring_t *ring, int count)
+{
+  int i;
+
+  while (ring->count > count)
+  {
+    free_slot(ring, slot_index(ring, --ring->count));
+  }
+
+  ring->since_key = 0;
+  for (i = ring->count - 1; (i >= 0) && !ring->slots[slot_index(ring, i)].key; i--)
+  {
+    ring->since_key++;
+  }
+}
+
+uint32 snapshot_tag(snapshot_ring_t *ring, int index)
+{
+  return ring->slots[slot_index(ring, index)].tag;
+}
+
+void *snapshot_user(snapshot_ring_t *ring, int index)
+{
+  return ring->user + slot_index(ring, index) * ring->user_size;
+}
+
+/* Rings without keyframes: the newest state goes back up to count pushes, */
+/* returns the number of pushes undone. */
+int snapshot_step_back(snapshot_ring_t *ring, int count)
+{
+  int steps = 0;
+
+  if (ring->keyframe_interval)
+  {
+    return 0;
+  }
+
+  while ((steps < count) && ring->count)
+  {
+    int slot = slot_index(ring, ring->count - 1);
+    snapshot_t *s = &ring->slots[slot];
+
+    apply_delta((uint32 *)ring->newest.data, s->data, s->data_size);
+    ring->newest.size = s->size;
+    ring->newest.tag = s->tag;
+
+    free_slot(ring, slot);
+    ring->count--;
+    steps++;
+  }
+
+  return steps;
+}
+
+uint8 *snapshot_newest(snapshot_ring_t *ring)
+{
+  return ring->newest.size ? ring->newest.data : NULL;
+}
@@ -0,0 +1,62 @@
+/***************************************************************************************
+ *  Genesis Plus
+ *  Savestate snapshot ring (keyframes + delta encoded states)
+ *
+ ****************************************************************************************/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One savestate image. Keyframes are stored as is, other snapshots as the */
+/* XOR delta with the previous keyframe, or with the next newer state for   */
+/* rings without keyframes. */
+typedef struct
+{
+  uint8 *data;      /* keyframe image or encoded delta */
+  uint32 data_size; /* allocated bytes */
+  uint32 size;      /* decoded state size */
+  uint32 tag;       /* caller defined (frame number, instruction count...) */
+  uint8 key;        /* data holds a full image */
+} snapshot_t;
+
+typedef struct
+{
+  snapshot_t *slots;
+  uint8 *user;          /* user_size bytes per slot */
+  int user_size;
+  int capacity;
+  int first;            /* oldest snapshot slot */
+  int count;
+  int keyframe_interval; /* 0 for backward deltas against the newest state */
+  int since_key;        /* snapshots pushed since the newest keyframe */
+  uint32 max_bytes;     /* oldest keyframe groups are dropped above this */
+  uint32 bytes;         /* allocated image bytes */
+  uint32 keyframes;
+  uint32 last_size;     /* encoded bytes of the newest delta */
+  snapshot_t newest;    /* without keyframes: newest state, not in slots */
+  uint8 *spare;         /* without keyframes: next state, zero padded */
+  uint8 *delta;         /* encoding buffer */
+  uint32 delta_size;
+} snapshot_ring_t;
+
+/* Function prototypes */
+extern int snapshot_ring_init(snapshot_ring_t *ring, int capacity, int keyframe_interval, uint32 max_bytes, int user_size);
+extern void snapshot_ring_free(snapshot_ring_t *ring);
+extern void snapshot_ring_clear(snapshot_ring_t *ring);
+extern int snapshot_push(snapshot_ring_t *ring, const uint8 *state, int size, uint32 tag);
+extern int snapshot_get(snapshot_ring_t *ring, int index, uint8 *state);
+extern void snapshot_truncate(snapshot_ring_t *ring, int count);
+extern uint32 snapshot_tag(snapshot_ring_t *ring, int index);
+extern void *snapshot_user(snapshot_ring_t *ring, int index);
+extern int snapshot_step_back(snapshot_ring_t *ring, int count);
+extern uint8 *snapshot_newest(snapshot_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SNAPSHOT_H_ */
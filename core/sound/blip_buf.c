@@ -215,6 +215,25 @@ void blip_clear( blip_t* m )
 #endif
 }
 
+void blip_copy( blip_t* dst, const blip_t* src )
+{
+#ifdef BLIP_ASSERT
+	assert( dst->size == src->size );
+#endif
+
+	dst->factor = src->factor;
+	dst->offset = src->offset;
+#ifdef BLIP_MONO
+	dst->integrator = src->integrator;
+	memcpy( SAMPLES( dst ), SAMPLES( src ), (src->size + buf_extra) * sizeof (buf_t) );
+#else
+	dst->integrator[0] = src->integrator[0];
+	dst->integrator[1] = src->integrator[1];
+	memcpy( dst->buffer[0], src->buffer[0], (src->size + buf_extra) * sizeof (buf_t) );
+	memcpy( dst->buffer[1], src->buffer[1], (src->size + buf_extra) * sizeof (buf_t) );
+#endif
+}
+
 int blip_clocks_needed( const blip_t* m, int samples )
 {
 	fixed_t needed;
@@ -28,6 +28,10 @@ blip_max_ratio = 1 << 20 };
 /** Clears entire buffer. Afterwards, blip_samples_avail() == 0. */
 void blip_clear( blip_t* );
 
+/** Copies rates, buffered samples and pending deltas of src to dst, which must
+have been created with the same sample_count. */
+void blip_copy( blip_t* dst, const blip_t* src );
+
 #ifndef BLIP_MONO
 
 /** Adds positive/negative deltas into stereo buffers at specified clock time. */
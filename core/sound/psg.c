@@ -74,7 +74,7 @@ static const uint16 chanVolume[16] = {
   0                             /*  OFF  */
 };
 
-static struct
+static MACHINE_LOCAL struct
 {
   int clocks;
   int latch;
@@ -45,39 +45,39 @@
 
 /* FM output buffer (large enough to hold a whole frame at original chips rate) */
 #if defined(HAVE_YM3438_CORE) || defined(HAVE_OPLL_CORE)
-static int fm_buffer[1080 * 2 * 24];
+static MACHINE_LOCAL int fm_buffer[1080 * 2 * 24];
 #else
-static int fm_buffer[1080 * 2];
+static MACHINE_LOCAL int fm_buffer[1080 * 2];
 #endif
 
-static int fm_last[2];
-static int *fm_ptr;
+static MACHINE_LOCAL int fm_last[2];
+static MACHINE_LOCAL int *fm_ptr;
 
 /* Cycle-accurate FM samples */
-static int fm_cycles_ratio;
-static int fm_cycles_start;
-static int fm_cycles_count;
-static int fm_cycles_busy;
+static MACHINE_LOCAL int fm_cycles_ratio;
+static MACHINE_LOCAL int fm_cycles_start;
+static MACHINE_LOCAL int fm_cycles_count;
+static MACHINE_LOCAL int fm_cycles_busy;
 
 /* YM chip function pointers */
-static void (*YM_Update)(int *buffer, int length);
-void (*fm_reset)(unsigned int cycles);
-void (*fm_write)(unsigned int cycles, unsigned int address, unsigned int data);
-unsigned int (*fm_read)(unsigned int cycles, unsigned int address);
+static MACHINE_LOCAL void (*YM_Update)(int *buffer, int length);
+MACHINE_LOCAL void (*fm_reset)(unsigned int cycles);
+MACHINE_LOCAL void (*fm_write)(unsigned int cycles, unsigned int address, unsigned int data);
+MACHINE_LOCAL unsigned int (*fm_read)(unsigned int cycles, unsigned int address);
 
 #ifdef HAVE_YM3438_CORE
-static ym3438_t ym3438;
-static short ym3438_accm[24][2];
-static int ym3438_sample[2];
-static int ym3438_cycles;
+static MACHINE_LOCAL ym3438_t ym3438;
+static MACHINE_LOCAL short ym3438_accm[24][2];
+static MACHINE_LOCAL int ym3438_sample[2];
+static MACHINE_LOCAL int ym3438_cycles;
 #endif
 
 #ifdef HAVE_OPLL_CORE
-static opll_t opll;
-static int opll_accm[18][2];
-static int opll_sample;
-static int opll_cycles;
-static int opll_status;
+static MACHINE_LOCAL opll_t opll;
+static MACHINE_LOCAL int opll_accm[18][2];
+static MACHINE_LOCAL int opll_sample;
+static MACHINE_LOCAL int opll_cycles;
+static MACHINE_LOCAL int opll_status;
 #endif
 
 /* Run FM chip until required M-cycles */
@@ -462,6 +462,24 @@ int sound_update(unsigned int cycles)
   return blip_samples_avail(snd.blips[0]);
 }
 
+/* FM output level is not saved in states: when hidden frames are rolled back */
+/* (see audio_set_hidden), it is restored along with the output Blip Buffer.  */
+void sound_set_hidden(int hidden)
+{
+  static MACHINE_LOCAL int level[2];
+
+  if (hidden)
+  {
+    level[0] = fm_last[0];
+    level[1] = fm_last[1];
+  }
+  else
+  {
+    fm_last[0] = level[0];
+    fm_last[1] = level[1];
+  }
+}
+
 int sound_context_save(uint8 *state)
 {
   int bufferptr = 0;
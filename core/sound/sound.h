@@ -50,9 +50,10 @@ extern void sound_reset(void);
 extern int sound_context_save(uint8 *state);
 extern int sound_context_load(uint8 *state);
 extern int sound_update(unsigned int cycles);
-extern void (*fm_reset)(unsigned int cycles);
-extern void (*fm_write)(unsigned int cycles, unsigned int address, unsigned int data);
-extern unsigned int (*fm_read)(unsigned int cycles, unsigned int address);
+extern void sound_set_hidden(int hidden);
+extern MACHINE_LOCAL void (*fm_reset)(unsigned int cycles);
+extern MACHINE_LOCAL void (*fm_write)(unsigned int cycles, unsigned int address, unsigned int data);
+extern MACHINE_LOCAL unsigned int (*fm_read)(unsigned int cycles, unsigned int address);
 
 #ifdef __cplusplus
 }
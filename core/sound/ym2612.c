@@ -622,16 +622,16 @@ typedef struct
 } YM2612;
 
 /* emulated chip */
-static YM2612 ym2612;
+static MACHINE_LOCAL YM2612 ym2612;
 
 /* current chip state */
-static INT32  m2,c1,c2;   /* Phase Modulation input for operators 2,3,4 */
-static INT32  mem;        /* one sample delay memory */
-static INT32  out_fm[6];  /* outputs of working channels */
+static MACHINE_LOCAL INT32  m2,c1,c2;   /* Phase Modulation input for operators 2,3,4 */
+static MACHINE_LOCAL INT32  mem;        /* one sample delay memory */
+static MACHINE_LOCAL INT32  out_fm[6];  /* outputs of working channels */
 
 /* chip type */
-static UINT32 op_mask[8][4];  /* operator output bitmasking (DAC quantization) */
-static int chip_type = YM2612_DISCRETE;
+static MACHINE_LOCAL UINT32 op_mask[8][4];  /* operator output bitmasking (DAC quantization) */
+static MACHINE_LOCAL int chip_type = YM2612_DISCRETE;
 
 
 INLINE void FM_KEYON(FM_CH *CH , int s )
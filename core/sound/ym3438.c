@@ -44,6 +44,7 @@
  */
 
 #include <string.h>
+#include "types.h"
 #include "ym3438.h"
 
 enum {
@@ -233,7 +234,7 @@ static const Bit32u fm_algorithm[4][6][8] = {
     }
 };
 
-static Bit32u chip_type = ym3438_mode_readmode;
+static MACHINE_LOCAL Bit32u chip_type = ym3438_mode_readmode;
 
 void OPN2_DoIO(ym3438_t *chip)
 {
@@ -38,7 +38,7 @@
 
 #include "shared.h"
 
-int state_load(unsigned char *state)
+static int load_state(unsigned char *state, int hot)
 {
   int i, bufferptr = 0;
 
@@ -58,7 +58,14 @@ int state_load(unsigned char *state)
   }
 
   /* reset system */
-  system_reset();
+  if (hot)
+  {
+    system_reset_hot();
+  }
+  else
+  {
+    system_reset();
+  }
 
   /* enable VDP access for TMSS systems */
   for (i=0xc0; i<0xe0; i+=8)
@@ -190,6 +197,19 @@ int state_load(unsigned char *state)
   return bufferptr;
 }
 
+int state_load(unsigned char *state)
+{
+  return load_state(state, 0);
+}
+
+/* Savestates of the running game (same ROM and configuration) are loaded   */
+/* without clearing the display and pattern cache: only patterns modified   */
+/* by the savestate are updated on next rendered line.                     */
+int state_load_hot(unsigned char *state)
+{
+  return load_state(state, 1);
+}
+
 int state_save(unsigned char *state)
 {
   /* buffer size */
@@ -203,14 +223,14 @@ int state_save(unsigned char *state)
   /* GENESIS */
   if ((system_hw & SYSTEM_PBC) == SYSTEM_MD)
   {
-    save_param(work_ram, sizeof(work_ram));
-    save_param(zram, sizeof(zram));
+    save_pages(work_ram, sizeof(work_ram), work_ram_dirty);
+    save_pages(zram, sizeof(zram), zram_dirty);
     save_param(&zstate, sizeof(zstate));
     save_param(&zbank, sizeof(zbank));
   }
   else
   {
-    save_param(work_ram, 0x2000);
+    save_pages(work_ram, 0x2000, work_ram_dirty);
   }
 
   /* IO */
@@ -54,8 +54,13 @@ extern "C" {
   memcpy(&state[bufferptr], param, size); \
   bufferptr+= size;
 
+/* memories saved by pages in checkpoints (see checkpoint.c) */
+#define save_pages(param, size, dirty) \
+  bufferptr+= state_save_pages(&state[bufferptr], param, size, dirty);
+
 /* Function prototypes */
 extern int state_load(unsigned char *state);
+extern int state_load_hot(unsigned char *state);
 extern int state_save(unsigned char *state);
 
 #ifdef __cplusplus
@@ -43,18 +43,18 @@
 #include "eq.h"
 
 /* Global variables */
-t_config config;
-t_bitmap bitmap;
-t_snd snd;
-uint32 mcycles_vdp;
-uint8 system_hw;
-uint8 system_bios;
-uint32 system_clock;
-int16 SVP_cycles = 800; 
-
-static uint8 pause_b;
-static EQSTATE eq[2];
-static int16 llp,rrp;
+MACHINE_LOCAL t_config config;
+MACHINE_LOCAL t_bitmap bitmap;
+MACHINE_LOCAL t_snd snd;
+MACHINE_LOCAL uint32 mcycles_vdp;
+MACHINE_LOCAL uint8 system_hw;
+MACHINE_LOCAL uint8 system_bios;
+MACHINE_LOCAL uint32 system_clock;
+MACHINE_LOCAL int16 SVP_cycles = 800; 
+
+static MACHINE_LOCAL uint8 pause_b;
+static MACHINE_LOCAL EQSTATE eq[2];
+static MACHINE_LOCAL int16 llp,rrp;
 
 /******************************************************************************************/
 /* Audio subsystem                                                                        */
@@ -70,8 +70,10 @@ int audio_init(int samplerate, double framerate)
 
   /* Initialize Blip Buffers */
   snd.blips[0] = blip_new(samplerate / 10);
-  if (!snd.blips[0])
+  snd.spares[0] = blip_new(samplerate / 10);
+  if (!snd.blips[0] || !snd.spares[0])
   {
+    audio_shutdown();
     return -1;
   }
 
@@ -81,7 +83,9 @@ int audio_init(int samplerate, double framerate)
     /* allocate blip buffers */
     snd.blips[1] = blip_new(samplerate / 10);
     snd.blips[2] = blip_new(samplerate / 10);
-    if (!snd.blips[1] || !snd.blips[2])
+    snd.spares[1] = blip_new(samplerate / 10);
+    snd.spares[2] = blip_new(samplerate / 10);
+    if (!snd.blips[1] || !snd.blips[2] || !snd.spares[1] || !snd.spares[2])
     {
       audio_shutdown();
       return -1;
@@ -162,6 +166,12 @@ void audio_reset(void)
     }
   }
 
+  /* output filters are not affected by hidden frames */
+  if (snd.hidden)
+  {
+    return;
+  }
+
   /* Low-Pass filter */
   llp = 0;
   rrp = 0;
@@ -179,15 +189,70 @@ void audio_set_equalizer(void)
   eq[0].hg = eq[1].hg = (double)(config.hg) / 100.0;
 }
 
+/* Frames emulated then rolled back (run-ahead) are hidden: sound chips still */
+/* run to the end of each frame but their output goes to spare Blip Buffers  */
+/* which are dropped, so that the audio stream and filters are left as they  */
+/* were when output is restored. */
+void audio_set_hidden(int hidden)
+{
+  static MACHINE_LOCAL int16 cdda[2];
+  int i;
+
+  if (snd.hidden == hidden)
+  {
+    return;
+  }
+
+  /* output levels which are not saved in states */
+  sound_set_hidden(hidden);
+  if (system_hw == SYSTEM_MCD)
+  {
+    if (hidden)
+    {
+      cdda[0] = cdd.audio[0];
+      cdda[1] = cdd.audio[1];
+    }
+    else
+    {
+      cdd.audio[0] = cdda[0];
+      cdd.audio[1] = cdda[1];
+    }
+  }
+
+  for (i=0; i<3; i++)
+  {
+    if (snd.blips[i])
+    {
+      blip_t *blip = snd.blips[i];
+
+      /* spare buffers start with the current rates */
+      if (hidden)
+      {
+        blip_copy(snd.spares[i], blip);
+      }
+
+      snd.blips[i] = snd.spares[i];
+      snd.spares[i] = blip;
+    }
+  }
+
+  snd.hidden = hidden;
+}
+
 void audio_shutdown(void)
 {
   int i;
   
+  /* Restore output Blip Buffers */
+  audio_set_hidden(0);
+
   /* Delete blip buffers */
   for (i=0; i<3; i++)
   {
     blip_delete(snd.blips[i]);
+    blip_delete(snd.spares[i]);
     snd.blips[i] = 0;
+    snd.spares[i] = 0;
   }
 }
 
@@ -204,22 +269,34 @@ int audio_update(int16 *buffer)
 
     /* read CDDA samples */
     cdd_read_audio(size);
+  }
+
+  /* hidden frames samples are dropped */
+  if (snd.hidden)
+  {
+    int i;
+    for (i=0; i<3; i++)
+    {
+      if (snd.blips[i])
+      {
+        blip_clear(snd.blips[i]);
+      }
+    }
+    return 0;
+  }
 
 #ifdef ALIGN_SND
-    /* return an aligned number of samples if required */
-    size &= ALIGN_SND;
+  /* return an aligned number of samples if required */
+  size &= ALIGN_SND;
 #endif
 
+  if (system_hw == SYSTEM_MCD)
+  {
     /* resample & mix FM/PSG, PCM & CD-DA streams to output buffer */
     blip_mix_samples(snd.blips[0], snd.blips[1], snd.blips[2], buffer, size);
   }
   else
   {
-#ifdef ALIGN_SND
-    /* return an aligned number of samples if required */
-    size &= ALIGN_SND;
-#endif
-
     /* resample FM/PSG mixed stream to output buffer */
     blip_read_samples(snd.blips[0], buffer, size);
   }
@@ -320,10 +397,23 @@ void system_reset(void)
 {
   gen_reset(1);
   io_reset();
-  render_reset();
-  vdp_reset();
+  render_reset(0);
+  vdp_reset(0);
   sound_reset();
   audio_reset();
+  checkpoint_dirty_all();
+}
+
+/* same as system_reset, before a savestate of the running game is loaded */
+void system_reset_hot(void)
+{
+  gen_reset(1);
+  io_reset();
+  render_reset(1);
+  vdp_reset(1);
+  sound_reset();
+  audio_reset();
+  checkpoint_dirty_all();
 }
 
 void system_frame_gen(int do_skip)
@@ -609,6 +699,10 @@ void system_frame_gen(int do_skip)
     {
       render_line(line);
     }
+    else
+    {
+      skip_line(line);
+    }
 
     /* update 6-Buttons & Lightguns */
     input_refresh();
@@ -651,6 +745,11 @@ void system_frame_gen(int do_skip)
   }
   while (++line < bitmap.viewport.h);
 
+#ifdef USE_RENDER_THREAD
+  /* wait for frame lines to be drawn */
+  render_thread_end_frame();
+#endif
+
   /* check viewport changes */
   if (bitmap.viewport.w != bitmap.viewport.ow)
   {
@@ -936,6 +1035,10 @@ void system_frame_scd(int do_skip)
     {
       render_line(line);
     }
+    else
+    {
+      skip_line(line);
+    }
     
     /* update 6-Buttons & Lightguns */
     input_refresh();
@@ -974,6 +1077,11 @@ void system_frame_scd(int do_skip)
   }
   while (++line < bitmap.viewport.h);
 
+#ifdef USE_RENDER_THREAD
+  /* wait for frame lines to be drawn */
+  render_thread_end_frame();
+#endif
+
   /* check viewport changes */
   if (bitmap.viewport.w != bitmap.viewport.ow)
   {
@@ -1338,6 +1446,10 @@ void system_frame_sms(int do_skip)
       {
         render_line(line);
       }
+      else
+      {
+        skip_line(line);
+      }
     }
 
     /* update 6-Buttons & Lightguns */
@@ -1380,6 +1492,11 @@ void system_frame_sms(int do_skip)
   }
   while (++line < bitmap.viewport.h);
 
+#ifdef USE_RENDER_THREAD
+  /* wait for frame lines to be drawn */
+  render_thread_end_frame();
+#endif
+
   /* check viewport changes */
   if (bitmap.viewport.w != bitmap.viewport.ow)
   {
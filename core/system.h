@@ -78,6 +78,7 @@ typedef struct
   int width;        /* Bitmap width */
   int height;       /* Bitmap height */
   int pitch;        /* Bitmap pitch */
+  int bpp;          /* 32= XRGB8888 pixels (15 or 16-bit pixels rendering only), 0= compile-time pixel format */
   struct
   {
     int x;          /* X offset of viewport within bitmap */
@@ -96,17 +97,19 @@ typedef struct
   double frame_rate;    /* Output Frame rate (usually 50 or 60 frames per second) */
   int enabled;          /* 1= sound emulation is enabled */
   blip_t* blips[3];     /* Blip Buffer resampling (stereo) */
+  blip_t* spares[3];    /* Blip Buffers swapped in while output is hidden */
+  int hidden;           /* 1= output of emulated frames is dropped */
 } t_snd;
 
 
 /* Global variables */
-extern t_bitmap bitmap;
-extern t_snd snd;
-extern uint32 mcycles_vdp;
-extern int16 SVP_cycles; 
-extern uint8 system_hw;
-extern uint8 system_bios;
-extern uint32 system_clock;
+extern MACHINE_LOCAL t_bitmap bitmap;
+extern MACHINE_LOCAL t_snd snd;
+extern MACHINE_LOCAL uint32 mcycles_vdp;
+extern MACHINE_LOCAL int16 SVP_cycles; 
+extern MACHINE_LOCAL uint8 system_hw;
+extern MACHINE_LOCAL uint8 system_bios;
+extern MACHINE_LOCAL uint32 system_clock;
 
 /* Function prototypes */
 extern int audio_init(int samplerate, double framerate);
@@ -115,8 +118,10 @@ extern void audio_reset(void);
 extern void audio_shutdown(void);
 extern int audio_update(int16 *buffer);
 extern void audio_set_equalizer(void);
+extern void audio_set_hidden(int hidden);
 extern void system_init(void);
 extern void system_reset(void);
+extern void system_reset_hot(void);
 extern void system_frame_gen(int do_skip);
 extern void system_frame_scd(int do_skip);
 extern void system_frame_sms(int do_skip);
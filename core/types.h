@@ -20,6 +20,22 @@ extern "C" {
 #define int16 signed short
 #define int32 signed int
 
+/* Emulated machine state is thread local when MULTI_INSTANCE is defined, so */
+/* that each thread runs its own instance. Cartridge & CD hardware are then  */
+/* allocated on load_rom, read-only tables remain shared.                   */
+#ifdef MULTI_INSTANCE
+#ifndef USE_DYNAMIC_ALLOC
+#define USE_DYNAMIC_ALLOC
+#endif
+#if defined(_MSC_VER)
+#define MACHINE_LOCAL __declspec(thread)
+#else
+#define MACHINE_LOCAL __thread
+#endif
+#else
+#define MACHINE_LOCAL
+#endif
+
 typedef union
 {
     uint16 w;
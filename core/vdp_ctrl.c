@@ -43,6 +43,22 @@
 #include "hvc.h"
 
 #include "debug.h"
+
+/* Mark a 32-byte VRAM block as modified (copied to render thread, see vdp_render.c) */
+#ifdef USE_RENDER_THREAD
+#define MARK_VRAM_BLOCK(addr)                       \
+{                                                   \
+  int block = (addr >> 5) & 0x7FF;                  \
+  if (vram_block_dirty[block] == 0)                 \
+  {                                                 \
+    vram_block_dirty[block] = 1;                    \
+    vram_block_list[vram_block_index++] = block;    \
+  }                                                 \
+}
+#else
+#define MARK_VRAM_BLOCK(addr)
+#endif
+
 /* Mark a pattern as modified */
 #define MARK_BG_DIRTY(addr)                         \
 {                                                   \
@@ -52,52 +68,60 @@
     bg_name_list[bg_list_index++] = name;           \
   }                                                 \
   bg_name_dirty[name] |= (1 << ((addr >> 2) & 7));  \
+  MARK_VRAM_BLOCK(addr);                            \
+  MARK_PAGE_DIRTY(vram_dirty, addr);                \
 }
 
 /* VDP context */
-uint8 ALIGNED_(4) sat[0x400];    /* Internal copy of sprite attribute table */
-uint8 ALIGNED_(4) vram[0x10000]; /* Video RAM (64K x 8-bit) */
-uint8 ALIGNED_(4) cram[0x80];    /* On-chip color RAM (64 x 9-bit) */
-uint8 ALIGNED_(4) vsram[0x80];   /* On-chip vertical scroll RAM (40 x 11-bit) */
-uint8 reg[0x20];                 /* Internal VDP registers (23 x 8-bit) */
-uint8 hint_pending;              /* 0= Line interrupt is pending */
-uint8 vint_pending;              /* 1= Frame interrupt is pending */
-uint16 status;                   /* VDP status flags */
-uint32 dma_length;               /* DMA remaining length */
+MACHINE_LOCAL uint8 ALIGNED_(4) sat[0x400];    /* Internal copy of sprite attribute table */
+MACHINE_LOCAL uint8 ALIGNED_(4) vram[0x10000]; /* Video RAM (64K x 8-bit) */
+MACHINE_LOCAL uint8 ALIGNED_(4) cram[0x80];    /* On-chip color RAM (64 x 9-bit) */
+MACHINE_LOCAL uint8 ALIGNED_(4) vsram[0x80];   /* On-chip vertical scroll RAM (40 x 11-bit) */
+MACHINE_LOCAL uint8 reg[0x20];                 /* Internal VDP registers (23 x 8-bit) */
+MACHINE_LOCAL uint8 hint_pending;              /* 0= Line interrupt is pending */
+MACHINE_LOCAL uint8 vint_pending;              /* 1= Frame interrupt is pending */
+MACHINE_LOCAL uint16 status;                   /* VDP status flags */
+MACHINE_LOCAL uint32 dma_length;               /* DMA remaining length */
 
 /* Global variables */
-uint16 ntab;                      /* Name table A base address */
-uint16 ntbb;                      /* Name table B base address */
-uint16 ntwb;                      /* Name table W base address */
-uint16 satb;                      /* Sprite attribute table base address */
-uint16 hscb;                      /* Horizontal scroll table base address */
-uint8 bg_name_dirty[0x800];       /* 1= This pattern is dirty */
-uint16 bg_name_list[0x800];       /* List of modified pattern indices */
-uint16 bg_list_index;             /* # of modified patterns in list */
-uint8 hscroll_mask;               /* Horizontal Scrolling line mask */
-uint8 playfield_shift;            /* Width of planes A, B (in bits) */
-uint8 playfield_col_mask;         /* Playfield column mask */
-uint16 playfield_row_mask;        /* Playfield row mask */
-uint16 vscroll;                   /* Latched vertical scroll value */
-uint8 odd_frame;                  /* 1: odd field, 0: even field */
-uint8 im2_flag;                   /* 1= Interlace mode 2 is being used */
-uint8 interlaced;                 /* 1: Interlaced mode 1 or 2 */
-uint8 vdp_pal;                    /* 1: PAL , 0: NTSC (default) */
-uint8 h_counter;                  /* Horizontal counter */
-uint16 v_counter;                 /* Vertical counter */
-uint16 vc_max;                    /* Vertical counter overflow value */
-uint16 lines_per_frame;           /* PAL: 313 lines, NTSC: 262 lines */
-uint16 max_sprite_pixels;         /* Max. sprites pixels per line (parsing & rendering) */
-int32 fifo_write_cnt;             /* VDP FIFO write count */
-uint32 fifo_slots;                /* VDP FIFO access slot count */
-uint32 hvc_latch;                 /* latched HV counter */
-const uint8 *hctab;               /* pointer to H Counter table */
+MACHINE_LOCAL uint16 ntab;                      /* Name table A base address */
+MACHINE_LOCAL uint16 ntbb;                      /* Name table B base address */
+MACHINE_LOCAL uint16 ntwb;                      /* Name table W base address */
+MACHINE_LOCAL uint16 satb;                      /* Sprite attribute table base address */
+MACHINE_LOCAL uint16 hscb;                      /* Horizontal scroll table base address */
+MACHINE_LOCAL uint8 bg_name_dirty[0x800];       /* 1= This pattern is dirty */
+MACHINE_LOCAL uint16 bg_name_list[0x800];       /* List of modified pattern indices */
+MACHINE_LOCAL uint16 bg_list_index;             /* # of modified patterns in list */
+MACHINE_LOCAL uint8 sat_dirty;                  /* 1= Internal SAT modified since last sprite index update */
+#ifdef USE_RENDER_THREAD
+MACHINE_LOCAL uint8 vram_block_dirty[0x800];    /* 1= This VRAM block is modified */
+MACHINE_LOCAL uint16 vram_block_list[0x800];    /* List of modified VRAM blocks */
+MACHINE_LOCAL uint16 vram_block_index;          /* # of modified VRAM blocks in list */
+#endif
+MACHINE_LOCAL uint8 hscroll_mask;               /* Horizontal Scrolling line mask */
+MACHINE_LOCAL uint8 playfield_shift;            /* Width of planes A, B (in bits) */
+MACHINE_LOCAL uint8 playfield_col_mask;         /* Playfield column mask */
+MACHINE_LOCAL uint16 playfield_row_mask;        /* Playfield row mask */
+MACHINE_LOCAL uint16 vscroll;                   /* Latched vertical scroll value */
+MACHINE_LOCAL uint8 odd_frame;                  /* 1: odd field, 0: even field */
+MACHINE_LOCAL uint8 im2_flag;                   /* 1= Interlace mode 2 is being used */
+MACHINE_LOCAL uint8 interlaced;                 /* 1: Interlaced mode 1 or 2 */
+MACHINE_LOCAL uint8 vdp_pal;                    /* 1: PAL , 0: NTSC (default) */
+MACHINE_LOCAL uint8 h_counter;                  /* Horizontal counter */
+MACHINE_LOCAL uint16 v_counter;                 /* Vertical counter */
+MACHINE_LOCAL uint16 vc_max;                    /* Vertical counter overflow value */
+MACHINE_LOCAL uint16 lines_per_frame;           /* PAL: 313 lines, NTSC: 262 lines */
+MACHINE_LOCAL uint16 max_sprite_pixels;         /* Max. sprites pixels per line (parsing & rendering) */
+MACHINE_LOCAL int32 fifo_write_cnt;             /* VDP FIFO write count */
+MACHINE_LOCAL uint32 fifo_slots;                /* VDP FIFO access slot count */
+MACHINE_LOCAL uint32 hvc_latch;                 /* latched HV counter */
+MACHINE_LOCAL const uint8 *hctab;               /* pointer to H Counter table */
 
 /* Function pointers */
-void (*vdp_68k_data_w)(unsigned int data);
-void (*vdp_z80_data_w)(unsigned int data);
-unsigned int (*vdp_68k_data_r)(void);
-unsigned int (*vdp_z80_data_r)(void);
+MACHINE_LOCAL void (*vdp_68k_data_w)(unsigned int data);
+MACHINE_LOCAL void (*vdp_z80_data_w)(unsigned int data);
+MACHINE_LOCAL unsigned int (*vdp_68k_data_r)(void);
+MACHINE_LOCAL unsigned int (*vdp_z80_data_r)(void);
 
 /* Function prototypes */
 static void vdp_68k_data_w_m4(unsigned int data);
@@ -126,27 +150,28 @@ static const uint8 shift_table[]        = { 6, 7, 0, 8 };
 static const uint8 col_mask_table[]     = { 0x0F, 0x1F, 0x0F, 0x3F };
 static const uint16 row_mask_table[]    = { 0x0FF, 0x1FF, 0x2FF, 0x3FF };
 
-static uint8 border;          /* Border color index */
-static uint8 pending;         /* Pending write flag */
-static uint8 code;            /* Code register */
-static uint8 dma_type;        /* DMA mode */
-static uint16 addr;           /* Address register */
-static uint16 addr_latch;     /* Latched A15, A14 of address */
-static uint16 sat_base_mask;  /* Base bits of SAT */
-static uint16 sat_addr_mask;  /* Index bits of SAT */
-static uint16 dma_src;        /* DMA source address */
-static uint32 dma_endCycles;  /* 68k cycles to DMA end */
-static int dmafill;           /* DMA Fill pending flag */
-static int cached_write;      /* 2nd part of 32-bit CTRL port write (Genesis mode) or LSB of CRAM data (Game Gear mode) */
-static uint16 fifo[4];        /* FIFO ring-buffer */
-static int fifo_idx;          /* FIFO write index */
-static int fifo_byte_access;  /* FIFO byte access flag */
-static uint32 fifo_cycles;    /* FIFO next access cycle */
-static int *fifo_timing;      /* FIFO slots timing table */
+static MACHINE_LOCAL uint8 border;          /* Border color index */
+static MACHINE_LOCAL uint8 pending;         /* Pending write flag */
+static MACHINE_LOCAL uint8 code;            /* Code register */
+static MACHINE_LOCAL uint8 dma_type;        /* DMA mode */
+static MACHINE_LOCAL uint16 addr;           /* Address register */
+static MACHINE_LOCAL uint16 addr_latch;     /* Latched A15, A14 of address */
+static MACHINE_LOCAL uint16 sat_base_mask;  /* Base bits of SAT */
+static MACHINE_LOCAL uint16 sat_addr_mask;  /* Index bits of SAT */
+static MACHINE_LOCAL uint16 dma_src;        /* DMA source address */
+static MACHINE_LOCAL uint32 dma_endCycles;  /* 68k cycles to DMA end */
+static MACHINE_LOCAL int dmafill;           /* DMA Fill pending flag */
+static MACHINE_LOCAL int cached_write;      /* 2nd part of 32-bit CTRL port write (Genesis mode) or LSB of CRAM data (Game Gear mode) */
+static MACHINE_LOCAL uint16 fifo[4];        /* FIFO ring-buffer */
+static MACHINE_LOCAL int fifo_idx;          /* FIFO write index */
+static MACHINE_LOCAL int fifo_byte_access;  /* FIFO byte access flag */
+static MACHINE_LOCAL uint32 fifo_cycles;    /* FIFO next access cycle */
+static MACHINE_LOCAL int *fifo_timing;      /* FIFO slots timing table */
+static MACHINE_LOCAL int cache_kept;        /* Pattern cache kept for a hot savestate load */
 
  /* set Z80 or 68k interrupt lines */
-static void (*set_irq_line)(unsigned int level);
-static void (*set_irq_line_delay)(unsigned int level);
+static MACHINE_LOCAL void (*set_irq_line)(unsigned int level);
+static MACHINE_LOCAL void (*set_irq_line_delay)(unsigned int level);
 
 /* Vertical counter overflow values (see hvc.h) */
 static const uint16 vc_table[4][2] = 
@@ -235,6 +260,87 @@ int vdp_dma_calc_src()
     return dma_func_src[reg[23] >> 4]();
 }
 
+/* Debugger writes: bypass the FIFO and the address register but keep the  */
+/* pattern cache, internal SAT and palette consistent with VDP memory.     */
+void vdp_debug_vram_w(unsigned int addr, unsigned int data)
+{
+  addr &= 0xFFFF;
+
+  /* Intercept writes to Sprite Attribute Table */
+  if ((addr & sat_base_mask) == satb)
+  {
+    WRITE_BYTE(sat, addr & sat_addr_mask, data);
+    sat_dirty = 1;
+  }
+
+  if (data != READ_BYTE(vram, addr))
+  {
+    int name;
+
+    WRITE_BYTE(vram, addr, data);
+
+    /* Update pattern cache */
+    MARK_BG_DIRTY (addr);
+  }
+}
+
+void vdp_debug_cram_w(unsigned int addr, unsigned int data)
+{
+  /* Pointer to CRAM word */
+  uint16 *p = (uint16 *)&cram[addr & 0x7E];
+  int index = (addr >> 1) & 0x3F;
+
+  if ((system_hw & SYSTEM_MD) && (reg[1] & 0x04))
+  {
+    /* Mode 5: pack 16-bit bus data (BBB0GGG0RRR0) to 9-bit CRAM data (BBBGGGRRR) */
+    data = ((data & 0xE00) >> 3) | ((data & 0x0E0) >> 2) | ((data & 0x00E) >> 1);
+
+    if (data != *p)
+    {
+      *p = data;
+
+      if (index & 0x0F)
+      {
+        color_update_m5(index, data);
+      }
+      if (index == border)
+      {
+        color_update_m5(0x00, data);
+      }
+    }
+  }
+  else if (index < 0x20)
+  {
+    /* Modes 0,1,2,3,4: CRAM words are stored as written by the VDP port */
+    if (system_hw == SYSTEM_GG)
+    {
+      /* 12-bit CRAM data (BBBBGGGGRRRR), upper bits are kept like the data port does */
+      data &= 0xFFFF;
+    }
+    else if (system_hw & SYSTEM_MD)
+    {
+      /* 9-bit CRAM data (xxxBBGGRR) */
+      data &= 0x1FF;
+    }
+    else
+    {
+      /* 6-bit CRAM data (BBGGRR) */
+      data &= 0x3F;
+    }
+
+    if (data != *p)
+    {
+      *p = data;
+
+      color_update_m4(index, data);
+      if (index == (0x10 | (border & 0x0F)))
+      {
+        color_update_m4(0x40, data);
+      }
+    }
+  }
+}
+
 /* BG rendering functions */
 static void (*const render_bg_modes[16])(int line) =
 {
@@ -280,12 +386,28 @@ void vdp_init(void)
   }
 }
 
-void vdp_reset(void)
+void vdp_reset(int hot)
 {
   int i;
 
+  /* when a savestate of the running game is about to be loaded, Mode 5 pattern */
+  /* cache is brought up to date with VRAM and kept, so that only patterns      */
+  /* modified by the savestate need to be updated (see vdp_context_load)        */
+  cache_kept = hot && (system_hw & SYSTEM_MD) && (reg[1] & 0x04);
+  if (cache_kept)
+  {
+    if (bg_list_index)
+    {
+      update_bg_pattern_cache(bg_list_index);
+    }
+  }
+  else
+  {
+    memset ((char *) vram, 0, sizeof (vram));
+  }
+
   memset ((char *) sat, 0, sizeof (sat));
-  memset ((char *) vram, 0, sizeof (vram));
+  sat_dirty = 1;
   memset ((char *) cram, 0, sizeof (cram));
   memset ((char *) vsram, 0, sizeof (vsram));
   memset ((char *) reg, 0, sizeof (reg));
@@ -482,7 +604,7 @@ int vdp_context_save(uint8 *state)
   int bufferptr = 0;
 
   save_param(sat, sizeof(sat));
-  save_param(vram, sizeof(vram));
+  save_pages(vram, sizeof(vram), vram_dirty);
   save_param(cram, sizeof(cram));
   save_param(vsram, sizeof(vsram));
   save_param(reg, sizeof(reg));
@@ -508,8 +630,24 @@ int vdp_context_load(uint8 *state)
 {
   int i, bufferptr = 0;
   uint8 temp_reg[0x20];
+  uint16 changed[0x800];
+  int changed_count = 0;
 
   load_param(sat, sizeof(sat));
+  sat_dirty = 1;
+
+  if (cache_kept)
+  {
+    /* patterns modified by the savestate */
+    for (i=0;i<0x800;i++)
+    {
+      if (memcmp(&vram[i << 5], &state[bufferptr + (i << 5)], 32))
+      {
+        changed[changed_count++] = i;
+      }
+    }
+  }
+
   load_param(vram, sizeof(vram));
   load_param(cram, sizeof(cram));
   load_param(vsram, sizeof(vsram));
@@ -597,13 +735,28 @@ int vdp_context_load(uint8 *state)
     color_update_m4(0x40, *(uint16 *)&cram[(0x10 | (border & 0x0F)) << 1]);
   }
 
-  /* invalidate tile cache */
-  for (i=0;i<bg_list_index;i++) 
+  if (cache_kept && (reg[1] & 0x04))
+  {
+    /* only invalidate modified patterns */
+    memset(bg_name_dirty, 0, sizeof(bg_name_dirty));
+    for (i=0;i<changed_count;i++)
+    {
+      bg_name_list[i]=changed[i];
+      bg_name_dirty[changed[i]]=0xFF;
+    }
+    bg_list_index = changed_count;
+  }
+  else
   {
-    bg_name_list[i]=i;
-    bg_name_dirty[i]=0xFF;
+    /* invalidate tile cache */
+    for (i=0;i<bg_list_index;i++) 
+    {
+      bg_name_list[i]=i;
+      bg_name_dirty[i]=0xFF;
+    }
   }
 
+  cache_kept = 0;
   return bufferptr;
 }
 
@@ -1617,6 +1770,13 @@ static void vdp_reg_w(unsigned int r, unsigned int d, unsigned int cycles)
               *(uint16 *)(vram + ((i & 0x203F) | ((i >> 6) & 0x40) | ((i << 1) & 0x1F80))) = *(uint16 *)(vram + 0x4000 + i);
             }
           }
+
+#ifdef USE_RENDER_THREAD
+          for (i=0; i<0x8000; i+=0x20)
+          {
+            MARK_VRAM_BLOCK(i);
+          }
+#endif
         }
       }
 
@@ -2194,6 +2354,7 @@ static void vdp_bus_w(unsigned int data)
       {
         /* Update internal SAT */
         *(uint16 *) &sat[index & sat_addr_mask] = data;
+        sat_dirty = 1;
       }
 
       /* Only write unique data to VRAM */
@@ -2209,8 +2370,7 @@ static void vdp_bus_w(unsigned int data)
       }
 
 #ifdef HOOK_CPU
-      if (cpu_hook)
-        cpu_hook(HOOK_VRAM_W, 2, addr, data);
+      cpu_hook_call(HOOK_VRAM_W, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2258,8 +2418,7 @@ static void vdp_bus_w(unsigned int data)
       }
 
 #ifdef HOOK_CPU
-      if (cpu_hook)
-        cpu_hook(HOOK_CRAM_W, 2, addr, data);
+      cpu_hook_call(HOOK_CRAM_W, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2284,8 +2443,7 @@ static void vdp_bus_w(unsigned int data)
       }
 
 #ifdef HOOK_CPU
-      if (cpu_hook)
-        cpu_hook(HOOK_VSRAM_W, 2, addr, data);
+      cpu_hook_call(HOOK_VSRAM_W, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2493,8 +2651,7 @@ static unsigned int vdp_68k_data_r_m5(void)
       data = *(uint16 *)&vram[addr & 0xFFFE];
 
 #ifdef HOOK_CPU
-      if (cpu_hook)
-        cpu_hook(HOOK_VRAM_R, 2, addr, data);
+      cpu_hook_call(HOOK_VRAM_R, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2522,8 +2679,7 @@ static unsigned int vdp_68k_data_r_m5(void)
       data |= (fifo[fifo_idx] & ~0x7FF);
 
 #ifdef HOOK_CPU
-      if (cpu_hook)
-        cpu_hook(HOOK_VSRAM_R, 2, addr, data);
+      cpu_hook_call(HOOK_VSRAM_R, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2544,8 +2700,7 @@ static unsigned int vdp_68k_data_r_m5(void)
       data |= (fifo[fifo_idx] & ~0xEEE);
 
 #ifdef HOOK_CPU
-      if (cpu_hook)
-        cpu_hook(HOOK_CRAM_R, 2, addr, data);
+      cpu_hook_call(HOOK_CRAM_R, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2563,8 +2718,7 @@ static unsigned int vdp_68k_data_r_m5(void)
       data |= (fifo[fifo_idx] & ~0xFF);
 
 #ifdef HOOK_CPU
-      if (cpu_hook)
-        cpu_hook(HOOK_VRAM_R, 2, addr, data);
+      cpu_hook_call(HOOK_VRAM_R, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2669,6 +2823,7 @@ static void vdp_z80_data_w_m5(unsigned int data)
       {
         /* Update internal SAT */
         WRITE_BYTE(sat, index & sat_addr_mask, data);
+        sat_dirty = 1;
       }
 
       /* Only write unique data to VRAM */
@@ -2869,8 +3024,7 @@ static void vdp_z80_data_w_ms(unsigned int data)
     }
 
 #ifdef HOOK_CPU
-    if (cpu_hook)
-        cpu_hook(BPT_VRAM_W, 2, index, data);
+    cpu_hook_call(HOOK_VRAM_W, 2, index, data);
 #endif
 
 #ifdef LOGVDP
@@ -2902,8 +3056,7 @@ static void vdp_z80_data_w_ms(unsigned int data)
     }
 
 #ifdef HOOK_CPU
-    if (cpu_hook)
-        cpu_hook(BPT_CRAM_W, 2, addr, data);
+    cpu_hook_call(HOOK_CRAM_W, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -2956,8 +3109,7 @@ static void vdp_z80_data_w_gg(unsigned int data)
     }
 
 #ifdef HOOK_CPU
-    if (cpu_hook)
-        cpu_hook(BPT_VRAM_W, 2, index, data);
+    cpu_hook_call(HOOK_VRAM_W, 2, index, data);
 #endif
 
 #ifdef LOGVDP
@@ -3000,8 +3152,7 @@ static void vdp_z80_data_w_gg(unsigned int data)
     }
 
 #ifdef HOOK_CPU
-    if (cpu_hook)
-        cpu_hook(BPT_CRAM_W, 2, addr, data);
+    cpu_hook_call(HOOK_CRAM_W, 2, addr, data);
 #endif
 
 #ifdef LOGVDP
@@ -3026,13 +3177,14 @@ static void vdp_z80_data_w_sg(unsigned int data)
 
   /* VRAM write */
   vram[index] = data;
+  MARK_VRAM_BLOCK(index);
+  MARK_PAGE_DIRTY(vram_dirty, index);
 
   /* Update address register */
   addr++;
 
 #ifdef HOOK_CPU
-  if (cpu_hook)
-      cpu_hook(BPT_VRAM_W, 2, index, data);
+  cpu_hook_call(HOOK_VRAM_W, 2, index, data);
 #endif
 
 #ifdef LOGVDP
@@ -3177,6 +3329,7 @@ static void vdp_dma_copy(unsigned int length)
       {
         /* Update internal SAT */
         WRITE_BYTE(sat, (addr & sat_addr_mask) ^ 1, data);
+        sat_dirty = 1;
       }
 
       /* Write byte to adjacent VRAM destination address */
@@ -3218,6 +3371,7 @@ static void vdp_dma_fill(unsigned int length)
         {
           /* Update internal SAT */
           WRITE_BYTE(sat, (addr & sat_addr_mask) ^ 1, data);
+          sat_dirty = 1;
         }
 
         /* Write byte to adjacent VRAM address */
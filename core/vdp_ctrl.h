@@ -47,53 +47,59 @@ extern "C" {
 #endif
 
 /* VDP context */
-extern uint8 reg[0x20];
-extern uint8 sat[0x400];
-extern uint8 vram[0x10000];
-extern uint8 cram[0x80];
-extern uint8 vsram[0x80];
-extern uint8 hint_pending;
-extern uint8 vint_pending;
-extern uint16 status;
-extern uint32 dma_length;
+extern MACHINE_LOCAL uint8 reg[0x20];
+extern MACHINE_LOCAL uint8 sat[0x400];
+extern MACHINE_LOCAL uint8 vram[0x10000];
+extern MACHINE_LOCAL uint8 cram[0x80];
+extern MACHINE_LOCAL uint8 vsram[0x80];
+extern MACHINE_LOCAL uint8 hint_pending;
+extern MACHINE_LOCAL uint8 vint_pending;
+extern MACHINE_LOCAL uint16 status;
+extern MACHINE_LOCAL uint32 dma_length;
 
 /* Global variables */
-extern uint16 ntab;
-extern uint16 ntbb;
-extern uint16 ntwb;
-extern uint16 satb;
-extern uint16 hscb;
-extern uint8 bg_name_dirty[0x800];
-extern uint16 bg_name_list[0x800];
-extern uint16 bg_list_index;
-extern uint8 hscroll_mask;
-extern uint8 playfield_shift;
-extern uint8 playfield_col_mask;
-extern uint16 playfield_row_mask;
-extern uint8 odd_frame;
-extern uint8 im2_flag;
-extern uint8 interlaced;
-extern uint8 vdp_pal;
-extern uint8 h_counter;
-extern uint16 v_counter;
-extern uint16 vc_max;
-extern uint16 vscroll;
-extern uint16 lines_per_frame;
-extern uint16 max_sprite_pixels;
-extern int32 fifo_write_cnt;
-extern uint32 fifo_slots;
-extern uint32 hvc_latch;
-extern const uint8 *hctab;
+extern MACHINE_LOCAL uint16 ntab;
+extern MACHINE_LOCAL uint16 ntbb;
+extern MACHINE_LOCAL uint16 ntwb;
+extern MACHINE_LOCAL uint16 satb;
+extern MACHINE_LOCAL uint16 hscb;
+extern MACHINE_LOCAL uint8 bg_name_dirty[0x800];
+extern MACHINE_LOCAL uint16 bg_name_list[0x800];
+extern MACHINE_LOCAL uint16 bg_list_index;
+extern MACHINE_LOCAL uint8 sat_dirty;
+#ifdef USE_RENDER_THREAD
+extern MACHINE_LOCAL uint8 vram_block_dirty[0x800];
+extern MACHINE_LOCAL uint16 vram_block_list[0x800];
+extern MACHINE_LOCAL uint16 vram_block_index;
+#endif
+extern MACHINE_LOCAL uint8 hscroll_mask;
+extern MACHINE_LOCAL uint8 playfield_shift;
+extern MACHINE_LOCAL uint8 playfield_col_mask;
+extern MACHINE_LOCAL uint16 playfield_row_mask;
+extern MACHINE_LOCAL uint8 odd_frame;
+extern MACHINE_LOCAL uint8 im2_flag;
+extern MACHINE_LOCAL uint8 interlaced;
+extern MACHINE_LOCAL uint8 vdp_pal;
+extern MACHINE_LOCAL uint8 h_counter;
+extern MACHINE_LOCAL uint16 v_counter;
+extern MACHINE_LOCAL uint16 vc_max;
+extern MACHINE_LOCAL uint16 vscroll;
+extern MACHINE_LOCAL uint16 lines_per_frame;
+extern MACHINE_LOCAL uint16 max_sprite_pixels;
+extern MACHINE_LOCAL int32 fifo_write_cnt;
+extern MACHINE_LOCAL uint32 fifo_slots;
+extern MACHINE_LOCAL uint32 hvc_latch;
+extern MACHINE_LOCAL const uint8 *hctab;
 
 /* Function pointers */
-extern void (*vdp_68k_data_w)(unsigned int data);
-extern void (*vdp_z80_data_w)(unsigned int data);
-extern unsigned int (*vdp_68k_data_r)(void);
-extern unsigned int (*vdp_z80_data_r)(void);
+extern MACHINE_LOCAL void (*vdp_68k_data_w)(unsigned int data);
+extern MACHINE_LOCAL void (*vdp_z80_data_w)(unsigned int data);
+extern MACHINE_LOCAL unsigned int (*vdp_68k_data_r)(void);
+extern MACHINE_LOCAL unsigned int (*vdp_z80_data_r)(void);
 
 /* Function prototypes */
 extern void vdp_init(void);
-extern void vdp_reset(void);
+extern void vdp_reset(int hot);
 extern int vdp_context_save(uint8 *state);
 extern int vdp_context_load(uint8 *state);
 extern void vdp_dma_update(unsigned int cycles);
@@ -109,6 +115,8 @@ extern int vdp_68k_irq_ack(int int_level);
 
 extern int vdp_dma_calc_src();
 extern int vdp_dma_get_dst();
+extern void vdp_debug_vram_w(unsigned int addr, unsigned int data);
+extern void vdp_debug_cram_w(unsigned int addr, unsigned int data);
 
 #ifdef __cplusplus
 }
@@ -51,6 +51,27 @@
 #define MODE5_MAX_SPRITE_PIXELS max_sprite_pixels
 #endif
 
+/* Vectorized layer merging & remapping (x86 with SSE2) */
+#if !defined(HAVE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define USE_SIMD_RENDERING
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/* Line rendering in a separate thread (one VDP & renderer state per thread) */
+#ifdef USE_RENDER_THREAD
+#ifndef MULTI_INSTANCE
+#error "USE_RENDER_THREAD requires MULTI_INSTANCE"
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
 /*** NTSC Filters ***/
 extern md_ntsc_t *md_ntsc;
 extern sms_ntsc_t *sms_ntsc;
@@ -65,6 +86,11 @@ extern sms_ntsc_t *sms_ntsc;
 #define PIXEL_OUT_T uint16
 #endif
 
+/* XRGB8888 output can also be selected at runtime (bitmap.bpp = 32) with 15 or 16-bit pixels rendering */
+#if defined(USE_15BPP_RENDERING) || defined(USE_16BPP_RENDERING)
+#define USE_32BPP_OUTPUT
+#endif
+
 
 /* Pixel priority look-up tables information */
 #define LUT_MAX     (6)
@@ -117,6 +143,74 @@ INLINE void WRITE_LONG(void *address, uint32 data)
 #endif  /* ALIGN_LONG */
 
 
+/* Mode 5 patterns are decoded from VRAM when drawn instead of being cached */
+#ifdef USE_PATTERN_DECODE
+#ifndef LSB_FIRST
+#error "USE_PATTERN_DECODE requires LSB_FIRST"
+#endif
+
+/*
+   Decode one pattern cache line (8 pixels = 8 bytes) from VRAM
+   Pattern cache address: VHN NNNNNNNN NNYYYxxx (see update_bg_pattern_cache_m5)
+*/
+INLINE uint8 *decode_pattern_row(uint32 *dst, uint32 index)
+{
+  /* Pattern row (vertically flipped if needed) */
+  uint32 y = (index >> 3) & 7;
+  if (index & 0x40000)
+  {
+    y ^= 7;
+  }
+
+  {
+    /* Byteplane data = (msb) p4p5 p6p7 p0p1 p2p3 (lsb) */
+    uint32 bp = *(uint32 *)&vram[((index >> 1) & 0xFFE0) | (y << 2)];
+
+#ifdef USE_SIMD_RENDERING
+    /* Split pixels then reorder byte pairs (reversed when horizontally flipped) */
+    __m128i lo = _mm_cvtsi32_si128(bp);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(lo, 4), _mm_set1_epi8(0x0F));
+    lo = _mm_and_si128(lo, _mm_set1_epi8(0x0F));
+    if (index & 0x20000)
+    {
+      _mm_storel_epi64((__m128i *)dst, _mm_shufflelo_epi16(_mm_unpacklo_epi8(lo, hi), _MM_SHUFFLE(1,0,3,2)));
+    }
+    else
+    {
+      _mm_storel_epi64((__m128i *)dst, _mm_shufflelo_epi16(_mm_unpacklo_epi8(hi, lo), _MM_SHUFFLE(2,3,0,1)));
+    }
+#else
+    uint32 lo = bp & 0x0F0F0F0F;
+    uint32 hi = (bp >> 4) & 0x0F0F0F0F;
+    uint32 a, b;
+    if (index & 0x20000)
+    {
+      /* p7 p6 p5 p4 p3 p2 p1 p0 */
+      a = (lo & 0x00FF00FF) | ((hi & 0x00FF00FF) << 8);
+      b = ((lo >> 8) & 0x00FF00FF) | (hi & 0xFF00FF00);
+      dst[0] = (a >> 16) | (b & 0xFFFF0000);
+      dst[1] = (a & 0xFFFF) | (b << 16);
+    }
+    else
+    {
+      /* p0 p1 p2 p3 p4 p5 p6 p7 */
+      a = (hi & 0x00FF00FF) | ((lo & 0x00FF00FF) << 8);
+      b = ((hi >> 8) & 0x00FF00FF) | (lo & 0xFF00FF00);
+      dst[0] = (b & 0xFFFF) | (a << 16);
+      dst[1] = (b >> 16) | (a & 0xFFFF0000);
+    }
+#endif
+  }
+
+  return (uint8 *)dst;
+}
+
+/* Mode 5 pattern line (decoded line is valid until end of current block) */
+#define PATTERN_ROW(INDEX) decode_pattern_row((uint32 [2]){0, 0}, (INDEX))
+#else
+#define PATTERN_ROW(INDEX) &bg_pattern_cache[INDEX]
+#endif
+
 /* Draw 2-cell column (8-pixels high) */
 /*
    Pattern cache base address: VHN NNNNNNNN NNYYYxxx
@@ -129,10 +223,10 @@ INLINE void WRITE_LONG(void *address, uint32 data)
 */
 #define GET_LSB_TILE(ATTR, LINE) \
   atex = atex_table[(ATTR >> 13) & 7]; \
-  src = (uint32 *)&bg_pattern_cache[(ATTR & 0x00001FFF) << 6 | (LINE)];
+  src = (uint32 *)PATTERN_ROW((ATTR & 0x00001FFF) << 6 | (LINE));
 #define GET_MSB_TILE(ATTR, LINE) \
   atex = atex_table[(ATTR >> 29) & 7]; \
-  src = (uint32 *)&bg_pattern_cache[(ATTR & 0x1FFF0000) >> 10 | (LINE)];
+  src = (uint32 *)PATTERN_ROW((ATTR & 0x1FFF0000) >> 10 | (LINE));
 
 /* Draw 2-cell column (16 pixels high) */
 /*
@@ -146,10 +240,10 @@ INLINE void WRITE_LONG(void *address, uint32 data)
 */
 #define GET_LSB_TILE_IM2(ATTR, LINE) \
   atex = atex_table[(ATTR >> 13) & 7]; \
-  src = (uint32 *)&bg_pattern_cache[((ATTR & 0x000003FF) << 7 | (ATTR & 0x00001800) << 6 | (LINE)) ^ ((ATTR & 0x00001000) >> 6)];
+  src = (uint32 *)PATTERN_ROW(((ATTR & 0x000003FF) << 7 | (ATTR & 0x00001800) << 6 | (LINE)) ^ ((ATTR & 0x00001000) >> 6));
 #define GET_MSB_TILE_IM2(ATTR, LINE) \
   atex = atex_table[(ATTR >> 29) & 7]; \
-  src = (uint32 *)&bg_pattern_cache[((ATTR & 0x03FF0000) >> 9 | (ATTR & 0x18000000) >> 10 | (LINE)) ^ ((ATTR & 0x10000000) >> 22)];
+  src = (uint32 *)PATTERN_ROW(((ATTR & 0x03FF0000) >> 9 | (ATTR & 0x18000000) >> 10 | (LINE)) ^ ((ATTR & 0x10000000) >> 22));
 
 /*
    One column = 2 tiles
@@ -492,8 +586,13 @@ INLINE void WRITE_LONG(void *address, uint32 data)
 #define MAKE_PIXEL(r,g,b) ((0xff << 24) | (r) << 20 | (r) << 16 | (g) << 12 | (g)  << 8 | (b) << 4 | (b))
 #endif
 
+/* 8:8:8 RGB (runtime XRGB8888 output) */
+#ifdef USE_32BPP_OUTPUT
+#define MAKE_PIXEL32(r,g,b) ((0xff << 24) | (r) << 20 | (r) << 16 | (g) << 12 | (g)  << 8 | (b) << 4 | (b))
+#endif
+
 /* Window & Plane A clipping */
-static struct clip_t
+static MACHINE_LOCAL struct clip_t
 {
   uint8 left;
   uint8 right;
@@ -560,8 +659,22 @@ static const uint32 tms_palette[16] =
 };
 #endif
 
-/* Cached and flipped patterns */
-static uint8 ALIGNED_(4) bg_pattern_cache[0x80000];
+#ifdef USE_32BPP_OUTPUT
+static const uint32 tms_palette32[16] =
+{
+  0xFF000000, 0xFF000000, 0xFF21C842, 0xFF5EDC78,
+  0xFF5455ED, 0xFF7D76FC, 0xFFD4524D, 0xFF42EBF5,
+  0xFFFC5554, 0xFFFF7978, 0xFFD4C154, 0xFFE6CE80,
+  0xFF21B03B, 0xFFC95BB4, 0xFFCCCCCC, 0xFFFFFFFF
+};
+#endif
+
+/* Cached and flipped patterns (Mode 4 only when Mode 5 patterns are decoded on demand) */
+#ifdef USE_PATTERN_DECODE
+static MACHINE_LOCAL uint8 ALIGNED_(4) bg_pattern_cache[0x20000];
+#else
+static MACHINE_LOCAL uint8 ALIGNED_(4) bg_pattern_cache[0x80000];
+#endif
 
 /* Sprite pattern name offset look-up table (Mode 5) */
 static uint8 name_lut[0x400];
@@ -572,16 +685,41 @@ static uint32 bp_lut[0x10000];
 /* Layer priority pixel look-up tables */
 static uint8 lut[LUT_MAX][LUT_SIZE];
 
-/* Output pixel data look-up tables*/
-static PIXEL_OUT_T pixel[0x100];
+/* Output pixel data look-up tables (last entry is only read by 32-bit gathers) */
+static MACHINE_LOCAL PIXEL_OUT_T pixel[0x100 + 1];
+#ifdef USE_RENDER_THREAD
+static MACHINE_LOCAL uint8 pixel_dirty; /* 1= palette is copied to render thread with next line */
+#endif
 static PIXEL_OUT_T pixel_lut[3][0x200];
 static PIXEL_OUT_T pixel_lut_m4[0x40];
+#ifdef USE_32BPP_OUTPUT
+static MACHINE_LOCAL uint32 pixel32[0x100];
+static uint32 pixel_lut32[3][0x200];
+static uint32 pixel_lut32_m4[0x40];
+
+/* Palette entries are updated in both output formats (color value in data & data32) */
+#define SET_PIXEL(index, data) \
+{ \
+  pixel[index] = data; \
+  pixel32[index] = data##32; \
+}
+#else
+#define SET_PIXEL(index, data) pixel[index] = data
+#endif
+
+/* Pixel layer merging & remapping functions (see render_init) */
+static void (*merge_bg[2])(uint8 *srca, uint8 *srcb, uint8 *dst, int width);
+static void (*merge_obj_ste)(uint8 *srca, uint8 *srcb, uint8 *dst, int width);
+static void (*remap_pixels)(PIXEL_OUT_T *dst, uint8 *src, int width);
+#ifdef USE_32BPP_OUTPUT
+static void (*remap_pixels32)(uint32 *dst, uint8 *src, int width);
+#endif
 
 /* Background & Sprite line buffers */
-static uint8 linebuf[2][0x200];
+static MACHINE_LOCAL uint8 linebuf[2][0x200];
 
 /* Sprite limit flag */
-static uint8 spr_ovr;
+static MACHINE_LOCAL uint8 spr_ovr;
 
 /* Sprite parsing lists */
 typedef struct
@@ -592,19 +730,25 @@ typedef struct
   uint16 size;
 } object_info_t;
 
-static object_info_t obj_info[2][MAX_SPRITES_PER_LINE];
+static MACHINE_LOCAL object_info_t obj_info[2][MAX_SPRITES_PER_LINE];
 
 /* Sprite Counter */
-static uint8 object_count[2];
+static MACHINE_LOCAL uint8 object_count[2];
+
+/* Mode 5 sprite index (linked sprites listed by covered line, in link order) */
+static MACHINE_LOCAL uint8 sprite_index[0x200][MAX_SPRITES_PER_LINE + 1];
+static MACHINE_LOCAL uint8 sprite_index_count[0x200];
+static MACHINE_LOCAL uint32 sprite_index_mode;
+static MACHINE_LOCAL uint8 sprite_index_builds;
 
 /* Sprite Collision Info */
-uint16 spr_col;
+MACHINE_LOCAL uint16 spr_col;
 
 /* Function pointers */
-void (*render_bg)(int line);
-void (*render_obj)(int line);
-void (*parse_satb)(int line);
-void (*update_bg_pattern_cache)(int index);
+MACHINE_LOCAL void (*render_bg)(int line);
+MACHINE_LOCAL void (*render_obj)(int line);
+MACHINE_LOCAL void (*parse_satb)(int line);
+MACHINE_LOCAL void (*update_bg_pattern_cache)(int index);
 
 
 /*--------------------------------------------------------------------------*/
@@ -960,6 +1104,273 @@ INLINE void merge(uint8 *srca, uint8 *srcb, uint8 *dst, uint8 *table, int width)
   while (--width);
 }
 
+static void merge_bg_c(uint8 *srca, uint8 *srcb, uint8 *dst, int width)
+{
+  merge(srca, srcb, dst, lut[0], width);
+}
+
+static void merge_bg_ste_c(uint8 *srca, uint8 *srcb, uint8 *dst, int width)
+{
+  merge(srca, srcb, dst, lut[2], width);
+}
+
+static void merge_obj_ste_c(uint8 *srca, uint8 *srcb, uint8 *dst, int width)
+{
+  merge(srca, srcb, dst, lut[4], width);
+}
+
+static void remap_pixels_c(PIXEL_OUT_T *dst, uint8 *src, int width)
+{
+  do
+  {
+    *dst++ = pixel[*src++];
+  }
+  while (--width);
+}
+
+#ifdef USE_32BPP_OUTPUT
+static void remap_pixels32_c(uint32 *dst, uint8 *src, int width)
+{
+  do
+  {
+    *dst++ = pixel32[*src++];
+  }
+  while (--width);
+}
+
+/* LCD ghosting filter (see RENDER_PIXEL_LCD) with 8-bit color channels */
+static void remap_pixels32_lcd(uint32 *dst, uint8 *src, int width, int rate)
+{
+  do
+  {
+    uint32 pixel_out = pixel32[*src++];
+    uint32 pixel_old = *dst;
+    int i, c, decay;
+
+    for (i = 0; i < 24; i += 8)
+    {
+      c = (pixel_out >> i) & 0xff;
+      decay = ((pixel_old >> i) & 0xff) - c;
+      if (decay > 0)
+      {
+        pixel_out += ((rate * decay) >> 8) << i;
+      }
+    }
+
+    *dst++ = pixel_out;
+  }
+  while (--width);
+}
+#endif
+
+#ifdef USE_SIMD_RENDERING
+
+/*--------------------------------------------------------------------------*/
+/* Vectorized pixel layer merging & remapping functions (x86)               */
+/*--------------------------------------------------------------------------*/
+
+/*
+   The merging functions compute the same results as make_lut_bg, make_lut_bg_ste
+   and make_lut_bgobj_ste (see above) with masks instead of table lookups, one vector
+   of pixels at a time. Each vector operation is defined below for SSE2 (16 pixels)
+   and AVX2 (32 pixels); remaining pixels go through the look-up tables.
+*/
+
+/* Plane A (srca) & Plane B (srcb) */
+#define MERGE_BG_VEC(A, B, OUT) \
+{ \
+  VEC at = V_CMPEQ(V_AND(A, V_SET(0x0F)), V_ZERO); \
+  VEC bt = V_CMPEQ(V_AND(B, V_SET(0x0F)), V_ZERO); \
+  VEC ap = V_CMPEQ(V_AND(A, V_SET(0x40)), V_SET(0x40)); \
+  VEC bl = V_CMPEQ(V_AND(B, V_SET(0x40)), V_ZERO); \
+  VEC sa = V_ANDNOT(at, V_OR(ap, V_OR(bl, bt))); \
+  OUT = V_AND(V_OR(V_AND(sa, A), V_ANDNOT(sa, B)), V_SET(0x7F)); \
+  OUT = V_ANDNOT(V_CMPEQ(V_AND(OUT, V_SET(0x0F)), V_ZERO), OUT); \
+}
+
+/* Plane A (srca) & Plane B (srcb), shadow / highlight mode */
+#define MERGE_BG_STE_VEC(A, B, OUT) \
+{ \
+  VEC pr = V_AND(V_OR(A, B), V_SET(0x40)); \
+  MERGE_BG_VEC(A, B, OUT) \
+  OUT = V_OR(OUT, V_ADD(pr, pr)); \
+}
+
+/* Sprites (srca) & Background (srcb), shadow / highlight mode */
+#define MERGE_OBJ_STE_VEC(S, B, OUT) \
+{ \
+  VEC bf = V_AND(B, V_SET(0x3F)); \
+  VEC sf = V_AND(S, V_SET(0x3F)); \
+  VEC bi = V_AND(V_SRL1(B), V_SET(0x40)); \
+  VEC sp = V_AND(S, V_SET(0x40)); \
+  VEC st = V_CMPEQ(V_AND(S, V_SET(0x0F)), V_ZERO); \
+  VEC ws = V_ANDNOT(st, V_OR(V_CMPEQ(sp, V_SET(0x40)), V_OR(V_CMPEQ(V_AND(B, V_SET(0x40)), V_ZERO), V_CMPEQ(V_AND(B, V_SET(0x0F)), V_ZERO)))); \
+  VEC op = V_CMPEQ(V_AND(S, V_SET(0x3E)), V_SET(0x3E)); \
+  VEC sh = V_CMPEQ(V_AND(S, V_SET(0x01)), V_SET(0x01)); \
+  VEC hl = V_CMPEQ(V_AND(S, V_SET(0x0F)), V_SET(0x0E)); \
+  VEC ob = V_OR(bf, bi); \
+  VEC os = V_ANDNOT(hl, V_OR(sf, V_OR(sp, bi))); \
+  os = V_OR(os, V_AND(hl, V_OR(sf, V_SET(0x40)))); \
+  os = V_ANDNOT(op, os); \
+  os = V_OR(os, V_AND(op, V_OR(bf, V_ANDNOT(sh, V_ADD(bi, V_SET(0x40)))))); \
+  OUT = V_OR(V_AND(ws, os), V_ANDNOT(ws, ob)); \
+  OUT = V_ANDNOT(V_AND(V_CMPEQ(V_AND(OUT, V_SET(0x0F)), V_ZERO), V_SET(0x3F)), OUT); \
+}
+
+#define MERGE_FUNC(NAME, KERNEL, TABLE) \
+static TARGET void NAME(uint8 *srca, uint8 *srcb, uint8 *dst, int width) \
+{ \
+  for (; width >= V_SIZE; width -= V_SIZE) \
+  { \
+    VEC out; \
+    VEC a = V_LOAD(srca); \
+    VEC b = V_LOAD(srcb); \
+    KERNEL(a, b, out) \
+    V_STORE(dst, out); \
+    srca += V_SIZE; \
+    srcb += V_SIZE; \
+    dst  += V_SIZE; \
+  } \
+  if (width) merge(srca, srcb, dst, TABLE, width); \
+}
+
+/* SSE2 */
+#define TARGET
+#define VEC           __m128i
+#define V_SIZE        16
+#define V_LOAD(p)     _mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p,v)  _mm_storeu_si128((__m128i *)(p), v)
+#define V_SET(x)      _mm_set1_epi8(x)
+#define V_ZERO        _mm_setzero_si128()
+#define V_AND(x,y)    _mm_and_si128(x, y)
+#define V_ANDNOT(m,x) _mm_andnot_si128(m, x)
+#define V_OR(x,y)     _mm_or_si128(x, y)
+#define V_ADD(x,y)    _mm_add_epi8(x, y)
+#define V_SRL1(x)     _mm_srli_epi16(x, 1)
+#define V_CMPEQ(x,y)  _mm_cmpeq_epi8(x, y)
+
+MERGE_FUNC(merge_bg_sse2, MERGE_BG_VEC, lut[0])
+MERGE_FUNC(merge_bg_ste_sse2, MERGE_BG_STE_VEC, lut[2])
+MERGE_FUNC(merge_obj_ste_sse2, MERGE_OBJ_STE_VEC, lut[4])
+
+#undef TARGET
+#undef VEC
+#undef V_SIZE
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET
+#undef V_ZERO
+#undef V_AND
+#undef V_ANDNOT
+#undef V_OR
+#undef V_ADD
+#undef V_SRL1
+#undef V_CMPEQ
+
+/* AVX2 (only called when supported by CPU, see render_init) */
+#ifdef _MSC_VER
+#define TARGET
+#else
+#define TARGET __attribute__((target("avx2")))
+#endif
+#define VEC           __m256i
+#define V_SIZE        32
+#define V_LOAD(p)     _mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p,v)  _mm256_storeu_si256((__m256i *)(p), v)
+#define V_SET(x)      _mm256_set1_epi8(x)
+#define V_ZERO        _mm256_setzero_si256()
+#define V_AND(x,y)    _mm256_and_si256(x, y)
+#define V_ANDNOT(m,x) _mm256_andnot_si256(m, x)
+#define V_OR(x,y)     _mm256_or_si256(x, y)
+#define V_ADD(x,y)    _mm256_add_epi8(x, y)
+#define V_SRL1(x)     _mm256_srli_epi16(x, 1)
+#define V_CMPEQ(x,y)  _mm256_cmpeq_epi8(x, y)
+
+MERGE_FUNC(merge_bg_avx2, MERGE_BG_VEC, lut[0])
+MERGE_FUNC(merge_bg_ste_avx2, MERGE_BG_STE_VEC, lut[2])
+MERGE_FUNC(merge_obj_ste_avx2, MERGE_OBJ_STE_VEC, lut[4])
+
+#if defined(USE_15BPP_RENDERING) || defined(USE_16BPP_RENDERING) || defined(USE_32BPP_RENDERING)
+/* Output pixels are fetched eight at a time with 32-bit gathers */
+static TARGET void remap_pixels_avx2(PIXEL_OUT_T *dst, uint8 *src, int width)
+{
+  for (; width >= 16; width -= 16)
+  {
+    __m256i lo = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src)));
+    __m256i hi = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + 8)));
+    lo = _mm256_i32gather_epi32((const int *)pixel, lo, sizeof(PIXEL_OUT_T));
+    hi = _mm256_i32gather_epi32((const int *)pixel, hi, sizeof(PIXEL_OUT_T));
+#ifdef USE_32BPP_RENDERING
+    _mm256_storeu_si256((__m256i *)(dst), lo);
+    _mm256_storeu_si256((__m256i *)(dst + 8), hi);
+#else
+    lo = _mm256_and_si256(lo, _mm256_set1_epi32(0xFFFF));
+    hi = _mm256_and_si256(hi, _mm256_set1_epi32(0xFFFF));
+    _mm256_storeu_si256((__m256i *)(dst), _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8));
+#endif
+    src += 16;
+    dst += 16;
+  }
+  while (width--)
+  {
+    *dst++ = pixel[*src++];
+  }
+}
+#endif
+
+#ifdef USE_32BPP_OUTPUT
+static TARGET void remap_pixels32_avx2(uint32 *dst, uint8 *src, int width)
+{
+  for (; width >= 8; width -= 8)
+  {
+    __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src)));
+    _mm256_storeu_si256((__m256i *)(dst), _mm256_i32gather_epi32((const int *)pixel32, idx, 4));
+    src += 8;
+    dst += 8;
+  }
+  while (width--)
+  {
+    *dst++ = pixel32[*src++];
+  }
+}
+#endif
+
+#undef TARGET
+#undef VEC
+#undef V_SIZE
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET
+#undef V_ZERO
+#undef V_AND
+#undef V_ANDNOT
+#undef V_OR
+#undef V_ADD
+#undef V_SRL1
+#undef V_CMPEQ
+
+static int cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return 0;
+
+  /* AVX registers must be supported and saved by the OS */
+  __cpuid(info, 1);
+  if ((info[2] & 0x18000000) != 0x18000000) return 0;
+  if ((_xgetbv(0) & 6) != 6) return 0;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] >> 5) & 1;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* USE_SIMD_RENDERING */
+
 
 /*--------------------------------------------------------------------------*/
 /* Pixel color lookup tables initialization                                 */
@@ -997,6 +1408,11 @@ static void palette_init(void)
     pixel_lut[0][i] = MAKE_PIXEL(r,g,b);
     pixel_lut[1][i] = MAKE_PIXEL(r<<1,g<<1,b<<1);
     pixel_lut[2][i] = MAKE_PIXEL(r+7,g+7,b+7);
+#ifdef USE_32BPP_OUTPUT
+    pixel_lut32[0][i] = MAKE_PIXEL32(r,g,b);
+    pixel_lut32[1][i] = MAKE_PIXEL32(r<<1,g<<1,b<<1);
+    pixel_lut32[2][i] = MAKE_PIXEL32(r+7,g+7,b+7);
+#endif
   }
 
   /* Initialize Mode 4 pixel color look-up table */
@@ -1009,6 +1425,9 @@ static void palette_init(void)
 
     /* Expand to full range & convert to output pixel format */
     pixel_lut_m4[i] = MAKE_PIXEL((r << 2) | r, (g << 2) | g, (b << 2) | b);
+#ifdef USE_32BPP_OUTPUT
+    pixel_lut32_m4[i] = MAKE_PIXEL32((r << 2) | r, (g << 2) | g, (b << 2) | b);
+#endif
   }
 }
 
@@ -1019,6 +1438,11 @@ static void palette_init(void)
 
 void color_update_m4(int index, unsigned int data)
 {
+#ifdef USE_32BPP_OUTPUT
+  /* XRGB8888 output pixel */
+  uint32 data32;
+#endif
+
   switch (system_hw)
   {
     case SYSTEM_GG:
@@ -1030,23 +1454,21 @@ void color_update_m4(int index, unsigned int data)
 
       /* Convert to output pixel */
       data = MAKE_PIXEL(r,g,b);
+#ifdef USE_32BPP_OUTPUT
+      data32 = MAKE_PIXEL32(r,g,b);
+#endif
       break;
     }
 
     case SYSTEM_SG:
     case SYSTEM_SGII:
     {
-      /* Fixed TMS99xx palette */
-      if (index & 0x0F)
-      {
-        /* Colors 1-15 */
-        data = tms_palette[index & 0x0F];
-      }
-      else
-      {
-        /* Backdrop color */
-        data = tms_palette[reg[7] & 0x0F];
-      }
+      /* Fixed TMS99xx palette (colors 1-15 or backdrop color) */
+      int color = (index & 0x0F) ? (index & 0x0F) : (reg[7] & 0x0F);
+      data = tms_palette[color];
+#ifdef USE_32BPP_OUTPUT
+      data32 = tms_palette32[color];
+#endif
       break;
     }
 
@@ -1077,20 +1499,27 @@ void color_update_m4(int index, unsigned int data)
       }
 
       /* Mode 4 palette */
+#ifdef USE_32BPP_OUTPUT
+      data32 = pixel_lut32_m4[data & 0x3F];
+#endif
       data = pixel_lut_m4[data & 0x3F];
       break;
     }
   }
 
 
+#ifdef USE_RENDER_THREAD
+  pixel_dirty = 1;
+#endif
+
   /* Input pixel: x0xiiiii (normal) or 01000000 (backdrop) */
   if (reg[0] & 0x04)
   {
     /* Mode 4 */
-    pixel[0x00 | index] = data;
-    pixel[0x20 | index] = data;
-    pixel[0x80 | index] = data;
-    pixel[0xA0 | index] = data;
+    SET_PIXEL(0x00 | index, data);
+    SET_PIXEL(0x20 | index, data);
+    SET_PIXEL(0x80 | index, data);
+    SET_PIXEL(0xA0 | index, data);
   }
   else
   {
@@ -1098,22 +1527,22 @@ void color_update_m4(int index, unsigned int data)
     if ((index == 0x40) || (index == (0x10 | (reg[7] & 0x0F))))
     {
       /* Update backdrop color */
-      pixel[0x40] = data;
+      SET_PIXEL(0x40, data);
 
       /* Update transparent color */
-      pixel[0x10] = data;
-      pixel[0x30] = data;
-      pixel[0x90] = data;
-      pixel[0xB0] = data;
+      SET_PIXEL(0x10, data);
+      SET_PIXEL(0x30, data);
+      SET_PIXEL(0x90, data);
+      SET_PIXEL(0xB0, data);
     }
 
     if (index & 0x0F)
     {
       /* update non-transparent colors */
-      pixel[0x00 | index] = data;
-      pixel[0x20 | index] = data;
-      pixel[0x80 | index] = data;
-      pixel[0xA0 | index] = data;
+      SET_PIXEL(0x00 | index, data);
+      SET_PIXEL(0x20 | index, data);
+      SET_PIXEL(0x80 | index, data);
+      SET_PIXEL(0xA0 | index, data);
     }
   }
 }
@@ -1127,22 +1556,35 @@ void color_update_m5(int index, unsigned int data)
     data &= 0x49;
   }
 
+#ifdef USE_RENDER_THREAD
+  pixel_dirty = 1;
+#endif
+
   if(reg[12] & 0x08)
   {
     /* Mode 5 (Shadow/Normal/Highlight) */
     pixel[0x00 | index] = pixel_lut[0][data];
     pixel[0x40 | index] = pixel_lut[1][data];
     pixel[0x80 | index] = pixel_lut[2][data];
+#ifdef USE_32BPP_OUTPUT
+    pixel32[0x00 | index] = pixel_lut32[0][data];
+    pixel32[0x40 | index] = pixel_lut32[1][data];
+    pixel32[0x80 | index] = pixel_lut32[2][data];
+#endif
   }
   else
   {
+#ifdef USE_32BPP_OUTPUT
+    uint32 data32 = pixel_lut32[1][data];
+#endif
+
     /* Mode 5 (Normal) */
     data = pixel_lut[1][data];
 
     /* Input pixel: xxiiiiii */
-    pixel[0x00 | index] = data;
-    pixel[0x40 | index] = data;
-    pixel[0x80 | index] = data;
+    SET_PIXEL(0x00 | index, data);
+    SET_PIXEL(0x40 | index, data);
+    SET_PIXEL(0x80 | index, data);
   }
 }
 
@@ -1654,7 +2096,7 @@ void render_bg_m5(int line)
   }
 
   /* Merge background layers */
-  merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[(reg[12] & 0x08) >> 2], bitmap.viewport.w);
+  merge_bg[(reg[12] & 0x08) >> 3](&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 }
 
 void render_bg_m5_vs(int line)
@@ -1844,7 +2286,7 @@ void render_bg_m5_vs(int line)
   }
 
   /* Merge background layers */
-  merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[(reg[12] & 0x08) >> 2], bitmap.viewport.w);
+  merge_bg[(reg[12] & 0x08) >> 3](&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 }
 
 void render_bg_m5_im2(int line)
@@ -1996,7 +2438,7 @@ void render_bg_m5_im2(int line)
   }
 
   /* Merge background layers */
-  merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[(reg[12] & 0x08) >> 2], bitmap.viewport.w);
+  merge_bg[(reg[12] & 0x08) >> 3](&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 }
 
 void render_bg_m5_im2_vs(int line)
@@ -2187,7 +2629,7 @@ void render_bg_m5_im2_vs(int line)
   }
 
   /* Merge background layers */
-  merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[(reg[12] & 0x08) >> 2], bitmap.viewport.w);
+  merge_bg[(reg[12] & 0x08) >> 3](&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 }
 
 #else
@@ -3238,7 +3680,7 @@ void render_obj_m5(int line)
       for (column = 0; column < width; column++, lb+=8)
       {
         temp = attr | ((name + s[column]) & 0x07FF);
-        src = &bg_pattern_cache[(temp << 6) | (v_line)];
+        src = PATTERN_ROW((temp << 6) | (v_line));
         DRAW_SPRITE_TILE(8,atex,lut[1])
       }
     }
@@ -3350,7 +3792,7 @@ void render_obj_m5_ste(int line)
       for (column = 0; column < width; column++, lb+=8)
       {
         temp = attr | ((name + s[column]) & 0x07FF);
-        src = &bg_pattern_cache[(temp << 6) | (v_line)];
+        src = PATTERN_ROW((temp << 6) | (v_line));
         DRAW_SPRITE_TILE(8,atex,lut[3])
       }
     }
@@ -3362,7 +3804,7 @@ void render_obj_m5_ste(int line)
       spr_ovr = (pixelcount >= bitmap.viewport.w);
 
       /* Merge background & sprite layers */
-      merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[4], bitmap.viewport.w);
+      merge_obj_ste(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 
       /* Stop sprite rendering */
       return;
@@ -3376,7 +3818,7 @@ void render_obj_m5_ste(int line)
   spr_ovr = 0;
 
   /* Merge background & sprite layers */
-  merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[4], bitmap.viewport.w);
+  merge_obj_ste(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 }
 
 void render_obj_m5_im2(int line)
@@ -3466,7 +3908,7 @@ void render_obj_m5_im2(int line)
       for(column = 0; column < width; column ++, lb+=8)
       {
         temp = attr | (((name + s[column]) & 0x3ff) << 1);
-        src = &bg_pattern_cache[((temp << 6) | (v_line)) ^ ((attr & 0x1000) >> 6)];
+        src = PATTERN_ROW(((temp << 6) | (v_line)) ^ ((attr & 0x1000) >> 6));
         DRAW_SPRITE_TILE(8,atex,lut[1])
       }
     }
@@ -3579,7 +4021,7 @@ void render_obj_m5_im2_ste(int line)
       for(column = 0; column < width; column ++, lb+=8)
       {
         temp = attr | (((name + s[column]) & 0x3ff) << 1);
-        src = &bg_pattern_cache[((temp << 6) | (v_line)) ^ ((attr & 0x1000) >> 6)];
+        src = PATTERN_ROW(((temp << 6) | (v_line)) ^ ((attr & 0x1000) >> 6));
         DRAW_SPRITE_TILE(8,atex,lut[3])
       }
     }
@@ -3591,7 +4033,7 @@ void render_obj_m5_im2_ste(int line)
       spr_ovr = (pixelcount >= bitmap.viewport.w);
 
       /* Merge background & sprite layers */
-      merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[4], bitmap.viewport.w);
+      merge_obj_ste(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 
       /* Stop sprite rendering */
       return;
@@ -3605,7 +4047,7 @@ void render_obj_m5_im2_ste(int line)
   spr_ovr = 0;
 
   /* Merge background & sprite layers */
-  merge(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], lut[4], bitmap.viewport.w);
+  merge_obj_ste(&linebuf[1][0x20], &linebuf[0][0x20], &linebuf[0][0x20], bitmap.viewport.w);
 }
 
 
@@ -3790,7 +4232,7 @@ void parse_satb_m4(int line)
   object_count[(line + 1) & 1] = count;
 }
 
-void parse_satb_m5(int line)
+static void parse_satb_m5_link(int line)
 {
   /* Y position */
   int ypos;
@@ -3878,6 +4320,135 @@ void parse_satb_m5(int line)
   object_count[line & 1] = count;
 }
 
+static void update_sprite_index_m5(void)
+{
+  int ypos, end, n;
+
+  /* Sprite link data */
+  int link = 0;
+
+  /* max. number of parsed sprites (64 or 80 sprites per line by default) */
+  int total = max_sprite_pixels >> 2;
+
+  /* Pointer to internal RAM */
+  uint16 *q = (uint16 *) &sat[0];
+
+  memset(sprite_index_count, 0, sizeof(sprite_index_count));
+
+  /* Follow sprite links once, exactly as they are parsed on each line */
+  do
+  {
+    /* Lines covered by sprite (line offset included) */
+    ypos = (q[link] >> im2_flag) & 0x1FF;
+    end = ypos + 8 + (((q[link + 1] >> 8) & 3) << 3);
+    if (end > 0x200) end = 0x200;
+
+    /* Add sprite to these lines (one more than max. rendered sprites is enough to detect overflow) */
+    for (; ypos < end; ypos++)
+    {
+      n = sprite_index_count[ypos];
+      if (n <= MAX_SPRITES_PER_LINE)
+      {
+        sprite_index[ypos][n] = link >> 2;
+        sprite_index_count[ypos] = n + 1;
+      }
+    }
+
+    /* Read link data from internal SAT cache */
+    link = (q[link + 1] & 0x7F) << 2;
+
+    /* Stop parsing if link data points to first entry (#0) or after the last entry (#64 in H32 mode, #80 in H40 mode) */
+    if ((link == 0) || (link >= bitmap.viewport.w)) break;
+  }
+  while (--total);
+}
+
+void parse_satb_m5(int line)
+{
+  /* Y position */
+  int ypos;
+
+  /* Sprite size data */
+  int size;
+
+  /* Sprite link data */
+  int link;
+
+  /* Sprite counter */
+  int i, count;
+
+  /* max. number of rendered sprites (16 or 20 sprites per line by default) */
+  int max = MODE5_MAX_SPRITES_PER_LINE;
+
+  /* Pointer to sprite attribute table */
+  uint16 *p = (uint16 *) &vram[satb];
+
+  /* Pointer to internal RAM */
+  uint16 *q = (uint16 *) &sat[0];
+
+  /* Sprite list for next line */
+  object_info_t *object_info = obj_info[(line + 1) & 1];
+
+  /* Sprite index depends on internal SAT, display width, sprite limit & interlace mode */
+  uint32 mode = bitmap.viewport.w | (max_sprite_pixels << 16) | (im2_flag << 28);
+
+  /* First parsed line of a new frame */
+  if (line < 0)
+  {
+    sprite_index_builds = 0;
+  }
+
+  if (sat_dirty || (mode != sprite_index_mode))
+  {
+    /* Internal SAT modified again during active display: follow sprite links instead */
+    if (sprite_index_builds >= 4)
+    {
+      parse_satb_m5_link(line);
+      return;
+    }
+
+    update_sprite_index_m5();
+    sprite_index_mode = mode;
+    sprite_index_builds++;
+    sat_dirty = 0;
+  }
+
+  /* Adjust line offset */
+  line += 0x81;
+
+  /* Visible sprites on current line */
+  count = sprite_index_count[line];
+
+  /* Sprite overflow */
+  if (count > max)
+  {
+    status |= 0x40;
+    count = max;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    link = sprite_index[line][i] << 2;
+
+    /* Y range */
+    ypos = line - ((q[link] >> im2_flag) & 0x1FF);
+
+    /* Read sprite size from internal SAT cache */
+    size = q[link + 1] >> 8;
+
+    /* Update sprite list (only name, attribute & xpos are parsed from VRAM) */
+    object_info->attr  = p[link + 2];
+    object_info->xpos  = p[link + 3] & 0x1ff;
+    object_info->ypos  = ypos;
+    object_info->size  = size & 0x0f;
+
+    /* Next sprite entry */
+    object_info++;
+  }
+
+  /* Update sprite count for next line (line value already incremented) */
+  object_count[line & 1] = count;
+}
 
 /*--------------------------------------------------------------------------*/
 /* Pattern cache update function                                            */
@@ -3937,6 +4508,19 @@ void update_bg_pattern_cache_m4(int index)
   }
 }
 
+#ifdef USE_PATTERN_DECODE
+void update_bg_pattern_cache_m5(int index)
+{
+  int i;
+
+  /* Patterns are decoded from VRAM when drawn (see decode_pattern_row) */
+  for(i = 0; i < index; i++)
+  {
+    /* Clear modified pattern flag */
+    bg_name_dirty[bg_name_list[i]] = 0;
+  }
+}
+#else
 void update_bg_pattern_cache_m5(int index)
 {
   int i;
@@ -3995,6 +4579,7 @@ void update_bg_pattern_cache_m5(int index)
     bg_name_dirty[name] = 0;
   }
 }
+#endif
 
 
 /*--------------------------------------------------------------------------*/
@@ -4046,10 +4631,612 @@ void window_clip(unsigned int data, unsigned int sw)
 }
 
 
+#ifdef USE_RENDER_THREAD
+
 /*--------------------------------------------------------------------------*/
-/* Init, reset routines                                                     */
+/* Render thread                                                            */
 /*--------------------------------------------------------------------------*/
 
+/* When started, render_line, skip_line, blank_line and remap_line only queue  */
+/* a job holding the VDP state used for rendering (registers, VSRAM, palette, */
+/* parsed sprites...) and the VRAM blocks modified since previous job. The    */
+/* render thread has its own VDP & renderer state (MACHINE_LOCAL variables),  */
+/* updates it with each job then calls the same function, so lines are drawn */
+/* exactly as they would be by the emulation thread, mid-line changes too.    */
+/* Sprites are still processed by the emulation thread (see process_line) to  */
+/* keep VDP sprite overflow & collision flags exact.                          */
+
+/* Jobs queue size (largest job is about 80KB) */
+#define RENDER_QUEUE_SIZE 0x100000
+
+/* Queued jobs before idle render thread is woken up */
+#define RENDER_BATCH 32
+
+/* Palette data copied with job (in each output format) */
+#ifdef USE_32BPP_OUTPUT
+#define PALETTE_SIZE (sizeof(pixel) + sizeof(pixel32))
+#else
+#define PALETTE_SIZE sizeof(pixel)
+#endif
+
+/* Job types */
+#define RENDER_JOB_LINE  0
+#define RENDER_JOB_SKIP  1
+#define RENDER_JOB_BLANK 2
+#define RENDER_JOB_REMAP 3
+#define RENDER_JOB_WRAP  4
+
+typedef struct
+{
+  uint32 size;                /* Job size in queue, including following data */
+  uint8 type;                 /* Job type */
+  uint8 full;                 /* 1= VRAM & pattern cache are copied from emulation thread */
+  uint8 palette;              /* 1= modified palette follows */
+  uint8 sprites;              /* # of following sprite entries */
+  uint16 blocks;              /* # of following modified VRAM blocks */
+  uint16 names;               /* # of following patterns to update in cache */
+  int line;
+  int offset;
+  int width;
+
+  /* VDP state */
+  uint8 reg[0x20];
+  uint8 vsram[0x80];
+  uint16 ntab, ntbb, ntwb, satb, hscb;
+  uint8 hscroll_mask, playfield_shift, playfield_col_mask;
+  uint16 playfield_row_mask;
+  uint16 vscroll;
+  uint16 status;
+  uint16 v_counter;
+  uint8 odd_frame, im2_flag, interlaced;
+  uint16 lines_per_frame;
+  uint16 max_sprite_pixels;
+  uint8 system_hw;
+  uint8 ntsc, lcd, gg_extra, render;
+  t_bitmap bitmap;
+
+  /* Renderer state */
+  struct clip_t clip[2];
+  uint8 spr_ovr;
+  void (*render_bg)(int line);
+  void (*render_obj)(int line);
+  void (*parse_satb)(int line);
+  void (*update_bg_pattern_cache)(int index);
+
+  /* Emulation thread VRAM & pattern cache (full copy) */
+  const uint8 *vram;
+  const uint8 *bg_pattern_cache;
+} render_job_t;
+
+typedef struct
+{
+  uint8 *queue;
+  uint32 head;                /* Queue write position (emulation thread) */
+  uint32 tail;                /* Queue read position (render thread) */
+  uint32 last_tail;           /* Queue read position last seen by emulation thread */
+  uint32 frame_end;           /* Queue write position at the end of last frame */
+  int delay;                  /* 1= frames are completed one frame later */
+  int full;                   /* 1= next job copies VRAM & pattern cache */
+  int idle;                   /* 1= render thread is waiting for jobs */
+  int batch;                  /* # of jobs queued while render thread is idle */
+  int waiting;                /* 1= emulation thread is waiting for jobs completion */
+  int quit;
+#ifdef _WIN32
+  HANDLE thread;
+  CRITICAL_SECTION lock;
+  CONDITION_VARIABLE queued;
+  CONDITION_VARIABLE done;
+#else
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t queued;
+  pthread_cond_t done;
+#endif
+} render_thread_t;
+
+static MACHINE_LOCAL render_thread_t *render_thread;
+
+#ifdef _WIN32
+#define RT_LOCK(rt)         EnterCriticalSection(&(rt)->lock)
+#define RT_UNLOCK(rt)       LeaveCriticalSection(&(rt)->lock)
+#define RT_WAIT(rt, cond)   SleepConditionVariableCS(&(rt)->cond, &(rt)->lock, INFINITE)
+#define RT_SIGNAL(rt, cond) WakeConditionVariable(&(rt)->cond)
+#else
+#define RT_LOCK(rt)         pthread_mutex_lock(&(rt)->lock)
+#define RT_UNLOCK(rt)       pthread_mutex_unlock(&(rt)->lock)
+#define RT_WAIT(rt, cond)   pthread_cond_wait(&(rt)->cond, &(rt)->lock)
+#define RT_SIGNAL(rt, cond) pthread_cond_signal(&(rt)->cond)
+#endif
+
+/* Wait until render thread has read queue up to the specified position */
+static void render_thread_wait(render_thread_t *rt, uint32 pos)
+{
+  /* no need to lock if position was already reached */
+  if ((int32)(pos - rt->last_tail) <= 0)
+  {
+    return;
+  }
+
+  RT_LOCK(rt);
+  while ((int32)(pos - rt->tail) > 0)
+  {
+    /* wake up render thread if it waits for more jobs */
+    if (rt->idle)
+    {
+      RT_SIGNAL(rt, queued);
+    }
+
+    rt->waiting = 1;
+    RT_WAIT(rt, done);
+    rt->waiting = 0;
+  }
+  rt->last_tail = rt->tail;
+  RT_UNLOCK(rt);
+}
+
+static void render_thread_push(int type, int line, int offset, int width)
+{
+  render_thread_t *rt = render_thread;
+  render_job_t *job;
+  uint8 *data;
+  uint32 size, pos, left;
+  int i;
+
+  /* Sprites & patterns are only used when display is enabled (see process_line) */
+  int active = (type <= RENDER_JOB_SKIP) && (reg[1] & 0x40);
+  int sprites = active ? object_count[line & 1] : 0;
+  int names = active ? bg_list_index : 0;
+  int blocks = rt->full ? 0 : vram_block_index;
+  int palette = pixel_dirty | rt->full;
+
+  size = sizeof(render_job_t) + (palette ? PALETTE_SIZE : 0) + (sprites * sizeof(object_info_t));
+  size = (size + (blocks * 34) + (names * 3) + 7) & ~7;
+
+  /* Jobs are contiguous in queue */
+  pos = rt->head;
+  left = RENDER_QUEUE_SIZE - (pos & (RENDER_QUEUE_SIZE - 1));
+  if (left < size)
+  {
+    render_thread_wait(rt, pos + left + size - RENDER_QUEUE_SIZE);
+    if (left >= sizeof(render_job_t))
+    {
+      ((render_job_t *)&rt->queue[pos & (RENDER_QUEUE_SIZE - 1)])->type = RENDER_JOB_WRAP;
+    }
+    pos += left;
+  }
+  else
+  {
+    render_thread_wait(rt, pos + size - RENDER_QUEUE_SIZE);
+  }
+
+  job = (render_job_t *)&rt->queue[pos & (RENDER_QUEUE_SIZE - 1)];
+  job->size = size;
+  job->type = type;
+  job->full = rt->full;
+  job->palette = palette;
+  job->sprites = sprites;
+  job->blocks = blocks;
+  job->names = names;
+  job->line = line;
+  job->offset = offset;
+  job->width = width;
+
+  memcpy(job->reg, reg, sizeof(reg));
+  memcpy(job->vsram, vsram, sizeof(vsram));
+  job->ntab = ntab;
+  job->ntbb = ntbb;
+  job->ntwb = ntwb;
+  job->satb = satb;
+  job->hscb = hscb;
+  job->hscroll_mask = hscroll_mask;
+  job->playfield_shift = playfield_shift;
+  job->playfield_col_mask = playfield_col_mask;
+  job->playfield_row_mask = playfield_row_mask;
+  job->vscroll = vscroll;
+  job->status = status;
+  job->v_counter = v_counter;
+  job->odd_frame = odd_frame;
+  job->im2_flag = im2_flag;
+  job->interlaced = interlaced;
+  job->lines_per_frame = lines_per_frame;
+  job->max_sprite_pixels = max_sprite_pixels;
+  job->system_hw = system_hw;
+  job->ntsc = config.ntsc;
+  job->lcd = config.lcd;
+  job->gg_extra = config.gg_extra;
+  job->render = config.render;
+  job->bitmap = bitmap;
+
+  memcpy(job->clip, clip, sizeof(clip));
+  job->spr_ovr = spr_ovr;
+  job->render_bg = render_bg;
+  job->render_obj = render_obj;
+  job->parse_satb = parse_satb;
+  job->update_bg_pattern_cache = update_bg_pattern_cache;
+  job->vram = vram;
+  job->bg_pattern_cache = bg_pattern_cache;
+
+  data = (uint8 *)(job + 1);
+
+  /* Modified palette */
+  if (palette)
+  {
+    memcpy(data, pixel, sizeof(pixel));
+    data += sizeof(pixel);
+#ifdef USE_32BPP_OUTPUT
+    memcpy(data, pixel32, sizeof(pixel32));
+    data += sizeof(pixel32);
+#endif
+    pixel_dirty = 0;
+  }
+
+  /* Sprites of current line */
+  memcpy(data, obj_info[line & 1], sprites * sizeof(object_info_t));
+  data += sprites * sizeof(object_info_t);
+
+  /* Modified VRAM blocks */
+  for (i = 0; i < blocks; i++)
+  {
+    int index = vram_block_list[i];
+    memcpy(data, &vram[index << 5], 32);
+    data[32] = index;
+    data[33] = index >> 8;
+    data += 34;
+  }
+
+  /* Modified patterns (pattern cache is updated by process_line) */
+  for (i = 0; i < names; i++)
+  {
+    int name = bg_name_list[i];
+    data[0] = name;
+    data[1] = name >> 8;
+    data[2] = bg_name_dirty[name];
+    data += 3;
+  }
+
+  /* Clear modified VRAM blocks list */
+  for (i = 0; i < vram_block_index; i++)
+  {
+    vram_block_dirty[vram_block_list[i]] = 0;
+  }
+  vram_block_index = 0;
+
+  RT_LOCK(rt);
+  rt->head = pos + size;
+  if (rt->idle && (++rt->batch >= RENDER_BATCH))
+  {
+    RT_SIGNAL(rt, queued);
+  }
+  RT_UNLOCK(rt);
+
+  /* VRAM & pattern cache are read by render thread */
+  if (rt->full)
+  {
+    rt->full = 0;
+    render_thread_wait(rt, rt->head);
+  }
+}
+
+static void render_thread_load(render_job_t *job)
+{
+  uint8 *data = (uint8 *)(job + 1);
+  int i;
+
+  if (job->full)
+  {
+    memcpy(vram, job->vram, sizeof(vram));
+    memcpy(bg_pattern_cache, job->bg_pattern_cache, sizeof(bg_pattern_cache));
+    memset(bg_name_dirty, 0, sizeof(bg_name_dirty));
+    memset(linebuf, 0, sizeof(linebuf));
+    bg_list_index = 0;
+  }
+
+  memcpy(reg, job->reg, sizeof(reg));
+  memcpy(vsram, job->vsram, sizeof(vsram));
+  ntab = job->ntab;
+  ntbb = job->ntbb;
+  ntwb = job->ntwb;
+  satb = job->satb;
+  hscb = job->hscb;
+  hscroll_mask = job->hscroll_mask;
+  playfield_shift = job->playfield_shift;
+  playfield_col_mask = job->playfield_col_mask;
+  playfield_row_mask = job->playfield_row_mask;
+  vscroll = job->vscroll;
+  status = job->status;
+  v_counter = job->v_counter;
+  odd_frame = job->odd_frame;
+  im2_flag = job->im2_flag;
+  interlaced = job->interlaced;
+  lines_per_frame = job->lines_per_frame;
+  max_sprite_pixels = job->max_sprite_pixels;
+  system_hw = job->system_hw;
+  config.ntsc = job->ntsc;
+  config.lcd = job->lcd;
+  config.gg_extra = job->gg_extra;
+  config.render = job->render;
+  bitmap = job->bitmap;
+
+  memcpy(clip, job->clip, sizeof(clip));
+  spr_ovr = job->spr_ovr;
+  render_bg = job->render_bg;
+  render_obj = job->render_obj;
+  parse_satb = job->parse_satb;
+  update_bg_pattern_cache = job->update_bg_pattern_cache;
+
+  if (job->palette)
+  {
+    memcpy(pixel, data, sizeof(pixel));
+    data += sizeof(pixel);
+#ifdef USE_32BPP_OUTPUT
+    memcpy(pixel32, data, sizeof(pixel32));
+    data += sizeof(pixel32);
+#endif
+  }
+
+  memcpy(obj_info[job->line & 1], data, job->sprites * sizeof(object_info_t));
+  object_count[job->line & 1] = job->sprites;
+  data += job->sprites * sizeof(object_info_t);
+
+  for (i = 0; i < job->blocks; i++)
+  {
+    memcpy(&vram[(data[32] | (data[33] << 8)) << 5], data, 32);
+    data += 34;
+  }
+
+  for (i = 0; i < job->names; i++)
+  {
+    int name = data[0] | (data[1] << 8);
+    if (bg_name_dirty[name] == 0)
+    {
+      bg_name_list[bg_list_index++] = name;
+    }
+    bg_name_dirty[name] |= data[2];
+    data += 3;
+  }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI render_thread_main(LPVOID arg)
+#else
+static void *render_thread_main(void *arg)
+#endif
+{
+  render_thread_t *rt = (render_thread_t *)arg;
+  render_job_t *job;
+  uint32 pos;
+
+  RT_LOCK(rt);
+  for (;;)
+  {
+    while ((rt->tail == rt->head) && !rt->quit)
+    {
+      rt->idle = 1;
+      RT_WAIT(rt, queued);
+    }
+    rt->idle = 0;
+    rt->batch = 0;
+    if (rt->tail == rt->head)
+    {
+      break;
+    }
+    pos = rt->tail;
+    RT_UNLOCK(rt);
+
+    job = (render_job_t *)&rt->queue[pos & (RENDER_QUEUE_SIZE - 1)];
+    if (((RENDER_QUEUE_SIZE - (pos & (RENDER_QUEUE_SIZE - 1))) < sizeof(render_job_t)) || (job->type == RENDER_JOB_WRAP))
+    {
+      /* next job is at start of queue */
+      pos += RENDER_QUEUE_SIZE - (pos & (RENDER_QUEUE_SIZE - 1));
+      job = (render_job_t *)rt->queue;
+    }
+
+    render_thread_load(job);
+
+    switch (job->type)
+    {
+      case RENDER_JOB_LINE:
+        render_line(job->line);
+        break;
+      case RENDER_JOB_SKIP:
+        skip_line(job->line);
+        break;
+      case RENDER_JOB_BLANK:
+        blank_line(job->line, job->offset, job->width);
+        break;
+      default:
+        remap_line(job->line);
+        break;
+    }
+
+    RT_LOCK(rt);
+    rt->tail = pos + job->size;
+    if (rt->waiting)
+    {
+      RT_SIGNAL(rt, done);
+    }
+  }
+  RT_UNLOCK(rt);
+
+  return 0;
+}
+
+/* Start render thread (delay=1: each frame is completed while next frame is */
+/* emulated, frontend should then alternate between two bitmap buffers)     */
+int render_thread_start(int delay)
+{
+  render_thread_t *rt;
+
+  if (render_thread)
+  {
+    render_thread->delay = delay;
+    return 1;
+  }
+
+  rt = calloc(1, sizeof(render_thread_t));
+  if (!rt)
+  {
+    return 0;
+  }
+
+  rt->queue = malloc(RENDER_QUEUE_SIZE);
+  if (!rt->queue)
+  {
+    free(rt);
+    return 0;
+  }
+
+  rt->delay = delay;
+  rt->full = 1;
+
+#ifdef _WIN32
+  InitializeCriticalSection(&rt->lock);
+  InitializeConditionVariable(&rt->queued);
+  InitializeConditionVariable(&rt->done);
+  rt->thread = CreateThread(NULL, 0, render_thread_main, rt, 0, NULL);
+  if (!rt->thread)
+  {
+    DeleteCriticalSection(&rt->lock);
+#else
+  pthread_mutex_init(&rt->lock, NULL);
+  pthread_cond_init(&rt->queued, NULL);
+  pthread_cond_init(&rt->done, NULL);
+  if (pthread_create(&rt->thread, NULL, render_thread_main, rt))
+  {
+    pthread_cond_destroy(&rt->done);
+    pthread_cond_destroy(&rt->queued);
+    pthread_mutex_destroy(&rt->lock);
+#endif
+    free(rt->queue);
+    free(rt);
+    return 0;
+  }
+
+  render_thread = rt;
+  return 1;
+}
+
+void render_thread_stop(void)
+{
+  render_thread_t *rt = render_thread;
+
+  if (!rt)
+  {
+    return;
+  }
+
+  RT_LOCK(rt);
+  rt->quit = 1;
+  RT_SIGNAL(rt, queued);
+  RT_UNLOCK(rt);
+
+#ifdef _WIN32
+  WaitForSingleObject(rt->thread, INFINITE);
+  CloseHandle(rt->thread);
+  DeleteCriticalSection(&rt->lock);
+#else
+  pthread_join(rt->thread, NULL);
+  pthread_cond_destroy(&rt->done);
+  pthread_cond_destroy(&rt->queued);
+  pthread_mutex_destroy(&rt->lock);
+#endif
+
+  free(rt->queue);
+  free(rt);
+  render_thread = NULL;
+}
+
+/* Wait for all queued lines */
+void render_thread_sync(void)
+{
+  if (render_thread)
+  {
+    render_thread_wait(render_thread, render_thread->head);
+  }
+}
+
+/* Called at the end of emulated frame */
+void render_thread_end_frame(void)
+{
+  render_thread_t *rt = render_thread;
+
+  if (rt)
+  {
+    if (rt->delay)
+    {
+      /* previous frame is complete */
+      render_thread_wait(rt, rt->frame_end);
+      rt->frame_end = rt->head;
+    }
+    else
+    {
+      render_thread_wait(rt, rt->head);
+    }
+  }
+}
+
+#endif /* USE_RENDER_THREAD */
+
+
+/*--------------------------------------------------------------------------*/
+/* Init, reset routines                                                     */
+/*--------------------------------------------------------------------------*/
+
+/* Select pixel layer merging & remapping functions, up to kernels when supported by build & CPU */
+/* Returns the selected ones; all of them render the same pixels (see headless/gxrenderbench.c) */
+int render_kernels(int kernels)
+{
+  /* Look-up tables */
+  merge_bg[0] = merge_bg_c;
+  merge_bg[1] = merge_bg_ste_c;
+  merge_obj_ste = merge_obj_ste_c;
+  remap_pixels = remap_pixels_c;
+#ifdef USE_32BPP_OUTPUT
+  remap_pixels32 = remap_pixels32_c;
+#endif
+
+#ifdef USE_SIMD_RENDERING
+  if (kernels == RENDER_KERNEL_LUT)
+  {
+    return RENDER_KERNEL_LUT;
+  }
+
+  merge_bg[0] = merge_bg_sse2;
+  merge_bg[1] = merge_bg_ste_sse2;
+  merge_obj_ste = merge_obj_ste_sse2;
+  if ((kernels == RENDER_KERNEL_SSE2) || !cpu_has_avx2())
+  {
+    return RENDER_KERNEL_SSE2;
+  }
+
+  merge_bg[0] = merge_bg_avx2;
+  merge_bg[1] = merge_bg_ste_avx2;
+  merge_obj_ste = merge_obj_ste_avx2;
+#if defined(USE_15BPP_RENDERING) || defined(USE_16BPP_RENDERING) || defined(USE_32BPP_RENDERING)
+  remap_pixels = remap_pixels_avx2;
+#endif
+#ifdef USE_32BPP_OUTPUT
+  remap_pixels32 = remap_pixels32_avx2;
+#endif
+  return RENDER_KERNEL_AVX2;
+#else
+  return RENDER_KERNEL_LUT;
+#endif
+}
+
+/* Merge two pixel line buffers like render_line does with the selected functions */
+void render_merge(int type, uint8 *srca, uint8 *srcb, uint8 *dst, int width)
+{
+  if (type == RENDER_MERGE_OBJ_STE)
+  {
+    merge_obj_ste(srca, srcb, dst, width);
+  }
+  else
+  {
+    merge_bg[type](srca, srcb, dst, width);
+  }
+}
+
 void render_init(void)
 {
   int bx, ax;
@@ -4074,6 +5261,9 @@ void render_init(void)
   /* Initialize pixel color look-up tables */
   palette_init();
 
+  /* Select fastest pixel layer merging & remapping functions */
+  render_kernels(RENDER_KERNEL_AVX2);
+
   /* Make sprite pattern name index look-up table (Mode 5) */
   make_name_lut();
 
@@ -4081,19 +5271,35 @@ void render_init(void)
   make_bp_lut();
 }
 
-void render_reset(void)
+void render_reset(int hot)
 {
-  /* Clear display bitmap */
-  memset(bitmap.data, 0, bitmap.pitch * bitmap.height);
+#ifdef USE_RENDER_THREAD
+  /* wait for queued lines, VRAM & pattern cache are copied again on next line */
+  if (render_thread)
+  {
+    render_thread_sync();
+    render_thread->full = 1;
+  }
+#endif
+
+  /* display bitmap and pattern cache are kept on hot savestate loads */
+  if (!hot)
+  {
+    /* Clear display bitmap */
+    memset(bitmap.data, 0, bitmap.pitch * bitmap.height);
+
+    /* Clear pattern cache */
+    memset ((char *) bg_pattern_cache, 0, sizeof (bg_pattern_cache));
+  }
 
   /* Clear line buffers */
   memset(linebuf, 0, sizeof(linebuf));
 
   /* Clear color palettes */
   memset(pixel, 0, sizeof(pixel));
-
-  /* Clear pattern cache */
-  memset ((char *) bg_pattern_cache, 0, sizeof (bg_pattern_cache));
+#ifdef USE_32BPP_OUTPUT
+  memset(pixel32, 0, sizeof(pixel32));
+#endif
 
   /* Reset Sprite infos */
   spr_ovr = spr_col = object_count[0] = object_count[1] = 0;
@@ -4104,8 +5310,59 @@ void render_reset(void)
 /* Line rendering functions                                                 */
 /*--------------------------------------------------------------------------*/
 
+/* Lines of skipped frames are not rendered, but sprites are still processed */
+/* (over a blank line) to keep VDP sprite overflow & collision flags.        */
+static void process_line(int line)
+{
+  /* Check display status */
+  if (reg[1] & 0x40)
+  {
+    /* Update pattern cache */
+    if (bg_list_index)
+    {
+      update_bg_pattern_cache(bg_list_index);
+      bg_list_index = 0;
+    }
+
+    /* Sprite pixel markers only */
+    memset(linebuf[0], 0, bitmap.viewport.w + 0x40);
+
+    /* Process sprite layer */
+    render_obj(line & 1);
+
+    /* Parse sprites for next line */
+    if (line < (bitmap.viewport.h - 1))
+    {
+      parse_satb(line);
+    }
+  }
+  else
+  {
+    /* Master System & Game Gear VDP specific */
+    if (system_hw < SYSTEM_MD)
+    {
+      /* Update SOVR flag */
+      status |= spr_ovr;
+      spr_ovr = 0;
+
+      /* Sprites are still parsed when display is disabled */
+      parse_satb(line);
+    }
+  }
+}
+
 void render_line(int line)
 {
+#ifdef USE_RENDER_THREAD
+  if (render_thread)
+  {
+    /* line is drawn by render thread, sprites are processed here */
+    render_thread_push(RENDER_JOB_LINE, line, 0, 0);
+    process_line(line);
+    return;
+  }
+#endif
+
   /* Check display status */
   if (reg[1] & 0x40)
   {
@@ -4165,8 +5422,28 @@ void render_line(int line)
   remap_line(line);
 }
 
+void skip_line(int line)
+{
+#ifdef USE_RENDER_THREAD
+  if (render_thread)
+  {
+    render_thread_push(RENDER_JOB_SKIP, line, 0, 0);
+  }
+#endif
+
+  process_line(line);
+}
+
 void blank_line(int line, int offset, int width)
 {
+#ifdef USE_RENDER_THREAD
+  if (render_thread)
+  {
+    render_thread_push(RENDER_JOB_BLANK, line, offset, width);
+    return;
+  }
+#endif
+
   memset(&linebuf[0][0x20 + offset], 0x40, width);
   remap_line(line);
 }
@@ -4179,6 +5456,14 @@ void remap_line(int line)
   /* Pixel line buffer */
   uint8 *src = &linebuf[0][0x20 - bitmap.viewport.x];
 
+#ifdef USE_RENDER_THREAD
+  if (render_thread)
+  {
+    render_thread_push(RENDER_JOB_REMAP, line, 0, 0);
+    return;
+  }
+#endif
+
   /* Adjust line offset in framebuffer */
   line = (line + bitmap.viewport.y) % lines_per_frame;
 
@@ -4191,9 +5476,12 @@ void remap_line(int line)
     line = (line * 2) + odd_frame;
   }
 
+  /* Take care of output bitmap smaller than display (e.g. frontend framebuffer sized for previous display mode) */
+  if (line >= bitmap.height) return;
+
 #if defined(USE_15BPP_RENDERING) || defined(USE_16BPP_RENDERING)
   /* NTSC Filter (only supported for 15 or 16-bit pixels rendering) */
-  if (config.ntsc)
+  if (config.ntsc && (bitmap.bpp != 32))
   {
     if (reg[12] & 0x01)
     {
@@ -4210,23 +5498,43 @@ void remap_line(int line)
 #ifdef CUSTOM_BLITTER
     CUSTOM_BLITTER(line, width, pixel, src)
 #else
-    /* Convert VDP pixel data to output pixel format */
-    PIXEL_OUT_T *dst = ((PIXEL_OUT_T *)&bitmap.data[(line * bitmap.pitch)]);
-    if (config.lcd)
+    /* Line is cut to output bitmap width as well */
+    if (width > bitmap.width)
     {
-      do
+      width = bitmap.width;
+    }
+
+#ifdef USE_32BPP_OUTPUT
+    /* Convert VDP pixel data to XRGB8888 format */
+    if (bitmap.bpp == 32)
+    {
+      uint32 *dst = ((uint32 *)&bitmap.data[(line * bitmap.pitch)]);
+      if (config.lcd)
+      {
+        remap_pixels32_lcd(dst, src, width, config.lcd);
+      }
+      else
       {
-        RENDER_PIXEL_LCD(src,dst,pixel,config.lcd);
+        remap_pixels32(dst, src, width);
       }
-      while (--width);
     }
     else
+#endif
     {
-      do
+      /* Convert VDP pixel data to output pixel format */
+      PIXEL_OUT_T *dst = ((PIXEL_OUT_T *)&bitmap.data[(line * bitmap.pitch)]);
+      if (config.lcd)
+      {
+        do
+        {
+          RENDER_PIXEL_LCD(src,dst,pixel,config.lcd);
+        }
+        while (--width);
+      }
+      else
       {
-        *dst++ = pixel[*src++];
+        remap_pixels(dst, src, width);
       }
-      while (--width);
     }
  #endif
   }
@@ -103,13 +103,26 @@ extern "C" {
   *out++ = PIXEL(r,g,b); \
 }
 
+/* Pixel layer merging & remapping functions (see render_kernels) */
+#define RENDER_KERNEL_LUT   0 /* look-up tables */
+#define RENDER_KERNEL_SSE2  1
+#define RENDER_KERNEL_AVX2  2
+
+/* Layer merging (see render_merge) */
+#define RENDER_MERGE_BG      0 /* Plane A & Plane B */
+#define RENDER_MERGE_BG_STE  1 /* Plane A & Plane B, shadow / highlight mode */
+#define RENDER_MERGE_OBJ_STE 2 /* Sprites & Background, shadow / highlight mode */
+
 /* Global variables */
-extern uint16 spr_col;
+extern MACHINE_LOCAL uint16 spr_col;
 
 /* Function prototypes */
 extern void render_init(void);
-extern void render_reset(void);
+extern int render_kernels(int kernels);
+extern void render_merge(int type, uint8 *srca, uint8 *srcb, uint8 *dst, int width);
+extern void render_reset(int hot);
 extern void render_line(int line);
+extern void skip_line(int line);
 extern void blank_line(int line, int offset, int width);
 extern void remap_line(int line);
 extern void window_clip(unsigned int data, unsigned int sw);
@@ -138,12 +151,18 @@ extern void update_bg_pattern_cache_m4(int index);
 extern void update_bg_pattern_cache_m5(int index);
 extern void color_update_m4(int index, unsigned int data);
 extern void color_update_m5(int index, unsigned int data);
+#ifdef USE_RENDER_THREAD
+extern int render_thread_start(int delay);
+extern void render_thread_stop(void);
+extern void render_thread_sync(void);
+extern void render_thread_end_frame(void);
+#endif
 
 /* Function pointers */
-extern void (*render_bg)(int line);
-extern void (*render_obj)(int line);
-extern void (*parse_satb)(int line);
-extern void (*update_bg_pattern_cache)(int index);
+extern MACHINE_LOCAL void (*render_bg)(int line);
+extern MACHINE_LOCAL void (*render_obj)(int line);
+extern MACHINE_LOCAL void (*parse_satb)(int line);
+extern MACHINE_LOCAL void (*update_bg_pattern_cache)(int index);
 
 #ifdef __cplusplus
 }
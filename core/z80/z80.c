@@ -204,22 +204,22 @@
 
 #ifdef Z80_OVERCLOCK_SHIFT
 #define USE_CYCLES(A) Z80.cycles += ((A) * z80_cycle_ratio) >> Z80_OVERCLOCK_SHIFT
-UINT32 z80_cycle_ratio;
+MACHINE_LOCAL UINT32 z80_cycle_ratio;
 #else
 #define USE_CYCLES(A) Z80.cycles += (A)
 #endif
 
-Z80_Regs Z80;
+MACHINE_LOCAL Z80_Regs Z80;
 
-unsigned char *z80_readmap[64];
-unsigned char *z80_writemap[64];
+MACHINE_LOCAL unsigned char *z80_readmap[64];
+MACHINE_LOCAL unsigned char *z80_writemap[64];
 
-void (*z80_writemem)(unsigned int address, unsigned char data);
-unsigned char (*z80_readmem)(unsigned int address);
-void (*z80_writeport)(unsigned int port, unsigned char data);
-unsigned char (*z80_readport)(unsigned int port);
+MACHINE_LOCAL void (*z80_writemem)(unsigned int address, unsigned char data);
+MACHINE_LOCAL unsigned char (*z80_readmem)(unsigned int address);
+MACHINE_LOCAL void (*z80_writeport)(unsigned int port, unsigned char data);
+MACHINE_LOCAL unsigned char (*z80_readport)(unsigned int port);
 
-static UINT32 EA;
+static MACHINE_LOCAL UINT32 EA;
 
 static UINT8 SZ[256];       /* zero and sign flags */
 static UINT8 SZ_BIT[256];   /* zero, sign and parity/overflow (=zero) flags for BIT opcode */
@@ -655,13 +655,12 @@ INLINE void WM16( UINT32 addr, PAIR *r )
  * ROP() is identical to RM() except it is used for
  * reading opcodes. In case of system with memory mapped I/O,
  * this function can be used to greatly speed up emulation
+ *
+ * Opcode fetches are macros rather than INLINE functions: the
+ * compiler stops inlining them into the big dispatch switch,
+ * which then pays a call for every opcode and argument byte.
  ***************************************************************/
-INLINE UINT8 ROP(void)
-{
-  unsigned pc = PCD;
-  PC++;
-  return cpu_readop(pc);
-}
+#define ROP() (PC++, cpu_readop((UINT16)(PC - 1)))
 
 /****************************************************************
  * ARG() is identical to ROP() except it is used
@@ -669,19 +668,9 @@ INLINE UINT8 ROP(void)
  * support systems that use different encoding mechanisms for
  * opcodes and opcode arguments
  ***************************************************************/
-INLINE UINT8 ARG(void)
-{
-  unsigned pc = PCD;
-  PC++;
-  return cpu_readop_arg(pc);
-}
+#define ARG() (PC++, cpu_readop_arg((UINT16)(PC - 1)))
 
-INLINE UINT32 ARG16(void)
-{
-  unsigned pc = PCD;
-  PC += 2;
-  return cpu_readop_arg(pc) | (cpu_readop_arg((pc+1)&0xffff) << 8);
-}
+#define ARG16() (PC += 2, (UINT32)(cpu_readop_arg((UINT16)(PC - 2)) | (cpu_readop_arg((UINT16)(PC - 1)) << 8)))
 
 /***************************************************************
  * Calculate the effective address EA of an opcode using
@@ -53,19 +53,19 @@ typedef struct
 }  Z80_Regs;
 
 
-extern Z80_Regs Z80;
+extern MACHINE_LOCAL Z80_Regs Z80;
 
 #ifdef Z80_OVERCLOCK_SHIFT
-extern UINT32 z80_cycle_ratio;
+extern MACHINE_LOCAL UINT32 z80_cycle_ratio;
 #endif
 
-extern unsigned char *z80_readmap[64];
-extern unsigned char *z80_writemap[64];
+extern MACHINE_LOCAL unsigned char *z80_readmap[64];
+extern MACHINE_LOCAL unsigned char *z80_writemap[64];
 
-extern void (*z80_writemem)(unsigned int address, unsigned char data);
-extern unsigned char (*z80_readmem)(unsigned int address);
-extern void (*z80_writeport)(unsigned int port, unsigned char data);
-extern unsigned char (*z80_readport)(unsigned int port);
+extern MACHINE_LOCAL void (*z80_writemem)(unsigned int address, unsigned char data);
+extern MACHINE_LOCAL unsigned char (*z80_readmem)(unsigned int address);
+extern MACHINE_LOCAL void (*z80_writeport)(unsigned int port, unsigned char data);
+extern MACHINE_LOCAL unsigned char (*z80_readport)(unsigned int port);
 
 extern void z80_init(const void *config, int (*irqcallback)(int));
 extern void z80_reset (void);
@@ -182,7 +182,7 @@ void run_gui()
     create_hex_editor();
 #endif
 
-    set_cpu_hook(process_breakpoints);
+    set_cpu_hook(process_breakpoints, get_breakpoints_hook_mask());
     dbg_active = 1;
 
 #ifdef _WIN32
@@ -209,7 +209,7 @@ void stop_gui()
 #endif
 
     dbg_active = 0;
-    set_cpu_hook(NULL);
+    set_cpu_hook(NULL, HOOK_ANY);
 
 #ifdef _WIN32
     disable_visual_styles();
@@ -0,0 +1,50 @@
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "shared.h"
+#include "md_ntsc.h"
+#include "sms_ntsc.h"
+
+// Frontend data and callbacks expected by the core (see libretro.c), shared
+// by the headless tools. Each tool provides its own osd_input_update().
+
+jmp_buf jmp_env;
+md_ntsc_t *md_ntsc;
+sms_ntsc_t *sms_ntsc;
+
+char GG_ROM[256];
+char AR_ROM[256];
+char SK_ROM[256];
+char SK_UPMEM[256];
+char MD_BIOS[256];
+char GG_BIOS[256];
+char CD_BIOS_EU[256];
+char CD_BIOS_US[256];
+char CD_BIOS_JP[256];
+char MS_BIOS_US[256];
+char MS_BIOS_EU[256];
+char MS_BIOS_JP[256];
+
+int load_archive(char *filename, unsigned char *buffer, int maxsize, char *extension)
+{
+    FILE *fd;
+    int size;
+
+    if (extension) {
+        memcpy(extension, &filename[strlen(filename) - 3], 3);
+        extension[3] = 0;
+    }
+
+    fd = fopen(filename, "rb");
+    if (!fd)
+        return 0;
+
+    size = (int)fread(buffer, 1, maxsize, fd);
+    fclose(fd);
+    return size;
+}
+
+void ROMCheatUpdate(void)
+{
+}
@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "shared.h"
+#include "md_ntsc.h"
+#include "sms_ntsc.h"
+
+// Headless batch runner: runs each ROM for a number of frames with scripted
+// input and prints per-frame CRCs of the video and audio output as JSON.
+//   gxbatch [-n frames] [-i script] [-b biosdir] [-j jobs] [-s] [-r] [-x] [-c interval] rom...
+//
+// -r draws lines in a separate render thread (builds with USE_RENDER_THREAD,
+// see vdp_render.c), output is the same.
+//
+// -x renders XRGB8888 pixels (bitmap.bpp = 32), video CRCs are then those of
+// a build with USE_32BPP_RENDERING.
+//
+// -c saves a checkpoint after every frame (see checkpoint.h) and applies it
+// to a state rebuilt from the previous ones, which is compared with
+// state_save() every interval frames. Checkpoint sizes, save time and
+// mismatches are added to the results.
+//
+// Each ROM runs in its own process, up to jobs at a time. Results are
+// printed in command line order once all ROMs are done. File accesses go
+// through the libretro VFS like the rest of the core (see osd.h), results
+// are written to file descriptors.
+//
+// Input script lines are "frame pad buttons": buttons (UP, DOWN, LEFT,
+// RIGHT, A, B, C, X, Y, Z, START, MODE, 1, 2, or a number) joined with '+',
+// or '-' to release. Buttons are held until the next line for that pad.
+
+#define SOUND_FREQUENCY 44100
+#define MAX_EVENTS 65536
+
+// Frontend data expected by the core (see frontend.c)
+extern md_ntsc_t *md_ntsc;
+extern sms_ntsc_t *sms_ntsc;
+
+typedef struct {
+    unsigned int frame;
+    unsigned int pad;
+    unsigned int buttons;
+} input_event_t;
+
+static const struct {
+    const char *name;
+    unsigned int mask;
+} button_names[] = {
+    { "UP", INPUT_UP }, { "DOWN", INPUT_DOWN }, { "LEFT", INPUT_LEFT }, { "RIGHT", INPUT_RIGHT },
+    { "A", INPUT_A }, { "B", INPUT_B }, { "C", INPUT_C }, { "X", INPUT_X }, { "Y", INPUT_Y }, { "Z", INPUT_Z },
+    { "START", INPUT_START }, { "MODE", INPUT_MODE }, { "1", INPUT_BUTTON1 }, { "2", INPUT_BUTTON2 },
+};
+
+static input_event_t *events;
+static int event_count, next_event;
+static uint16 pads[MAX_INPUTS];
+
+static uint32 screen[720 * 576];
+static int16 sound[4096 * 2];
+
+static struct {
+    uint8 *data, *rebuilt, *state;
+    checkpoint_chain_t chain;
+    unsigned long long bytes;
+    unsigned int count, verified, mismatches;
+    double seconds;
+} checkpoints;
+
+void osd_input_update(void)
+{
+    memcpy(input.pad, pads, sizeof(pads));
+}
+
+static double now_seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int parse_buttons(char *text, unsigned int *buttons)
+{
+    char *name;
+    size_t i;
+
+    *buttons = 0;
+    if (!strcmp(text, "-"))
+        return 1;
+
+    for (name = strtok(text, "+"); name; name = strtok(NULL, "+")) {
+        for (i = 0; i < sizeof(button_names) / sizeof(button_names[0]); ++i) {
+            if (!strcasecmp(name, button_names[i].name))
+                break;
+        }
+
+        if (i < sizeof(button_names) / sizeof(button_names[0]))
+            *buttons |= button_names[i].mask;
+        else if (name[0] >= '0' && name[0] <= '9')
+            *buttons |= strtoul(name, NULL, 0);
+        else
+            return 0;
+    }
+
+    return 1;
+}
+
+static int load_script(const char *path)
+{
+    char line[256], buttons[128];
+    int number = 0;
+    FILE *fd = fopen(path, "r");
+
+    if (!fd) {
+        dprintf(STDERR_FILENO, "%s: cannot open\n", path);
+        return 0;
+    }
+
+    events = malloc(MAX_EVENTS * sizeof(*events));
+    while (events && fgets(line, sizeof(line), fd)) {
+        input_event_t *event = &events[event_count];
+        ++number;
+
+        if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line))
+            continue;
+
+        if (event_count == MAX_EVENTS || sscanf(line, "%u %u %127s", &event->frame, &event->pad, buttons) != 3 ||
+            event->pad >= MAX_INPUTS || !parse_buttons(buttons, &event->buttons)) {
+            dprintf(STDERR_FILENO, "%s:%d: invalid input line\n", path, number);
+            fclose(fd);
+            return 0;
+        }
+        ++event_count;
+    }
+
+    fclose(fd);
+
+    // by frame, keeping the script order within a frame
+    if (events) {
+        int i, j;
+        for (i = 1; i < event_count; ++i) {
+            input_event_t event = events[i];
+            for (j = i; j > 0 && events[j - 1].frame > event.frame; --j)
+                events[j] = events[j - 1];
+            events[j] = event;
+        }
+    }
+
+    return events != NULL;
+}
+
+static void set_bios_paths(const char *bios, const char *rom)
+{
+    char dir[200];
+    const char *slash = strrchr(rom, '/');
+
+    // next to the ROM by default, as with the libretro system directory
+    if (bios)
+        snprintf(dir, sizeof(dir), "%s", bios);
+    else if (slash)
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - rom), rom);
+    else
+        snprintf(dir, sizeof(dir), ".");
+
+    snprintf(GG_ROM, sizeof(GG_ROM), "%s/ggenie.bin", dir);
+    snprintf(AR_ROM, sizeof(AR_ROM), "%s/areplay.bin", dir);
+    snprintf(SK_ROM, sizeof(SK_ROM), "%s/sk.bin", dir);
+    snprintf(SK_UPMEM, sizeof(SK_UPMEM), "%s/sk2chip.bin", dir);
+    snprintf(MD_BIOS, sizeof(MD_BIOS), "%s/bios_MD.bin", dir);
+    snprintf(GG_BIOS, sizeof(GG_BIOS), "%s/bios.gg", dir);
+    snprintf(MS_BIOS_EU, sizeof(MS_BIOS_EU), "%s/bios_E.sms", dir);
+    snprintf(MS_BIOS_US, sizeof(MS_BIOS_US), "%s/bios_U.sms", dir);
+    snprintf(MS_BIOS_JP, sizeof(MS_BIOS_JP), "%s/bios_J.sms", dir);
+    snprintf(CD_BIOS_EU, sizeof(CD_BIOS_EU), "%s/bios_CD_E.bin", dir);
+    snprintf(CD_BIOS_US, sizeof(CD_BIOS_US), "%s/bios_CD_U.bin", dir);
+    snprintf(CD_BIOS_JP, sizeof(CD_BIOS_JP), "%s/bios_CD_J.bin", dir);
+}
+
+// Same defaults as the libretro frontend (see config_default)
+static void config_default(void)
+{
+    int i;
+
+    config.psg_preamp = 150;
+    config.fm_preamp = 100;
+    config.hq_fm = 1;
+    config.hq_psg = 1;
+    config.lp_range = 0x7fff;
+    config.low_freq = 880;
+    config.high_freq = 5000;
+    config.lg = 100;
+    config.mg = 100;
+    config.hg = 100;
+    config.ym2612 = YM2612_DISCRETE;
+    config.ym2413 = 2;
+    config.addr_error = 1;
+#ifdef HAVE_OVERCLOCK
+    config.overclock = 100;
+#endif
+
+    input.system[0] = SYSTEM_GAMEPAD;
+    input.system[1] = SYSTEM_GAMEPAD;
+    for (i = 0; i < MAX_INPUTS; ++i)
+        config.input[i].padtype = DEVICE_PAD2B | DEVICE_PAD3B | DEVICE_PAD6B;
+}
+
+static const char *system_name(void)
+{
+    switch (system_hw) {
+    case SYSTEM_SG:
+    case SYSTEM_SGII:
+        return "SG";
+    case SYSTEM_MARKIII:
+    case SYSTEM_SMS:
+    case SYSTEM_SMS2:
+        return "SMS";
+    case SYSTEM_GG:
+    case SYSTEM_GGMS:
+        return "GG";
+    case SYSTEM_PBC:
+        return "MD+SMS";
+    case SYSTEM_PICO:
+        return "PICO";
+    case SYSTEM_MCD:
+        return "MCD";
+    default:
+        return svp ? "SVP" : "MD";
+    }
+}
+
+static void print_string(int out, const char *text)
+{
+    dprintf(out, "\"");
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\')
+            dprintf(out, "\\%c", *text);
+        else if ((unsigned char)*text < 0x20)
+            dprintf(out, "\\u%04x", *text);
+        else
+            dprintf(out, "%c", *text);
+    }
+    dprintf(out, "\"");
+}
+
+static int init_checkpoints(void)
+{
+    checkpoints.data = malloc(CHECKPOINT_MAX_SIZE);
+    checkpoints.rebuilt = malloc(STATE_SIZE);
+    checkpoints.state = malloc(STATE_SIZE);
+    return checkpoints.data && checkpoints.rebuilt && checkpoints.state;
+}
+
+static void save_checkpoint(unsigned int frame, unsigned int interval)
+{
+    double start = now_seconds();
+    int size = checkpoint_save(checkpoints.data, 0);
+
+    checkpoints.seconds += now_seconds() - start;
+    checkpoints.bytes += size;
+    checkpoints.count++;
+
+    if (!size || !checkpoint_apply(&checkpoints.chain, checkpoints.rebuilt, checkpoints.data, size)) {
+        checkpoints.mismatches++;
+        return;
+    }
+
+    if ((frame + 1) % interval == 0) {
+        size = state_save(checkpoints.state);
+        if (size != checkpoints.chain.size || memcmp(checkpoints.state, checkpoints.rebuilt, size))
+            checkpoints.mismatches++;
+        checkpoints.verified++;
+    }
+}
+
+// Displayed area, as sent to the libretro video callback
+static unsigned long frame_crc(void)
+{
+    int width = bitmap.viewport.w + 2 * bitmap.viewport.x;
+    int height = bitmap.viewport.h + 2 * bitmap.viewport.y;
+    unsigned long crc = 0;
+    int y;
+
+    for (y = 0; y < height; ++y)
+        crc = crc32(crc, bitmap.data + y * bitmap.pitch, width * (bitmap.bpp == 32 ? 4 : 2));
+
+    return crc;
+}
+
+static void run_rom(int out, char *path, unsigned int frames, int summary, int threaded, int xrgb8888, unsigned int checkpoint)
+{
+    unsigned long video = 0, audio = 0;
+    unsigned long long samples = 0;
+    double start, elapsed = 0;
+    unsigned int frame;
+
+    sms_ntsc = calloc(1, sizeof(sms_ntsc_t));
+    md_ntsc = calloc(1, sizeof(md_ntsc_t));
+
+    bitmap.width = 720;
+    bitmap.height = 576;
+    bitmap.pitch = 720 * (xrgb8888 ? 4 : 2);
+    bitmap.bpp = xrgb8888 ? 32 : 0;
+    bitmap.data = (uint8 *)screen;
+    config_default();
+
+    dprintf(out, "{\"rom\": ");
+    print_string(out, path);
+
+    if (load_rom(path) <= 0) {
+        dprintf(out, ", \"error\": \"cannot load\"}");
+        return;
+    }
+
+    audio_init(SOUND_FREQUENCY, 0);
+    system_init();
+    system_reset();
+
+    if (checkpoint && !init_checkpoints()) {
+        dprintf(out, ", \"error\": \"cannot allocate checkpoints\"}");
+        return;
+    }
+
+#ifdef USE_RENDER_THREAD
+    if (threaded && !render_thread_start(0)) {
+        dprintf(out, ", \"error\": \"cannot start render thread\"}");
+        return;
+    }
+#else
+    (void)threaded;
+#endif
+
+    dprintf(out, ", \"system\": \"%s\", \"pal\": %d", system_name(), vdp_pal);
+    if (!summary)
+        dprintf(out, ", \"crc\": [");
+
+    for (frame = 0; frame < frames; ++frame) {
+        int count;
+
+        while (next_event < event_count && events[next_event].frame <= frame) {
+            pads[events[next_event].pad] = events[next_event].buttons;
+            ++next_event;
+        }
+
+        start = now_seconds();
+        if (system_hw == SYSTEM_MCD)
+            system_frame_scd(0);
+        else if ((system_hw & SYSTEM_PBC) == SYSTEM_MD)
+            system_frame_gen(0);
+        else
+            system_frame_sms(0);
+        count = audio_update(sound);
+        elapsed += now_seconds() - start;
+
+        samples += count;
+        audio = crc32(audio, (const unsigned char *)sound, count * 4);
+
+        if (checkpoint)
+            save_checkpoint(frame, checkpoint);
+
+        if (!summary) {
+            video = frame_crc();
+            dprintf(out, "%s[\"%08lx\", \"%08lx\"]", frame ? ", " : "", video, crc32(0, (const unsigned char *)sound, count * 4));
+        }
+    }
+
+#ifdef USE_RENDER_THREAD
+    render_thread_stop();
+#endif
+
+    if (summary)
+        video = frame_crc();
+    else
+        dprintf(out, "]");
+
+    dprintf(out, ", \"frames\": %u, \"samples\": %llu, \"video\": \"%08lx\", \"audio\": \"%08lx\", \"seconds\": %.6f, \"fps\": %.1f",
+        frames, samples, video, audio, elapsed, elapsed > 0 ? frames / elapsed : 0.0);
+
+    if (checkpoint)
+        dprintf(out, ", \"checkpoints\": %u, \"checkpoint_bytes\": %llu, \"checkpoint_seconds\": %.6f, \"verified\": %u, \"mismatches\": %u",
+            checkpoints.count, checkpoints.bytes, checkpoints.seconds, checkpoints.verified, checkpoints.mismatches);
+    dprintf(out, "}");
+}
+
+int main(int argc, char **argv)
+{
+    const char *bios = NULL;
+    unsigned int frames = 600;
+    unsigned int checkpoint = 0;
+    int jobs = 1, summary = 0, threaded = 0, xrgb8888 = 0, running = 0, first, count, i;
+    int *results;
+    pid_t *pids;
+    int *status;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            frames = (unsigned int)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            if (!load_script(argv[++i]))
+                return 1;
+        } else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            bios = argv[++i];
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s"))
+            summary = 1;
+#ifdef USE_RENDER_THREAD
+        else if (!strcmp(argv[i], "-r"))
+            threaded = 1;
+#endif
+        else if (!strcmp(argv[i], "-x"))
+            xrgb8888 = 1;
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            checkpoint = (unsigned int)strtoul(argv[++i], NULL, 0);
+        else
+            break;
+    }
+
+    first = i;
+    count = argc - first;
+    if (count <= 0 || jobs < 1 || (i < argc && argv[i][0] == '-')) {
+        dprintf(STDERR_FILENO, "usage: gxbatch [-n frames] [-i script] [-b biosdir] [-j jobs] [-s] [-r] [-x] [-c interval] rom...\n");
+        return 1;
+    }
+
+    results = calloc(count, sizeof(*results));
+    pids = calloc(count, sizeof(*pids));
+    status = calloc(count, sizeof(*status));
+    if (!results || !pids || !status)
+        return 1;
+
+    for (i = 0; i <= count; ++i) {
+        char name[64];
+
+        // next ROM once a job is done, or all remaining jobs at the end
+        while (running && (running == jobs || i == count)) {
+            int result, j;
+            pid_t pid = wait(&result);
+
+            for (j = 0; j < i; ++j) {
+                if (pids[j] == pid)
+                    status[j] = result;
+            }
+            --running;
+        }
+
+        if (i == count)
+            break;
+
+        strcpy(name, P_tmpdir "/gxbatchXXXXXX");
+        results[i] = mkstemp(name);
+        if (results[i] < 0) {
+            perror(name);
+            return 1;
+        }
+        unlink(name);
+
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            perror("fork");
+            return 1;
+        }
+
+        if (!pids[i]) {
+            set_bios_paths(bios, argv[first + i]);
+            run_rom(results[i], argv[first + i], frames, summary, threaded, xrgb8888, checkpoint);
+            _exit(0);
+        }
+        ++running;
+    }
+
+    dprintf(STDOUT_FILENO, "[\n");
+    for (i = 0; i < count; ++i) {
+        char buffer[65536];
+        ssize_t size;
+
+        if (!WIFEXITED(status[i]) || WEXITSTATUS(status[i])) {
+            dprintf(STDOUT_FILENO, "{\"rom\": ");
+            print_string(STDOUT_FILENO, argv[first + i]);
+            dprintf(STDOUT_FILENO, ", \"error\": \"crashed\"}");
+        } else {
+            lseek(results[i], 0, SEEK_SET);
+            while ((size = read(results[i], buffer, sizeof(buffer))) > 0)
+                write(STDOUT_FILENO, buffer, size);
+        }
+        dprintf(STDOUT_FILENO, "%s\n", (i + 1 < count) ? "," : "");
+        close(results[i]);
+    }
+    dprintf(STDOUT_FILENO, "]\n");
+
+    return 0;
+}
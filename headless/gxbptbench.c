@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "shared.h"
+#include "debug.h"
+
+// Breakpoint lookup benchmark: measures the cost of one M68K memory access
+// reaching the debugger (process_breakpoints() -> check_breakpoint(), as
+// installed by set_cpu_hook()) with 0, 10, 100 and 1000 watchpoints.
+//   gxbptbench
+//
+// Accesses are half ROM reads, half work RAM reads and writes of 1, 2 and
+// 4 bytes, none of them hits a breakpoint. Watchpoints are spread over the
+// upper half of work RAM ("apart", accesses stay in the lower half) or over
+// the same half as the accesses ("shared", every block holding one has to
+// be checked against the list). Each configuration replays the accesses
+// for at least half a second.
+
+#define ACCESSES 0x100000
+#define CELL 0x20 // one watchpoint per cell at offset 0x10, accesses below
+
+typedef struct {
+    bpt_type_t type;
+    int width;
+    unsigned int address;
+} access_t;
+
+static access_t accesses[ACCESSES];
+
+void osd_input_update(void)
+{
+}
+
+static double now_seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static unsigned int next_random(unsigned int *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static void make_accesses(void)
+{
+    static const int widths[3] = { 1, 2, 4 };
+    unsigned int seed = 0x12345678;
+
+    for (int i = 0; i < ACCESSES; ++i) {
+        unsigned int r = next_random(&seed);
+        int width = widths[r % 3];
+
+        accesses[i].width = width;
+        if (r & 0x100) {
+            accesses[i].type = BPT_M68K_R;
+            accesses[i].address = (next_random(&seed) & 0x3FFFFF) & ~(width - 1);
+        } else {
+            // below offset 0x10 of a cell in 0xFF0000-0xFF7FFF
+            unsigned int cell = next_random(&seed) & 0x7FFF & ~(CELL - 1);
+            unsigned int offset = (next_random(&seed) % 0x0C) & ~(width - 1);
+
+            accesses[i].type = (r & 0x200) ? BPT_M68K_W : BPT_M68K_R;
+            accesses[i].address = 0xFF0000 | cell | offset;
+        }
+    }
+}
+
+static void set_breakpoints(int count, unsigned int base)
+{
+    dbg_req_core->req_type = REQ_CLEAR_BREAKS;
+    process_request();
+
+    for (int i = 0; i < count; ++i) {
+        bpt_data_t *bpt_data = &dbg_req_core->bpt_data;
+
+        memset(bpt_data, 0, sizeof(*bpt_data));
+        bpt_data->type = BPT_M68K_RW;
+        bpt_data->address = base + ((i * 0x8000 / count) & ~(CELL - 1)) + 0x10;
+        bpt_data->width = 1;
+        bpt_data->enabled = 1;
+
+        dbg_req_core->req_type = REQ_ADD_BREAK;
+        process_request();
+    }
+}
+
+static double measure(void)
+{
+    double start = now_seconds(), elapsed;
+    double done = 0;
+
+    do {
+        for (int i = 0; i < ACCESSES; ++i)
+            process_breakpoints(accesses[i].type, accesses[i].width, accesses[i].address, 0);
+        done += ACCESSES;
+        elapsed = now_seconds() - start;
+    } while (elapsed < 0.5);
+
+    return elapsed * 1e9 / done;
+}
+
+int main(void)
+{
+    static const int counts[4] = { 0, 10, 100, 1000 };
+    int i;
+
+    // private request block, the benchmark does not publish a shared mapping
+    dbg_req_core = calloc(1, DBG_SHARED_MEM_SIZE);
+    if (!dbg_req_core)
+        return 1;
+    dbg_req_core->data_offset = DBG_SHARED_MEM_SIZE - DBG_DATA_SIZE;
+    dbg_req_core->data_size = DBG_DATA_SIZE;
+
+    start_debugging();
+    make_accesses();
+
+    printf("breakpoints  apart ns/access  shared ns/access\n");
+    for (i = 0; i < 4; ++i) {
+        double apart, shared;
+
+        set_breakpoints(counts[i], 0xFF8000);
+        apart = measure();
+        set_breakpoints(counts[i], 0xFF0000);
+        shared = measure();
+
+        printf("%11d  %15.2f  %16.2f\n", counts[i], apart, shared);
+    }
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shared.h"
+#include "md_ntsc.h"
+#include "sms_ntsc.h"
+
+// Layer merging & remapping kernels check and benchmark (see render_kernels()
+// in vdp_render.c).
+//   gxrenderbench [rom]
+//
+// Each merge of every kernel set available in this build and on this CPU
+// (SSE2, AVX2) is checked against the look-up tables for all 65536 pixel
+// pairs: in one call, split in calls of 1 to 64 pixels, and in place on
+// either source. Then a 320 pixel merge is timed for each kernel set.
+//
+// With a ROM, 60 frames are run, then the next frame's lines are drawn from
+// the saved state with render_line() and timed, as well as remap_line()
+// alone, with 16-bit and XRGB8888 output. The CRC of the drawn frame must
+// be the same for all kernel sets. Returns 1 on any mismatch.
+
+#define PAIRS 0x10000
+#define LINE_WIDTH 320
+#define WARMUP_FRAMES 60
+
+// Frontend data expected by the core (see frontend.c)
+extern md_ntsc_t *md_ntsc;
+extern sms_ntsc_t *sms_ntsc;
+
+static const char *kernel_names[3] = { "LUT", "SSE2", "AVX2" };
+static const char *merge_names[3] = { "bg", "bg_ste", "obj_ste" };
+
+static uint32 screen[720 * 576];
+static int16 sound[4096 * 2];
+static uint8 srca[PAIRS], srcb[PAIRS], ref[PAIRS], out[PAIRS];
+
+void osd_input_update(void)
+{
+}
+
+static double now_seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static unsigned int next_random(unsigned int *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+// kernel sets available besides the look-up tables, LUT selected on return
+static int kernel_count(void)
+{
+    int count = render_kernels(RENDER_KERNEL_AVX2) + 1;
+    render_kernels(RENDER_KERNEL_LUT);
+    return count;
+}
+
+static int mismatches(void)
+{
+    int count = 0;
+
+    for (int i = 0; i < PAIRS; ++i)
+        count += (out[i] != ref[i]);
+    return count;
+}
+
+static int check_merge(int kernels, int type)
+{
+    int errors, width;
+
+    render_kernels(kernels);
+
+    render_merge(type, srca, srcb, out, PAIRS);
+    errors = mismatches();
+
+    for (width = 1; width <= 64; ++width) {
+        for (int i = 0; i < PAIRS; i += width)
+            render_merge(type, srca + i, srcb + i, out + i, (PAIRS - i < width) ? PAIRS - i : width);
+        errors += mismatches();
+    }
+
+    memcpy(out, srca, PAIRS);
+    render_merge(type, out, srcb, out, PAIRS);
+    errors += mismatches();
+
+    // as called by render_line()
+    memcpy(out, srcb, PAIRS);
+    render_merge(type, srca, out, out, PAIRS);
+    errors += mismatches();
+
+    return errors;
+}
+
+static double time_merge(int type)
+{
+    uint8 a[LINE_WIDTH], b[LINE_WIDTH], dst[LINE_WIDTH];
+    unsigned int seed = 0x12345678;
+    double start = now_seconds(), elapsed;
+    long calls = 0;
+
+    for (int i = 0; i < LINE_WIDTH; ++i) {
+        a[i] = next_random(&seed);
+        b[i] = next_random(&seed);
+    }
+
+    do {
+        for (int i = 0; i < 1000; ++i)
+            render_merge(type, a, b, dst, LINE_WIDTH);
+        calls += 1000;
+        elapsed = now_seconds() - start;
+    } while (elapsed < 0.2);
+
+    return elapsed * 1e9 / calls;
+}
+
+static int load(char *path)
+{
+    int i;
+
+    sms_ntsc = calloc(1, sizeof(sms_ntsc_t));
+    md_ntsc = calloc(1, sizeof(md_ntsc_t));
+
+    bitmap.width = 720;
+    bitmap.height = 576;
+    bitmap.pitch = 720 * 4;
+    bitmap.data = (uint8 *)screen;
+
+    config.psg_preamp = 150;
+    config.fm_preamp = 100;
+    config.hq_fm = 1;
+    config.hq_psg = 1;
+    config.lp_range = 0x7fff;
+    config.low_freq = 880;
+    config.high_freq = 5000;
+    config.lg = 100;
+    config.mg = 100;
+    config.hg = 100;
+    config.ym2612 = YM2612_DISCRETE;
+    config.ym2413 = 2;
+#ifdef HAVE_OVERCLOCK
+    config.overclock = 100;
+#endif
+    input.system[0] = SYSTEM_GAMEPAD;
+    input.system[1] = SYSTEM_GAMEPAD;
+    for (i = 0; i < MAX_INPUTS; ++i)
+        config.input[i].padtype = DEVICE_PAD2B | DEVICE_PAD3B | DEVICE_PAD6B;
+
+    if (load_rom(path) <= 0)
+        return 0;
+
+    audio_init(44100, 0);
+    system_init();
+    system_reset();
+
+    for (i = 0; i < WARMUP_FRAMES; ++i) {
+        if (system_hw == SYSTEM_MCD)
+            system_frame_scd(0);
+        else if ((system_hw & SYSTEM_PBC) == SYSTEM_MD)
+            system_frame_gen(0);
+        else
+            system_frame_sms(0);
+        audio_update(sound);
+    }
+    return 1;
+}
+
+static unsigned long frame_crc(void)
+{
+    int width = bitmap.viewport.w + 2 * bitmap.viewport.x;
+    unsigned long crc = 0;
+
+    for (int y = 0; y < bitmap.viewport.h; ++y)
+        crc = crc32(crc, bitmap.data + (y + bitmap.viewport.y) * bitmap.pitch, width * (bitmap.bpp == 32 ? 4 : 2));
+    return crc;
+}
+
+// draws the frame following the saved state, returns the time spent in
+// render_line() or remap_line()
+static double draw_frame(unsigned char *state, int remap)
+{
+    double start;
+    int line;
+
+    state_load(state);
+    if (reg[1] & 0x40)
+        parse_satb(-1);
+
+    if (remap) {
+        for (line = 0; line < bitmap.viewport.h; ++line)
+            render_line(line);
+        start = now_seconds();
+        for (line = 0; line < bitmap.viewport.h; ++line)
+            remap_line(line);
+    } else {
+        start = now_seconds();
+        for (line = 0; line < bitmap.viewport.h; ++line)
+            render_line(line);
+    }
+
+    return now_seconds() - start;
+}
+
+static double time_lines(unsigned char *state, int remap)
+{
+    double elapsed = 0, start = now_seconds();
+    long lines = 0;
+
+    do {
+        elapsed += draw_frame(state, remap);
+        lines += bitmap.viewport.h;
+    } while (now_seconds() - start < 0.5);
+
+    return elapsed * 1e9 / lines;
+}
+
+static int bench_rom(char *path, int kernels)
+{
+    unsigned char *state = malloc(STATE_SIZE);
+    unsigned long crc[2] = { 0, 0 };
+    int errors = 0, k, bpp;
+
+    if (!state || !load(path)) {
+        printf("%s: cannot load\n", path);
+        return 1;
+    }
+    state_save(state);
+
+    printf("\n%s, %d lines\nkernels  output  render ns/line  remap ns/line  frame\n", path, bitmap.viewport.h);
+    for (k = 0; k < kernels; ++k) {
+        render_kernels(k);
+        for (bpp = 0; bpp < 2; ++bpp) {
+            unsigned long frame;
+            double render, remap;
+
+            bitmap.bpp = bpp ? 32 : 16;
+            draw_frame(state, 0);
+            frame = frame_crc();
+            if (!k)
+                crc[bpp] = frame;
+            errors += (frame != crc[bpp]);
+
+            render = time_lines(state, 0);
+            remap = time_lines(state, 1);
+            printf("%-7s  %6s  %14.1f  %13.1f  %08lx%s\n", kernel_names[k], bpp ? "XRGB" : "16-bit",
+                render, remap, frame, (frame != crc[bpp]) ? " MISMATCH" : "");
+        }
+    }
+
+    free(state);
+    return errors != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int kernels, errors = 0, k, type;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        dprintf(STDERR_FILENO, "usage: gxrenderbench [rom]\n");
+        return 1;
+    }
+
+    render_init();
+    kernels = kernel_count();
+
+    for (int i = 0; i < PAIRS; ++i) {
+        srca[i] = i & 0xFF;
+        srcb[i] = i >> 8;
+    }
+
+    printf("kernels  merge    mismatches  ns/%d px\n", LINE_WIDTH);
+    for (k = 0; k < kernels; ++k) {
+        for (type = 0; type < 3; ++type) {
+            int count = 0;
+
+            if (k) {
+                render_kernels(RENDER_KERNEL_LUT);
+                render_merge(type, srca, srcb, ref, PAIRS);
+                count = check_merge(k, type);
+                errors += count;
+            }
+
+            render_kernels(k);
+            printf("%-7s  %-7s  %10d  %9.1f\n", kernel_names[k], merge_names[type], count, time_merge(type));
+        }
+    }
+    fflush(stdout);
+
+    if (argc == 2)
+        errors += bench_rom(argv[1], kernels);
+
+    return errors != 0;
+}
@@ -0,0 +1,326 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "shared.h"
+#include "md_ntsc.h"
+#include "sms_ntsc.h"
+
+// Z80 core benchmark: times z80_run() alone over 0.1 s of emulated time, each
+// run starting from the same saved state.
+//   gxz80bench [-r runs] [-m mixes] [rom...]
+//
+// Each ROM runs 10 frames first (MD games have started their sound driver
+// by then), its state is saved and restored before every run. They follow
+// the generated SMS ROMs, 2 unless set with -m, built from seeds 1 to mixes:
+// a loop of 3000 random instructions, mostly CB/DD/ED/FD prefixed, working
+// on RAM at $C400-$C6FF. Runs defaults to 9.
+//
+// Prints the best and median run time in microseconds and a CRC of the Z80
+// registers, Z80 RAM and work RAM after a run, which only changes when the
+// Z80 core behaves differently. Each ROM runs in its own process.
+
+#define WARMUP_FRAMES 10
+#define MIX_LENGTH 3000
+#define MIX_START 0x100
+
+// Frontend data expected by the core (see frontend.c)
+extern md_ntsc_t *md_ntsc;
+extern sms_ntsc_t *sms_ntsc;
+
+static uint16 screen[720 * 576];
+static int16 sound[4096 * 2];
+static unsigned char rom[0x8000];
+
+void osd_input_update(void)
+{
+}
+
+static double now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static unsigned int next_random(unsigned int *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Appends one random instruction at *pc, returns the offset of a call
+// operand to patch or 0. HL, IX and IY are never modified, apart from
+// ADC/SBC HL which are followed by LD HL,$C400.
+static int emit_instruction(unsigned int *seed, int *pc)
+{
+    static const unsigned char regs[6] = { 0, 1, 2, 3, 7, 6 }; // b c d e a (hl)
+    unsigned char *p = &rom[*pc];
+    unsigned int r = next_random(seed);
+    unsigned int reg = regs[(r >> 8) % 5], regm = regs[(r >> 12) % 6];
+    unsigned int n = (r >> 16) & 0xFF, d = ((r >> 24) & 0x7F) - 0x40;
+    unsigned int xy = (r & 0x80000000) ? 0xFD : 0xDD;
+    int size = 1, call = 0;
+
+    switch (r % 22) {
+    case 0: p[0] = 0x40 | reg << 3 | regm; break; // ld r,r'
+    case 1: p[0] = 0x70 | reg; break; // ld (hl),r
+    case 2: p[0] = 0x80 | (n & 7) << 3 | regm; break; // alu a,r
+    case 3: p[0] = 0xC6 | (n & 7) << 3; p[1] = d; size = 2; break; // alu a,n
+    case 4: p[0] = 0x04 | regm << 3; break; // inc r
+    case 5: p[0] = 0x05 | regm << 3; break; // dec r
+    case 6: {
+        static const unsigned char ops[10] = { 0x07, 0x0F, 0x17, 0x1F, 0x27, 0x2F, 0x37, 0x3F, 0x08, 0x00 };
+        p[0] = ops[n % 10];
+        break;
+    }
+    case 7: p[0] = 0x06 | reg << 3; p[1] = n; size = 2; break; // ld r,n
+    case 8: p[0] = (n & 1) ? 0x11 : 0x01; p[1] = d; p[2] = n; size = 3; break; // ld bc/de,nn
+    case 9: p[0] = 0x03 | (n & 3) << 3; break; // inc/dec bc/de
+    case 10: {
+        static const unsigned char regs16[3] = { 0x00, 0x10, 0x30 }; // bc de af
+        p[0] = 0xC5 | regs16[n % 3]; // push
+        p[1] = 0xC1 | regs16[(n >> 2) % 3]; // pop
+        size = 2;
+        break;
+    }
+    case 11: p[0] = 0xCB; p[1] = (n & 0x38) | regm; size = 2; break; // rotate/shift
+    case 12: p[0] = 0xCB; p[1] = 0x40 | (n % 0xC0 & 0xF8) | regm; size = 2; break; // bit/res/set
+    case 13: p[0] = xy; p[1] = 0x46 | reg << 3; p[2] = d; size = 3; break; // ld r,(ix+d)
+    case 14: p[0] = xy; p[1] = 0x70 | reg; p[2] = d; size = 3; break; // ld (ix+d),r
+    case 15: p[0] = xy; p[1] = 0x86 | (n & 7) << 3; p[2] = d; size = 3; break; // alu a,(ix+d)
+    case 16: p[0] = xy; p[1] = (n & 1) ? 0x35 : 0x34; p[2] = d; size = 3; break; // inc/dec (ix+d)
+    case 17: p[0] = xy; p[1] = 0x36; p[2] = d; p[3] = n; size = 4; break; // ld (ix+d),n
+    case 18: p[0] = xy; p[1] = 0xCB; p[2] = d; p[3] = (n & 0xF8) | 6; size = 4; break; // ddcb
+    case 19: {
+        static const unsigned char ops[7] = { 0x44, 0x67, 0x6F, 0x47, 0x57, 0x4F, 0x5F }; // neg rrd rld ld i,a ld a,i ld r,a ld a,r
+        p[0] = 0xED; p[1] = ops[n % 7];
+        size = 2;
+        break;
+    }
+    case 20: p[0] = 0xED; p[1] = 0x42 | (n & 3) << 3; p[2] = 0x21; p[3] = 0x00; p[4] = 0xC4; size = 5; break; // adc/sbc hl,ss ; ld hl,$c400
+    default:
+        if (n & 1) {
+            p[0] = 0xCD; // call sub
+            call = *pc + 1;
+            size = 3;
+        } else {
+            p[0] = (n & 2) ? 0x18 : 0x20 | (n & 0x18); // jr +0, jr cc,+0
+            p[1] = 0;
+            size = 2;
+        }
+        break;
+    }
+
+    *pc += size;
+    return call;
+}
+
+static int make_mix(unsigned int seed, char *name)
+{
+    static int calls[MIX_LENGTH];
+    static const unsigned char start[] = {
+        0xF3, 0x31, 0xF0, 0xDF, 0xC3, MIX_START & 0xFF, MIX_START >> 8 // di ; ld sp,$dff0 ; jp start
+    };
+    static const unsigned char init[] = {
+        0xED, 0x56, 0x21, 0x00, 0xC4, 0xDD, 0x21, 0x00, 0xC5, 0xFD, 0x21, 0x00, 0xC6 // im 1 ; hl ix iy in RAM
+    };
+    int pc = MIX_START, loop, count = 0, i;
+    int fd, written;
+
+    memset(rom, 0, sizeof(rom));
+    memcpy(rom, start, sizeof(start));
+    rom[0x38] = 0xC9; // ret
+    rom[0x66] = 0xED; rom[0x67] = 0x45; // retn
+    memcpy(&rom[pc], init, sizeof(init));
+    pc += sizeof(init);
+
+    loop = pc;
+    for (i = 0; i < MIX_LENGTH; ++i) {
+        int call = emit_instruction(&seed, &pc);
+        if (call)
+            calls[count++] = call;
+    }
+    rom[pc++] = 0xC3; // jp loop
+    rom[pc++] = loop & 0xFF;
+    rom[pc++] = loop >> 8;
+    for (i = 0; i < count; ++i) {
+        rom[calls[i]] = pc & 0xFF;
+        rom[calls[i] + 1] = pc >> 8;
+    }
+    rom[pc++] = 0x3C; // inc a ; ret
+    rom[pc++] = 0xC9;
+
+    memcpy(&rom[0x7FF0], "TMR SEGA", 8);
+    rom[0x7FFF] = 0x4C;
+
+    strcpy(name, P_tmpdir "/gxz80benchXXXXXX.sms");
+    fd = mkstemps(name, 4);
+    if (fd < 0)
+        return 0;
+    // plain descriptor, FILE goes through the libretro VFS (see osd.h)
+    written = (int)write(fd, rom, sizeof(rom));
+    close(fd);
+    if (written != sizeof(rom)) {
+        unlink(name);
+        return 0;
+    }
+    return 1;
+}
+
+static int load(char *path)
+{
+    int i;
+
+    sms_ntsc = calloc(1, sizeof(sms_ntsc_t));
+    md_ntsc = calloc(1, sizeof(md_ntsc_t));
+
+    bitmap.width = 720;
+    bitmap.height = 576;
+    bitmap.pitch = 720 * 2;
+    bitmap.data = (uint8 *)screen;
+
+    config.psg_preamp = 150;
+    config.fm_preamp = 100;
+    config.hq_fm = 1;
+    config.hq_psg = 1;
+    config.lp_range = 0x7fff;
+    config.low_freq = 880;
+    config.high_freq = 5000;
+    config.lg = 100;
+    config.mg = 100;
+    config.hg = 100;
+    config.ym2612 = YM2612_DISCRETE;
+    config.ym2413 = 2;
+#ifdef HAVE_OVERCLOCK
+    config.overclock = 100;
+#endif
+    input.system[0] = SYSTEM_GAMEPAD;
+    input.system[1] = SYSTEM_GAMEPAD;
+    for (i = 0; i < MAX_INPUTS; ++i)
+        config.input[i].padtype = DEVICE_PAD2B | DEVICE_PAD3B | DEVICE_PAD6B;
+
+    if (load_rom(path) <= 0)
+        return 0;
+
+    audio_init(44100, 0);
+    system_init();
+    system_reset();
+    return 1;
+}
+
+static unsigned long state_crc(void)
+{
+    unsigned long crc = crc32(0, (const unsigned char *)&Z80, offsetof(Z80_Regs, daisy));
+    crc = crc32(crc, zram, sizeof(zram));
+    return crc32(crc, work_ram, sizeof(work_ram));
+}
+
+static int run(const char *name, char *path, int runs)
+{
+    unsigned char *state = malloc(STATE_SIZE);
+    double *times = malloc(runs * sizeof(*times));
+    unsigned int cycles;
+    int i;
+
+    if (!state || !times || !load(path)) {
+        printf("%s: cannot load\n", name);
+        return 1;
+    }
+
+    for (i = 0; i < WARMUP_FRAMES; ++i) {
+        if ((system_hw & SYSTEM_PBC) == SYSTEM_MD)
+            system_frame_gen(0);
+        else
+            system_frame_sms(0);
+        audio_update(sound);
+    }
+    state_save(state);
+    cycles = system_clock / 10;
+
+    for (i = 0; i < runs; ++i) {
+        double start;
+
+        state_load(state);
+        start = now_us();
+        z80_run(Z80.cycles + cycles);
+        times[i] = now_us() - start;
+    }
+
+    qsort(times, runs, sizeof(*times), compare_double);
+    printf("%-24s %9.0f %10.0f  %08lx\n", name, times[0], times[runs / 2], state_crc());
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 9, mixes = 2, result = 0, first, count, i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            mixes = atoi(argv[++i]);
+        else
+            break;
+    }
+
+    first = i;
+    count = argc - first;
+    if (runs < 1 || mixes < 0 || (i < argc && argv[i][0] == '-')) {
+        dprintf(STDERR_FILENO, "usage: gxz80bench [-r runs] [-m mixes] [rom...]\n");
+        return 1;
+    }
+
+    printf("%-24s %9s %10s  %s\n", "us per 0.1 s emulated", "best", "median", "state");
+    fflush(stdout);
+
+    // generated mixes first, then the ROMs
+    for (i = 0; i < mixes + count; ++i) {
+        int status;
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+
+        if (!pid) {
+            char name[64], path[64];
+
+            if (i < mixes) {
+                snprintf(name, sizeof(name), "mix %d", i + 1);
+                if (!make_mix(i + 1, path)) {
+                    printf("%s: cannot write ROM\n", name);
+                    _exit(1);
+                }
+                status = run(name, path, runs);
+                unlink(path);
+            } else {
+                const char *base = strrchr(argv[first + i - mixes], '/');
+                snprintf(name, sizeof(name), "%s", base ? base + 1 : argv[first + i - mixes]);
+                status = run(name, argv[first + i - mixes], runs);
+            }
+
+            fflush(stdout);
+            _exit(status);
+        }
+
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+            result = 1;
+    }
+
+    return result;
+}
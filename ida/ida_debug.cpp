@@ -34,7 +34,7 @@ static void stop_debugging()
 
 static eventlist_t g_events;
 static qthread_t events_thread = NULL;
-static qthread_t pc_map_thread = NULL;
+static qthread_t coverage_thread = NULL;
 
 static const char *const SRReg[] =
 {
@@ -172,12 +172,12 @@ static void finish_execution()
         events_thread = NULL;
     }
 
-    if (pc_map_thread != NULL)
+    if (coverage_thread != NULL)
     {
-        qthread_join(pc_map_thread);
-        qthread_free(pc_map_thread);
-        qthread_kill(pc_map_thread);
-        pc_map_thread = NULL;
+        qthread_join(coverage_thread);
+        qthread_free(coverage_thread);
+        qthread_kill(coverage_thread);
+        coverage_thread = NULL;
     }
 }
 
@@ -209,16 +209,13 @@ static drc_t idaapi term_debugger(void)
 
 static int idaapi check_debugger_events(void *ud)
 {
-    while (dbg_req && (dbg_req->dbg_active == 1 || dbg_req->dbg_events_count > 0))
+    while (dbg_req && (dbg_req->dbg_active == 1 || dbg_events_pending(dbg_req)))
     {
-        int event_index = recv_dbg_event_ida(dbg_req, 0);
-        if (event_index == -1)
-        {
-            qsleep(10);
+        debugger_event_t event;
+        if (!recv_dbg_event_ida(dbg_req, &event, 1))
             continue;
-        }
 
-        debugger_event_t *dbg_event = &dbg_req->dbg_events[event_index];
+        debugger_event_t *dbg_event = &event;
 
         debug_event_t ev;
         switch (dbg_event->type)
@@ -271,22 +268,63 @@ static int idaapi check_debugger_events(void *ud)
         default:
             break;
         }
-
-        dbg_event->type = dbg_event_type_t::DBG_EVT_NO_EVENT;
-        qsleep(10);
     }
 
     return 0;
 }
 
-static int idaapi apply_pc_map(void* ud) {
+static void apply_coverage_word(unsigned char *applied, unsigned int address) {
+    unsigned char bit = 1 << ((address >> 1) & 7);
+
+    if (!(applied[address >> 4] & bit)) {
+        applied[address >> 4] |= bit;
+        auto_make_code((ea_t)address);
+    }
+}
+
+static int idaapi apply_coverage(void* ud) {
+    // words already turned into code
+    static unsigned char applied[DBG_COV_MAP_SIZE];
+    static unsigned int batch[0x400];
+    unsigned int lost = 0;
+
+    memset(applied, 0, sizeof(applied));
+
     while (dbg_req && dbg_req->dbg_active == 1) {
-        for (int addr = 0; dbg_req && dbg_req->dbg_active == 1 && !dbg_req->dbg_paused && addr < (MAXROMSIZE >> 1); ++addr) {
-            if (dbg_req && dbg_req->pc_map[addr].to_apply == 1 && !dbg_req->pc_map[addr].applied) {
-                dbg_req->pc_map[addr].applied = 1;
-                auto_make_code((ea_t)(addr << 1));
+        if (dbg_req->dbg_paused) {
+            qsleep(10);
+            continue;
+        }
+
+        int count = drain_dbg_coverage(dbg_req, batch, qnumber(batch));
+        for (int i = 0; i < count; ++i)
+            apply_coverage_word(applied, batch[i]);
+
+        // the queue overflowed, pick up the rest from the dirty pages
+        if (dbg_req && dbg_req->coverage.lost != lost) {
+            lost = dbg_req->coverage.lost;
+
+            unsigned char *dirty = dbg_cov_dirty(dbg_req);
+            const unsigned char *map = dbg_cov_map(dbg_req);
+            for (int page = 0; page < DBG_COV_DIRTY_SIZE; ++page) {
+                if (!dirty[page])
+                    continue;
+                dirty[page] = 0;
+
+                int start = (page << DBG_COV_PAGE_SHIFT) >> 4;
+                int end = start + ((1 << DBG_COV_PAGE_SHIFT) >> 4);
+                for (int i = start; i < end; ++i) {
+                    unsigned char bits = map[i] & ~applied[i];
+                    for (int bit = 0; bits && bit < 8; ++bit) {
+                        if (bits & (1 << bit))
+                            apply_coverage_word(applied, ((i << 3) | bit) << 1);
+                    }
+                }
             }
         }
+
+        if (count < qnumber(batch))
+            qsleep(10);
     }
 
     return 0;
@@ -319,7 +357,7 @@ static drc_t idaapi s_start_process(const char *path,
             qsleep(10);
         }
 
-        while (dbg_req && (dbg_req->dbg_active != 1 || dbg_req->dbg_events_count == 0) && !user_cancelled()) {
+        while (dbg_req && (dbg_req->dbg_active != 1 || !dbg_events_pending(dbg_req)) && !user_cancelled()) {
             qsleep(10);
         }
 
@@ -330,7 +368,7 @@ static drc_t idaapi s_start_process(const char *path,
         events_thread = qthread_create(check_debugger_events, NULL);
         send_dbg_request(dbg_req, request_type_t::REQ_ATTACH, 1);
 
-        pc_map_thread = qthread_create(apply_pc_map, NULL);
+        coverage_thread = qthread_create(apply_coverage, NULL);
 
         return DRC_OK;
     }
@@ -558,31 +596,31 @@ static drc_t idaapi get_memory_info(meminfo_vec_t &areas, qstring *errbuf)
 
 static ssize_t idaapi read_memory(ea_t ea, void *buffer, size_t size, qstring *errbuf)
 {
-    if ((ea >= 0xA00000 && ea < 0xA0FFFF))
-    {
-        dbg_req->mem_data.address = ea;
-        dbg_req->mem_data.size = (int)size;
-        send_dbg_request(dbg_req, request_type_t::REQ_READ_Z80, 0);
+    request_type_t type;
 
-        memcpy(buffer, &dbg_req->mem_data.z80_ram[ea & 0x1FFF], size);
-        // Z80
-    }
+    if ((ea >= 0xA00000 && ea < 0xA0FFFF))
+        type = request_type_t::REQ_READ_Z80; // Z80
     else if (ea < MAXROMSIZE)
-    {
-        dbg_req->mem_data.address = ea;
-        dbg_req->mem_data.size = (int)size;
-        send_dbg_request(dbg_req, request_type_t::REQ_READ_68K_ROM, 0);
-
-        memcpy(buffer, &dbg_req->mem_data.m68k_rom[ea], size);
-    }
+        type = request_type_t::REQ_READ_68K_ROM;
     else if ((ea >= 0xFF0000 && ea < 0x1000000))
+        type = request_type_t::REQ_READ_68K_RAM; // RAM
+    else
+        return size;
+
+    // the data window is smaller than a full ROM, read it in chunks
+    for (size_t done = 0; done < size; )
     {
-        dbg_req->mem_data.address = ea;
-        dbg_req->mem_data.size = (int)size;
-        send_dbg_request(dbg_req, request_type_t::REQ_READ_68K_RAM, 0);
+        int chunk = (int)qmin(size - done, (size_t)dbg_req->data_size);
+
+        dbg_req->mem_data.address = (unsigned int)(ea + done);
+        dbg_req->mem_data.size = chunk;
+        send_dbg_request(dbg_req, type, 0);
+
+        if (dbg_req->mem_data.size <= 0)
+            break;
 
-        memcpy(buffer, &dbg_req->mem_data.m68k_ram[ea & 0xFFFF], size);
-        // RAM
+        memcpy((unsigned char *)buffer + done, dbg_data(dbg_req), dbg_req->mem_data.size);
+        done += dbg_req->mem_data.size;
     }
 
     return size;
@@ -620,6 +658,7 @@ static drc_t idaapi update_bpts(int* nbpts, update_bpt_info_t *bpts, int nadd, i
 
         bpt_data->address = start;
         bpt_data->width = bpts[i].size;
+        set_bpt_condition_data(bpt_data);
         send_dbg_request(dbg_req, request_type_t::REQ_ADD_BREAK, 0);
 
         bpts[i].code = BPT_OK;
@@ -28,6 +28,7 @@
 
 #include "bpts_window.h"
 #include "debug_wrap.h"
+#include "trace.h"
 
 extern debugger_t debugger;
 
@@ -744,6 +745,169 @@ static smd_constant_action_t smd_constant;
 static action_desc_t smd_constant_action = ACTION_DESC_LITERAL(smd_constant_name, "Identify SMD constant", &smd_constant, "J", NULL, -1);
 
 extern dbg_request_t* dbg_req;
+
+struct export_coverage_action_t : public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t * ctx)
+    {
+        const char *path = ask_file(true, "*.gxcov", "Export code coverage");
+        if (path == NULL)
+            return 0;
+
+        if (!save_dbg_coverage(dbg_req, path))
+            warning("Cannot write code coverage to %s", path);
+        else
+            msg("Code coverage: %u words executed, saved to %s\n", dbg_req->coverage.executed, path);
+        return 1;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx)
+    {
+        return (dbg_req && dbg_req->dbg_active == 1) ? AST_ENABLE : AST_DISABLE;
+    }
+};
+
+// Reverse requests are served synchronously by the core, no debugger event
+// follows them: registers and memory have to be refreshed here.
+struct reverse_action_t : public action_handler_t
+{
+    request_type_t type;
+
+    reverse_action_t(request_type_t _type) : type(_type) {}
+
+    virtual int idaapi activate(action_activation_ctx_t * ctx)
+    {
+        send_dbg_request(dbg_req, type, 0);
+
+        invalidate_dbg_state(DBGINV_ALL);
+        refresh_debugger_memory();
+
+        uval_t ip;
+        if (get_ip_val(&ip))
+            jumpto((ea_t)ip);
+
+        const history_stats_t &history = dbg_req->history;
+        msg("Reverse: at instruction %u (oldest %u), %u snapshots / %u keyframes in %u KB, took %u us\n",
+            history.position, history.oldest, history.snapshots, history.keyframes, history.bytes >> 10, history.last_us);
+        return 1;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx)
+    {
+        return (dbg_req && dbg_req->dbg_active == 1 && dbg_req->dbg_paused) ? AST_ENABLE : AST_DISABLE;
+    }
+};
+
+// Starts an execution trace, or stops the running one and reports how it
+// kept up: blocks stored uncompressed mean the compressors fell behind,
+// stall time is what the emulator itself lost waiting for them.
+struct trace_action_t : public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t * ctx)
+    {
+        dbg_trace_t &trace = dbg_req->trace;
+
+        if (trace.active) {
+            send_dbg_request(dbg_req, REQ_TRACE_STOP, 0);
+
+            if (trace.error)
+                warning("Execution trace: write error, the trace was stopped");
+
+            double elapsed = trace.elapsed_us ? trace.elapsed_us : 1;
+            msg("Execution trace: %llu instructions in %u frames, %.2f bytes per instruction (%u of %u blocks stored)\n",
+                trace.entries, trace.frames, trace.entries ? (double)trace.packed_bytes / trace.entries : 0.0, trace.stored, trace.blocks);
+            msg("Execution trace: emulator stalled %.2f%%, compressors busy %.2f%% of %.1f s\n",
+                trace.stall_us * 100.0 / elapsed, trace.compress_us * 100.0 / elapsed, elapsed / 1000000.0);
+            return 1;
+        }
+
+        const char *path = ask_file(true, "*.gxtrace", "Record execution trace");
+        if (path == NULL)
+            return 0;
+
+        if (qstrlen(path) >= dbg_req->data_size) {
+            warning("Execution trace: path too long");
+            return 0;
+        }
+
+        int regs = ask_yn(ASKBTN_NO, "Record register changes too?");
+        if (regs == ASKBTN_CANCEL)
+            return 0;
+
+        qstrncpy((char *)dbg_data(dbg_req), path, dbg_req->data_size);
+        trace.flags = (regs == ASKBTN_YES) ? TRACE_REGS : 0;
+        send_dbg_request(dbg_req, REQ_TRACE_START, 0);
+
+        if (!trace.active)
+            warning("Cannot write execution trace to %s", path);
+        else
+            msg("Execution trace: recording to %s\n", path);
+        return 1;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx)
+    {
+        return (dbg_req && dbg_req->dbg_active == 1 && (dbg_req->caps & DBG_CAP_TRACE)) ? AST_ENABLE : AST_DISABLE;
+    }
+};
+
+// Rewinds the emulator by a number of frames, the buffer itself is enabled
+// and sized by the core options.
+struct rewind_action_t : public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t * ctx)
+    {
+        dbg_rewind_t &rewind = dbg_req->rewind;
+
+        if (!rewind.budget) {
+            warning("Rewind: enable the rewind buffer in the core options first");
+            return 0;
+        }
+
+        sval_t frames = 60;
+        if (!ask_long(&frames, "Rewind frames (%u available)", rewind.available) || frames <= 0)
+            return 0;
+
+        rewind.frames = (int)frames;
+        send_dbg_request(dbg_req, REQ_REWIND, 0);
+
+        invalidate_dbg_state(DBGINV_ALL);
+        refresh_debugger_memory();
+
+        uval_t ip;
+        if (get_ip_val(&ip))
+            jumpto((ea_t)ip);
+
+        msg("Rewind: %d frames back in %u us, %u frames left in %u of %u KB, %u bytes per frame (capture %u us)\n",
+            rewind.frames, rewind.restore_us, rewind.available, rewind.bytes >> 10, rewind.budget >> 10, rewind.avg_bytes, rewind.capture_us);
+        return 1;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx)
+    {
+        return (dbg_req && dbg_req->dbg_active == 1 && dbg_req->dbg_paused && (dbg_req->caps & DBG_CAP_REWIND)) ? AST_ENABLE : AST_DISABLE;
+    }
+};
+
+static const char rewind_name[] = "gensida:rewind";
+static rewind_action_t rewind_handler;
+static action_desc_t rewind_action = ACTION_DESC_LITERAL(rewind_name, "Rewind frames...", &rewind_handler, NULL, NULL, -1);
+
+static const char trace_name[] = "gensida:trace";
+static trace_action_t trace_toggle;
+static action_desc_t trace_action = ACTION_DESC_LITERAL(trace_name, "Start/stop execution trace...", &trace_toggle, NULL, NULL, -1);
+
+static const char step_back_name[] = "gensida:step_back";
+static reverse_action_t step_back(REQ_STEP_BACK);
+static action_desc_t step_back_action = ACTION_DESC_LITERAL(step_back_name, "Step back", &step_back, "Alt-Shift-F7", NULL, -1);
+
+static const char reverse_continue_name[] = "gensida:reverse_continue";
+static reverse_action_t reverse_continue(REQ_REVERSE_CONTINUE);
+static action_desc_t reverse_continue_action = ACTION_DESC_LITERAL(reverse_continue_name, "Reverse continue", &reverse_continue, "Alt-Shift-F9", NULL, -1);
+
+static const char export_coverage_name[] = "gensida:export_coverage";
+static export_coverage_action_t export_coverage;
+static action_desc_t export_coverage_action = ACTION_DESC_LITERAL(export_coverage_name, "Export code coverage...", &export_coverage, NULL, NULL, -1);
 TWidget* bpts_w = nullptr;
 const char* bpts_w_name = "M68000 Breakpoints";
 static QTableWidget* bpList = nullptr;
@@ -752,6 +916,40 @@ static QComboBox* bpSize = nullptr;
 static QRadioButton* bp68kTypeBtn = nullptr, /**bpZ80TypeBtn = nullptr,*/ *bpVramTypeBtn,
                      *bpCramTypeBtn = nullptr, *bpVsramTypeBtn = nullptr;
 static QCheckBox* bpExecType = nullptr, *bpReadType = nullptr, *bpWriteType = nullptr;
+static QLineEdit* bpCond = nullptr;
+static QSpinBox* bpHitCount = nullptr;
+
+struct bpt_cond_t {
+    QString text;
+    unsigned int hit_count;
+};
+
+// conditions are kept here, IDA breakpoint conditions are IDC/Python
+static QMap<quint64, bpt_cond_t> bpt_conds;
+
+static quint64 bpt_cond_key(bpt_type_t type, unsigned int address) {
+    // IDA has a single 68K breakpoint per address
+    if (type & BPT_M68K_RWE) {
+        type = BPT_M68K_RWE;
+    }
+
+    return ((quint64)type << 32) | address;
+}
+
+// Puts the condition of a breakpoint in the request, an empty one clears it.
+void set_bpt_condition_data(bpt_data_t* bpt_data) {
+    auto it = bpt_conds.constFind(bpt_cond_key(bpt_data->type, bpt_data->address));
+    QByteArray text;
+
+    bpt_data->hit_count = 0;
+    if (it != bpt_conds.constEnd()) {
+        text = it->text.toLatin1();
+        bpt_data->hit_count = it->hit_count;
+    }
+
+    qstrncpy((char*)dbg_data(dbg_req), text.constData(), dbg_req->data_size);
+    bpt_data->cond_set = 1;
+}
 
 static void add_bpt_list_item(const bpt_data_t* bpt_item, int index) {
     if (bpts_w == nullptr) {
@@ -813,6 +1011,16 @@ static void add_bpt_list_item(const bpt_data_t* bpt_item, int index) {
     item3->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
     bpList->setItem(index, 3, item3);
 
+    auto it = bpt_conds.constFind(bpt_cond_key(bpt_item->type, bpt_item->address));
+    bool hasCond = it != bpt_conds.constEnd();
+
+    QTableWidgetItem* item4 = new QTableWidgetItem(hasCond && it->hit_count > 1 ? QString::number(it->hit_count) : "");
+    item4->setTextAlignment(Qt::AlignCenter | Qt::AlignVCenter);
+    bpList->setItem(index, 4, item4);
+    QTableWidgetItem* item5 = new QTableWidgetItem(hasCond ? it->text : "");
+    item5->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+    bpList->setItem(index, 5, item5);
+
     bpList->resizeColumnsToContents();
 }
 
@@ -910,6 +1118,7 @@ static void delete_breakpoint_from_list(int index, bool from_event) {
             res = del_bpt(address);
         }
         else {
+            bpt_conds.remove(bpt_cond_key(type, address));
             bpList->removeRow(index);
         }
     }
@@ -1031,6 +1240,17 @@ void BptsWindow::addBreakpoint() {
     //        type = (bpt_type_t)(type | BPT_Z80_W);
     //}
 
+    quint64 condKey = bpt_cond_key(type, address);
+    QString condText = bpCond->text().trimmed();
+    unsigned int hitCount = bpHitCount->value();
+
+    if (!condText.isEmpty() || hitCount > 1) {
+        bpt_conds[condKey] = { condText, hitCount };
+    }
+    else {
+        bpt_conds.remove(condKey);
+    }
+
     bool res = true;
 
     if (type & BPT_M68K_RWE) {
@@ -1056,7 +1276,27 @@ void BptsWindow::addBreakpoint() {
     _bpt_data->address = address;
     _bpt_data->width = width;
     _bpt_data->type = type;
+    set_bpt_condition_data(_bpt_data);
     send_dbg_request(dbg_req, REQ_ADD_BREAK, 0);
+
+    if (_bpt_data->cond_error) {
+        warning("Condition error at column %d", _bpt_data->cond_error);
+
+        // the core did not add it
+        bpt_conds.remove(condKey);
+        if (type & BPT_M68K_RWE) {
+            del_bpt(address);
+        }
+        else {
+            for (int i = bpList->rowCount() - 1; i >= 0; --i) {
+                if (bpList->item(i, 1)->text().toUInt(nullptr, 16) == address &&
+                    strToBptType(bpList->item(i, 3)->text()) == type) {
+                    bpList->removeRow(i);
+                    break;
+                }
+            }
+        }
+    }
 }
 
 void BptsWindow::delBreakpoint() {
@@ -1195,6 +1435,32 @@ static ssize_t idaapi hook_ui(void *user_data, int notification_code, va_list va
             bpErwLayout->addWidget(bpWriteType, 0, 2);
             bpErwLayout->addWidget(bpSize, 0, 3);
 
+            QGridLayout* bpCondLayout = new QGridLayout(w);
+            QLabel* bpCondL = new QLabel("Condition: ", w);
+            bpCondL->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+            bpCondL->setFont(font);
+
+            bpCond = new QLineEdit(w);
+            bpCond->setFont(font);
+            bpCond->setMaxLength(200);
+            bpCond->setPlaceholderText("d0 == 5 && value > 0x100");
+            bpCond->setToolTip("Stop only when true: d0-d7, a0-a7, sp, pc, sr (.b/.w/.l),\n"
+                               "value, address, byte(x), word(x), long(x) and C operators");
+
+            QLabel* bpHitCountL = new QLabel("Hit count: ", w);
+            bpHitCountL->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+            bpHitCountL->setFont(font);
+
+            bpHitCount = new QSpinBox(w);
+            bpHitCount->setFont(font);
+            bpHitCount->setRange(0, 0x7FFFFFFF);
+            bpHitCount->setToolTip("Stop from this hit on, 0 or 1 stops on every hit");
+
+            bpCondLayout->addWidget(bpCondL, 0, 0);
+            bpCondLayout->addWidget(bpCond, 0, 1);
+            bpCondLayout->addWidget(bpHitCountL, 0, 2);
+            bpCondLayout->addWidget(bpHitCount, 0, 3);
+
             QGridLayout* btnsLayout = new QGridLayout(w);
             QPushButton* bpAddBtn = new QPushButton("Add", w);
             bpAddBtn->setFont(font);
@@ -1210,15 +1476,17 @@ static ssize_t idaapi hook_ui(void *user_data, int notification_code, va_list va
             bpList->setEditTriggers(QAbstractItemView::NoEditTriggers);
             bpList->setFocusPolicy(Qt::NoFocus);
             bpList->setShowGrid(false);
-            bpList->setColumnCount(4);
+            bpList->setColumnCount(6);
             bpList->setFont(font);
             bpList->setSelectionBehavior(QAbstractItemView::SelectRows);
             bpList->setSelectionMode(QAbstractItemView::SingleSelection);
-            bpList->setHorizontalHeaderLabels({ "Enabled", "Address", "Size", "Type" });
+            bpList->setHorizontalHeaderLabels({ "Enabled", "Address", "Size", "Type", "Hits", "Condition" });
             bpList->horizontalHeaderItem(0)->setToolTip("Is breakpoint enabled");
             bpList->horizontalHeaderItem(1)->setToolTip("Breakpoint address");
             bpList->horizontalHeaderItem(2)->setToolTip("Breakpoint size");
             bpList->horizontalHeaderItem(3)->setToolTip("Breakpoint type");
+            bpList->horizontalHeaderItem(4)->setToolTip("Hit count to stop at");
+            bpList->horizontalHeaderItem(5)->setToolTip("Breakpoint condition");
 
             bpList->resizeColumnsToContents();
 
@@ -1241,7 +1509,8 @@ static ssize_t idaapi hook_ui(void *user_data, int notification_code, va_list va
             mainLayout->addLayout(bpAddrLayout, 0, 1);
             mainLayout->addLayout(bpErwLayout, 1, 0);
             mainLayout->addLayout(btnsLayout, 1, 1);
-            mainLayout->addWidget(bpList, 2, 0, 1, 3);
+            mainLayout->addLayout(bpCondLayout, 2, 0, 1, 2);
+            mainLayout->addWidget(bpList, 3, 0, 1, 3);
 
             w->setLayout(mainLayout);
 
@@ -1250,6 +1519,7 @@ static ssize_t idaapi hook_ui(void *user_data, int notification_code, va_list va
             QObject::connect(bpDelBtn, SIGNAL(clicked()), bptsWindow, SLOT(delBreakpoint()));
             QObject::connect(bpClearBtn, SIGNAL(clicked()), bptsWindow, SLOT(clrBreakpoints()));
             QObject::connect(bpAddr, SIGNAL(returnPressed()), bptsWindow, SLOT(addBreakpoint()));
+            QObject::connect(bpCond, SIGNAL(returnPressed()), bptsWindow, SLOT(addBreakpoint()));
             QObject::connect(bpList, SIGNAL(cellDoubleClicked(int, int)), bptsWindow, SLOT(rowDoubleClick(int, int)));
 #pragma endregion
         }
@@ -1640,7 +1910,12 @@ struct bpt_events_visitor_t : public post_event_visitor_t
                 _bpt_data->address = address;
                 _bpt_data->width = width;
                 _bpt_data->type = type;
+                set_bpt_condition_data(_bpt_data);
                 send_dbg_request(dbg_req, REQ_ADD_BREAK, 0);
+
+                if (_bpt_data->cond_error) {
+                    msg("Breakpoint %06X: condition error at column %d\n", address, _bpt_data->cond_error);
+                }
             }
         } break;
         case dbg_notification_t::dbg_bpt_changed: {
@@ -1664,6 +1939,7 @@ struct bpt_events_visitor_t : public post_event_visitor_t
                 }
 
                 if (bptev_code == BPTEV_REMOVED) {
+                    bpt_conds.remove(bpt_cond_key(BPT_M68K_RWE, (unsigned int)bpt->ea));
                     break;
                 }
             }
@@ -1695,6 +1971,16 @@ static plugmod_t * idaapi init(void)
         my_dbg = false;
 
         register_action(smd_constant_action);
+        register_action(export_coverage_action);
+        attach_action_to_menu("Debugger/", export_coverage_name, SETMENU_APP);
+        register_action(step_back_action);
+        attach_action_to_menu("Debugger/", step_back_name, SETMENU_APP);
+        register_action(reverse_continue_action);
+        attach_action_to_menu("Debugger/", reverse_continue_name, SETMENU_APP);
+        register_action(trace_action);
+        attach_action_to_menu("Debugger/", trace_name, SETMENU_APP);
+        register_action(rewind_action);
+        attach_action_to_menu("Debugger/", rewind_name, SETMENU_APP);
 
         hook_to_notification_point(HT_UI, hook_ui, NULL);
         register_post_event_visitor(HT_IDP, &ctx, nullptr);
@@ -1716,6 +2002,16 @@ static void idaapi term(void)
         unregister_post_event_visitor(HT_IDP, &ctx);
         unregister_post_event_visitor(HT_DBG, &bpt_ctx);
 
+        detach_action_from_menu("Debugger/", rewind_name);
+        unregister_action(rewind_name);
+        detach_action_from_menu("Debugger/", trace_name);
+        unregister_action(trace_name);
+        detach_action_from_menu("Debugger/", reverse_continue_name);
+        unregister_action(reverse_continue_name);
+        detach_action_from_menu("Debugger/", step_back_name);
+        unregister_action(step_back_name);
+        detach_action_from_menu("Debugger/", export_coverage_name);
+        unregister_action(export_coverage_name);
         unregister_action(smd_constant_name);
 
         plugin_inited = false;
@@ -6,4 +6,5 @@
 #include <idd.hpp>
 #include "debug_wrap.h"
 
-bpt_type_t idaBptToGx(bpttype_t type);
\ No newline at end of file
+bpt_type_t idaBptToGx(bpttype_t type);
+void set_bpt_condition_data(bpt_data_t* bpt_data);
\ No newline at end of file
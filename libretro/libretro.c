@@ -50,6 +50,7 @@
 
 #include "debug.h"
 #include "debug_wrap.h"
+#include "trace.h"
 jmp_buf jmp_env;
 
 #ifdef _MSC_VER
@@ -80,6 +81,7 @@ jmp_buf jmp_env;
 #include <streams/file_stream.h>
 
 #include "shared.h"
+#include "rewind.h"
 #include "md_ntsc.h"
 #include "sms_ntsc.h"
 
@@ -105,7 +107,7 @@ STATIC_ASSERT(z80_overflow,
 sms_ntsc_t *sms_ntsc;
 md_ntsc_t  *md_ntsc;
 
-t_config config;
+MACHINE_LOCAL t_config config;
 
 char GG_ROM[256];
 char AR_ROM[256];
@@ -140,10 +142,26 @@ static uint8_t brm_format[0x40] =
 static bool is_running = 0;
 static uint8_t temp[0x10000];
 static int16 soundbuffer[3068];
-static uint16_t bitmap_data_[720 * 576];
+static uint32_t bitmap_data_[720 * 576];
+
+/* Bitmap pixel format (XRGB8888 can be selected on load with 15 or 16-bit pixels rendering) */
+#if defined(USE_32BPP_RENDERING)
+#define NATIVE_PIXEL_FORMAT RETRO_PIXEL_FORMAT_XRGB8888
+#elif defined(USE_16BPP_RENDERING)
+#define NATIVE_PIXEL_FORMAT RETRO_PIXEL_FORMAT_RGB565
+#else
+#define NATIVE_PIXEL_FORMAT RETRO_PIXEL_FORMAT_0RGB1555
+#endif
+static enum retro_pixel_format pixel_format = NATIVE_PIXEL_FORMAT;
+
+/* 1= frame is rendered into frontend framebuffer (see map_framebuffer) */
+static bool framebuffer_mapped;
 
 static bool restart_eq = false;
 
+static int runahead_frames;
+static uint8 *runahead_state;
+
 static char g_rom_dir[256];
 static char g_rom_name[256];
 static void *g_rom_data;
@@ -156,6 +174,9 @@ static retro_input_poll_t input_poll_cb;
 static retro_input_state_t input_state_cb;
 static retro_environment_t environ_cb;
 static retro_audio_sample_batch_t audio_cb;
+static struct retro_perf_callback perf_cb;
+static struct retro_perf_counter perf_frame = { "gpgx_frame", 0, 0, 0, false };
+static struct retro_perf_counter perf_runahead = { "gpgx_runahead", 0, 0, 0, false };
 
 /* Cheat Support */
 #define MAX_CHEATS (150)
@@ -538,14 +559,27 @@ void osd_input_update(void)
 
     input.pad[i] = temp;
   }
+
+  /* record inputs for reverse debugging, or play them back */
+  update_debug_input();
+}
+
+/* XRGB8888 color, converted to RGB565 with 16-bit pixels */
+static void draw_cursor_pixel(uint8_t *ptr, uint32_t color)
+{
+   if (bitmap.bpp == 32)
+      *(uint32_t *)ptr = color;
+   else
+      *(uint16_t *)ptr = ((color >> 8) & 0xf800) | ((color >> 5) & 0x07e0) | ((color >> 3) & 0x001f);
 }
 
-static void draw_cursor(int16_t x, int16_t y, uint16_t color)
+static void draw_cursor(int16_t x, int16_t y, uint32_t color)
 {
    int i;
+   int bytes = (bitmap.bpp == 32) ? 4 : 2;
 
    /* crosshair center position */   
-   uint16_t *ptr = (uint16_t *)bitmap.data + ((bitmap.viewport.y + y) * bitmap.width) + x + bitmap.viewport.x;
+   uint8_t *ptr = bitmap.data + ((bitmap.viewport.y + y) * bitmap.pitch) + ((x + bitmap.viewport.x) * bytes);
 
    /* default crosshair dimension */
    int x_start = x - 3;
@@ -557,26 +591,66 @@ static void draw_cursor(int16_t x, int16_t y, uint16_t color)
    if ( x < 0 && y < 0 )
       return;
 
+   /* outside of frontend framebuffer (display mode changed during frame) */
+   if ((x + bitmap.viewport.x) >= bitmap.width || (y + bitmap.viewport.y) >= bitmap.height)
+      return;
+
    /* framebuffer limits */
    if (x_start < -bitmap.viewport.x) x_start = -bitmap.viewport.x;
    if (x_end >= (bitmap.viewport.w + bitmap.viewport.x)) x_end = bitmap.viewport.w + bitmap.viewport.x - 1;
    if (y_start < -bitmap.viewport.y) y_start = -bitmap.viewport.y;
    if (y_end >= (bitmap.viewport.h + bitmap.viewport.y)) y_end = bitmap.viewport.h + bitmap.viewport.y - 1;
+   if (x_end >= (bitmap.width - bitmap.viewport.x)) x_end = bitmap.width - bitmap.viewport.x - 1;
+   if (y_end >= (bitmap.height - bitmap.viewport.y)) y_end = bitmap.height - bitmap.viewport.y - 1;
 
    /* draw crosshair */
    for (i = (x_start - x); i <= (x_end - x); i++)
-      ptr[i] = (i & 1) ? color : 0xffff;
+      draw_cursor_pixel(ptr + (i * bytes), (i & 1) ? color : 0xffffff);
    for (i = (y_start - y); i <= (y_end - y); i++)
-      ptr[i * bitmap.width] = (i & 1) ? color : 0xffff;
+      draw_cursor_pixel(ptr + (i * bitmap.pitch), (i & 1) ? color : 0xffffff);
 }
 
-static void init_bitmap(void)
+/* core renders into its own bitmap outside of retro_run() */
+static void unmap_framebuffer(void)
 {
-   memset(&bitmap, 0, sizeof(bitmap));
    bitmap.width      = 720;
    bitmap.height     = 576;
-   bitmap.pitch      = 720 * 2;
+   bitmap.bpp        = (pixel_format == RETRO_PIXEL_FORMAT_XRGB8888) ? 32 : 0;
+   bitmap.pitch      = 720 * ((bitmap.bpp == 32) ? 4 : 2);
    bitmap.data       = (uint8_t *)bitmap_data_;
+   framebuffer_mapped = false;
+}
+
+/* Frame is rendered straight into frontend video memory when provided, unless */
+/* output depends on pixels of previous frame (LCD ghosting filter, interlaced */
+/* double field output) or is wider than displayed area (NTSC filters). Width  */
+/* & height are those of previous frame, lines drawn after a display mode      */
+/* change are cut to framebuffer size (see remap_line).                        */
+static void map_framebuffer(void)
+{
+   struct retro_framebuffer fb = {0};
+
+   if (config.lcd || config.ntsc || (config.render && interlaced) || !vwidth || !vheight)
+      return;
+
+   fb.width        = vwidth;
+   fb.height       = vheight;
+   fb.access_flags = RETRO_MEMORY_ACCESS_WRITE;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &fb) || !fb.data || (fb.format != pixel_format))
+      return;
+
+   bitmap.width      = fb.width;
+   bitmap.height     = fb.height;
+   bitmap.pitch      = fb.pitch;
+   bitmap.data       = (uint8_t *)fb.data;
+   framebuffer_mapped = true;
+}
+
+static void init_bitmap(void)
+{
+   memset(&bitmap, 0, sizeof(bitmap));
+   unmap_framebuffer();
 }
 
 static void config_default(void)
@@ -872,7 +946,8 @@ static bool update_viewport(void)
   vheight = bitmap.viewport.h + (bitmap.viewport.y * 2);
   vaspect_ratio = calculate_display_aspect_ratio();
 
-   if (config.ntsc)
+   /* NTSC filters only output 15 or 16-bit pixels (see remap_line) */
+   if (config.ntsc && (bitmap.bpp != 32))
    {
       if (reg[12] & 1)
          vwidth = MD_NTSC_OUT_WIDTH(vwidth);
@@ -1420,6 +1495,35 @@ static void check_variables(void)
       config.no_sprite_limit = 1;
   }
 
+  var.key = "genesis_plus_gx_rewind";
+  environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var);
+  {
+    uint32 budget = 0;
+
+    if (var.value && strcmp(var.value, "disabled"))
+      budget = atoi(var.value) << 20;
+
+    if (budget != rewind_stats.budget && !rewind_init(budget) && log_cb)
+      log_cb(RETRO_LOG_ERROR, "Cannot allocate %s rewind buffer.\n", var.value);
+  }
+
+  var.key = "genesis_plus_gx_runahead";
+  environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var);
+  {
+    runahead_frames = 0;
+
+    if (var.value && strcmp(var.value, "disabled"))
+    {
+      if (!runahead_state)
+        runahead_state = malloc(STATE_SIZE);
+
+      if (runahead_state)
+        runahead_frames = atoi(var.value);
+      else if (log_cb)
+        log_cb(RETRO_LOG_ERROR, "Cannot allocate run-ahead state.\n");
+    }
+  }
+
   if (reinit)
   {
 #ifdef HAVE_OVERCLOCK
@@ -1720,6 +1824,9 @@ static void apply_cheats(void)
          }
       }
    }
+
+   /* patched ROM code may be cached */
+   m68k_block_flush();
 }
 
 static void clear_cheats(void)
@@ -1752,6 +1859,9 @@ static void clear_cheats(void)
       }
       i--;
    }
+
+   /* patched ROM code may be cached */
+   m68k_block_flush();
 }
 
 /****************************************************************************
@@ -1772,11 +1882,13 @@ static void RAMCheatUpdate(void)
       {
          /* 16-bit patch */
          *(uint16_t *)(work_ram + (cheatlist[index].address & 0xFFFE)) = cheatlist[index].data;
+         MARK_PAGE_DIRTY(work_ram_dirty, cheatlist[index].address & 0xFFFE);
       }
       else
       {
          /* 8-bit patch */
          work_ram[cheatlist[index].address & 0xFFFF] = cheatlist[index].data;
+         MARK_PAGE_DIRTY(work_ram_dirty, cheatlist[index].address & 0xFFFF);
       }
    }
 }
@@ -2004,12 +2116,17 @@ void retro_set_environment(retro_environment_t cb)
       { "genesis_plus_gx_gg_extra", "Game Gear extended screen; disabled|enabled" },
       { "genesis_plus_gx_aspect_ratio", "Core-provided aspect ratio; auto|NTSC PAR|PAL PAR" },
       { "genesis_plus_gx_render", "Interlaced mode 2 output; single field|double field" },
+#if defined(USE_15BPP_RENDERING) || defined(USE_16BPP_RENDERING)
+      { "genesis_plus_gx_pixel_format", "Video output pixel format (restart); 16-bit|32-bit" },
+#endif
       { "genesis_plus_gx_gun_cursor", "Show Lightgun crosshair; disabled|enabled" },
       { "genesis_plus_gx_invert_mouse", "Invert Mouse Y-axis; disabled|enabled" },
 #ifdef HAVE_OVERCLOCK
       { "genesis_plus_gx_overclock", "CPU speed; 100%|125%|150%|175%|200%" },
 #endif
       { "genesis_plus_gx_no_sprite_limit", "Remove per-line sprite limit; disabled|enabled" },
+      { "genesis_plus_gx_rewind", "Rewind buffer (Debug menu); disabled|16MB|32MB|64MB|128MB" },
+      { "genesis_plus_gx_runahead", "Run-ahead frames; disabled|1|2|3|4" },
       { NULL, NULL },
    };
 
@@ -2356,7 +2473,7 @@ bool retro_unserialize(const void *data, size_t size)
    if (size != STATE_SIZE)
       return FALSE;
 
-   if (!state_load((uint8_t*)data))
+   if (!state_load_hot((uint8_t*)data))
       return FALSE;
 
 #ifdef HAVE_OVERCLOCK
@@ -2439,7 +2556,28 @@ bool retro_load_game(const struct retro_game_info *info)
    if (!info->path)
       return false;
 
+#if defined(USE_15BPP_RENDERING) || defined(USE_16BPP_RENDERING)
+   {
+      /* pixel format can only be set on load */
+      struct retro_variable var = {0};
+      pixel_format = NATIVE_PIXEL_FORMAT;
+      var.key = "genesis_plus_gx_pixel_format";
+      environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var);
+      if (var.value && !strcmp(var.value, "32-bit"))
+      {
+         enum retro_pixel_format xrgb8888 = RETRO_PIXEL_FORMAT_XRGB8888;
+         if (environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &xrgb8888))
+         {
+            pixel_format = RETRO_PIXEL_FORMAT_XRGB8888;
+            if (log_cb)
+               log_cb(RETRO_LOG_INFO, "Frontend supports XRGB8888 - will use that for video output.\n");
+         }
+      }
+   }
+#endif
+
 #ifdef FRONTEND_SUPPORTS_RGB565
+   if (pixel_format != RETRO_PIXEL_FORMAT_XRGB8888)
    {
       unsigned rgb565 = RETRO_PIXEL_FORMAT_RGB565;
       if(environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &rgb565))
@@ -2669,6 +2807,11 @@ void retro_unload_game(void)
       }
    }
 
+#ifdef HOOK_CPU
+   trace_stop();
+#endif
+   rewind_clear();
+
    if (system_hw == SYSTEM_MCD)
       bram_save();
 
@@ -2743,11 +2886,13 @@ static void check_system_specs(void)
 static int menu_created = 0;
 static HMENU dbgMenu = NULL;
 static HHOOK dbgMenuHook = NULL;
+static int rewind_pending = 0;
 extern HINSTANCE GetHInstance();
 
 #define IDM_DBG_PLANE_EXPLORER (0x666 + 1)
 #define IDM_DBG_VDP_RAM (0x666 + 2)
 #define IDM_DBG_HEX_EDITOR (0x666 + 3)
+#define IDM_DBG_REWIND (0x666 + 4)
 
 
 LRESULT CALLBACK dbgMenuHookProc(int nCode, WPARAM wParam, LPARAM lParam) {
@@ -2766,6 +2911,10 @@ LRESULT CALLBACK dbgMenuHookProc(int nCode, WPARAM wParam, LPARAM lParam) {
             case IDM_DBG_HEX_EDITOR: {
                 create_hex_editor();
             } break;
+            case IDM_DBG_REWIND: {
+                /* served by the next retro_run */
+                rewind_pending = vdp_pal ? 50 : 60;
+            } break;
             }
         } break;
         }
@@ -2790,6 +2939,8 @@ static void create_menu_items() {
     AppendMenuA(dbgMenu, MF_STRING | MF_ENABLED, IDM_DBG_HEX_EDITOR, "&Hex Editor");
     AppendMenuA(dbgMenu, MF_STRING | MF_ENABLED, IDM_DBG_VDP_RAM, "&VDP Ram");
     AppendMenuA(dbgMenu, MF_STRING | MF_ENABLED, IDM_DBG_PLANE_EXPLORER, "&Plane Explorer");
+    AppendMenuA(dbgMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenuA(dbgMenu, MF_STRING | MF_ENABLED, IDM_DBG_REWIND, "&Rewind 1 second");
 
     pinst = GetHInstance();
     dbgMenuHook = SetWindowsHookExA(WH_GETMESSAGE, dbgMenuHookProc, pinst, 0);
@@ -2815,6 +2966,14 @@ void retro_init(void)
    environ_cb(RETRO_ENVIRONMENT_SET_SERIALIZATION_QUIRKS, &serialization_quirks);
    environ_cb(RETRO_ENVIRONMENT_SET_DISK_CONTROL_INTERFACE, &disk_ctrl);
 
+   if (environ_cb(RETRO_ENVIRONMENT_GET_PERF_INTERFACE, &perf_cb) && perf_cb.perf_register)
+   {
+      perf_cb.perf_register(&perf_frame);
+      perf_cb.perf_register(&perf_runahead);
+   }
+   else
+      memset(&perf_cb, 0, sizeof(perf_cb));
+
    dbg_req_core = create_shared_mem();
    start_debugging();
 }
@@ -2823,6 +2982,12 @@ void retro_deinit(void)
 {
     stop_debugging();
     close_shared_mem(&dbg_req_core, 1);
+    rewind_shutdown();
+    checkpoint_shutdown();
+
+    free(runahead_state);
+    runahead_state = NULL;
+    runahead_frames = 0;
 
     UnhookWindowsHookEx(dbgMenuHook);
     DestroyMenu(dbgMenu);
@@ -2839,6 +3004,61 @@ void retro_reset(void)
    gen_reset(0);
 }
 
+static void run_frame(int do_skip)
+{
+   if (system_hw == SYSTEM_MCD)
+   {
+      system_frame_scd(do_skip);
+   }
+   else if ((system_hw & SYSTEM_PBC) == SYSTEM_MD)
+   {
+      system_frame_gen(do_skip);
+   }
+   else
+   {
+      system_frame_sms(do_skip);
+   }
+}
+
+/* Frames are emulated ahead with the current input then rolled back: the    */
+/* last one is the only one rendered, and is output instead of the current   */
+/* frame, which hides as many frames of input lag. Only the current frame is */
+/* audible. */
+static void run_ahead(int frames)
+{
+   t_bitmap shown;
+
+   if (perf_cb.perf_start)
+      perf_cb.perf_start(&perf_runahead);
+
+   state_save(runahead_state);
+   audio_set_hidden(1);
+
+   while (frames--)
+   {
+      run_frame(frames > 0);
+      audio_update(soundbuffer);
+   }
+
+   /* state load resets the viewport of the frame to output */
+   shown = bitmap;
+   state_load_hot(runahead_state);
+   bitmap.viewport = shown.viewport;
+   audio_set_hidden(0);
+
+   if (perf_cb.perf_stop)
+      perf_cb.perf_stop(&perf_runahead);
+}
+
+/* hidden frames would hit breakpoints and end up in traces */
+static int runahead_allowed(void)
+{
+   if (dbg_req_core && dbg_req_core->dbg_active == 1)
+      return 0;
+
+   return !trace_m68k_active;
+}
+
 void retro_run(void) 
 {
    if (!menu_created) {
@@ -2855,30 +3075,50 @@ void retro_run(void)
 
    if (is_paused)
    {
+       /* frame was interrupted, frontend framebuffer is released */
+       unmap_framebuffer();
+
+       /* block until the debugger posts a request, at most one frame */
+       wait_dbg_request(dbg_req_core, 16);
        process_request();
        return;
    }
 
    bool updated = false;
+   int frames = runahead_allowed() ? runahead_frames : 0;
+   int samples;
    is_running = true;
 
+   if (rewind_pending)
+   {
+      rewind_frames(rewind_pending);
+      rewind_pending = 0;
+   }
+
 #ifdef HAVE_OVERCLOCK
   /* update overclock delay */
   if (overclock_delay && --overclock_delay == 0)
       update_overclock();
 #endif
 
-   if (system_hw == SYSTEM_MCD)
-   {
-      system_frame_scd(0);
-   }
-   else if ((system_hw & SYSTEM_PBC) == SYSTEM_MD)
-   {
-      system_frame_gen(0);
-   }
-   else
+   if (perf_cb.perf_start)
+      perf_cb.perf_start(&perf_frame);
+
+   map_framebuffer();
+
+   begin_debug_frame();
+   run_frame(frames > 0);
+   end_debug_frame();
+   capture_rewind_frame();
+
+   samples = audio_update(soundbuffer);
+
+   if (perf_cb.perf_stop)
+      perf_cb.perf_stop(&perf_frame);
+
+   if (frames)
    {
-      system_frame_sms(0);
+      run_ahead(frames);
    }
 
    if (bitmap.viewport.changed & 9)
@@ -2904,25 +3144,35 @@ void retro_run(void)
    {
       if (input.system[0] == SYSTEM_LIGHTPHASER)
       {
-         draw_cursor(input.analog[0][0], input.analog[0][1], 0x001f);
+         draw_cursor(input.analog[0][0], input.analog[0][1], 0x0000ff);
       }
       else if (input.dev[4] == DEVICE_LIGHTGUN)
       {
-         draw_cursor(input.analog[4][0], input.analog[4][1], 0x001f);
+         draw_cursor(input.analog[4][0], input.analog[4][1], 0x0000ff);
       }
 
       if (input.system[1] == SYSTEM_LIGHTPHASER)
       {
-         draw_cursor(input.analog[4][0], input.analog[4][1], 0xf800);
+         draw_cursor(input.analog[4][0], input.analog[4][1], 0xff0000);
       }
       else if (input.dev[5] == DEVICE_LIGHTGUN)
       {
-         draw_cursor(input.analog[5][0], input.analog[5][1], 0xf800);
+         draw_cursor(input.analog[5][0], input.analog[5][1], 0xff0000);
       }
    }
 
-   video_cb(bitmap.data, vwidth, vheight, 720 * 2);
-   audio_cb(soundbuffer, audio_update(soundbuffer));
+   /* frontend framebuffer size has to match exactly */
+   if (framebuffer_mapped)
+      video_cb(bitmap.data, bitmap.width, bitmap.height, bitmap.pitch);
+   else
+      video_cb(bitmap.data, vwidth, vheight, bitmap.pitch);
+   unmap_framebuffer();
+   audio_cb(soundbuffer, samples);
+
+#ifdef HOOK_CPU
+   cpu_hook_end_frame();
+   trace_frame();
+#endif
 
    environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated);
    if (updated)
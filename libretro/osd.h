@@ -135,7 +135,7 @@ typedef struct
   uint8 no_sprite_limit;
 } t_config;
 
-extern t_config config;
+extern MACHINE_LOCAL t_config config;
 
 extern char GG_ROM[256];
 extern char AR_ROM[256];